@@ -11,6 +11,10 @@
 
   This example shows how to output the timestamp for each reading.
 
+  getTimeStamp() is the base timestamp the BNO085 sends: how long ago the reading was taken, in 100us ticks.
+  getTimeStampMicros() works out when the reading was taken in micros() time. It is 64 bits so it never
+  rolls over. Here only the bottom 32 bits are printed so they can be compared with micros().
+
   It takes about 1ms at 400kHz I2C to read a record from the sensor, but we are polling the sensor continually
   between updates from the sensor. Use the interrupt pin on the BNO085 breakout to avoid polling.
 
@@ -40,7 +44,7 @@ void setup()
   myIMU.enableRotationVector(50000); //Send data update every 50ms
 
   Serial.println(F("Rotation vector enabled"));
-  Serial.println(F("Output in form time, i, j, k, real, accuracy"));
+  Serial.println(F("Output in form time, sample micros, i, j, k, real, accuracy"));
 }
 
 void loop()
@@ -49,6 +53,7 @@ void loop()
   if (myIMU.dataAvailable() == true)
   {
     unsigned long timeStamp = myIMU.getTimeStamp();
+    unsigned long sampleMicros = (unsigned long)myIMU.getTimeStampMicros();
     float quatI = myIMU.getQuatI();
     float quatJ = myIMU.getQuatJ();
     float quatK = myIMU.getQuatK();
@@ -57,6 +62,8 @@ void loop()
 
     Serial.print(timeStamp);
     Serial.print(F(","));
+    Serial.print(sampleMicros);
+    Serial.print(F(","));
     Serial.print(quatI, 2);
     Serial.print(F(","));
     Serial.print(quatJ, 2);
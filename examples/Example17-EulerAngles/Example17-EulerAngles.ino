@@ -72,9 +72,12 @@ void loop()
   //Look for reports from the IMU
   if (myIMU.dataAvailable() == true)
   {
-    float roll = (myIMU.getRoll()) * 180.0 / PI; // Convert roll to degrees
-    float pitch = (myIMU.getPitch()) * 180.0 / PI; // Convert pitch to degrees
-    float yaw = (myIMU.getYaw()) * 180.0 / PI; // Convert yaw / heading to degrees
+    float roll, pitch, yaw;
+    myIMU.getEuler(roll, pitch, yaw); //All three angles at once. Pass true as well for the faster approximation.
+
+    roll = roll * 180.0 / PI; // Convert roll to degrees
+    pitch = pitch * 180.0 / PI; // Convert pitch to degrees
+    yaw = yaw * 180.0 / PI; // Convert yaw / heading to degrees
 
     Serial.print(roll, 1);
     Serial.print(F(","));
@@ -5,10 +5,12 @@
   License: This code is public domain.
 
   This example shows how to access linear acc and quaternion data
-  through interrupts, using getReadings and multiple access.
+  through interrupts, using the sample queue.
 
-  The interrupt handler reads the available data into the library memory,
-  and maintains a flag for new data of 2 different sensor types.
+  The interrupt handler only marks the INT edge. Reading the sensor from inside
+  an interrupt blocks on I2C and changes the library values while loop() reads them.
+  loop() does the bus work with poll(), and every decoded report is put in a queue
+  so none are lost, even if loop() is slow to get to them.
 
   Hardware Connections:
   Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
@@ -18,17 +20,11 @@
 
 #include <Wire.h>
 
-#include "SparkFun_BNO080_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
-BNO080 myIMU;
-
-// indicators of new data availability
-volatile byte newQuat = 0;
-volatile byte newLinAcc = 0;
-// internal copies of the IMU data
-float ax, ay, az, qx, qy, qz, qw; // (qx, qy, qz, qw = i,j,k, real)
-byte linAccuracy = 0;
-float quatRadianAccuracy = 0;
-byte quatAccuracy = 0;
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+// queue of decoded samples, filled by the library as reports are read
+BNO085Sample sampleQueue[16];
 // pin used for interrupts
 byte imuINTPin = 3;
 
@@ -36,7 +32,7 @@ void setup()
 {
   Serial.begin(115200);
   Serial.println();
-  Serial.println("BNO080 Read example with Interrupt handler, getReading and multiple access");
+  Serial.println("BNO085 Read example with Interrupt handler and sample queue");
 
   Wire.begin();
 
@@ -53,21 +49,23 @@ void setup()
   //myIMU.enableDebugging(); // Uncomment this line to enable debug messages on Serial
 
   // imuINTPin is used as an active-low interrupt. .begin configures the pinMode as INPUT_PULLUP
-  if (myIMU.begin(BNO080_DEFAULT_ADDRESS, Wire, imuINTPin) == false)
+  if (myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire, imuINTPin) == false)
   {
-    Serial.println("BNO080 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing...");
+    Serial.println("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing...");
     while (1);
   }
 
   Wire.setClock(400000); //Increase I2C data rate to 400kHz
 
+  myIMU.enableSampleQueue(sampleQueue, 16);
+
   // prepare interrupt on falling edge (= signal of new data available)
   attachInterrupt(digitalPinToInterrupt(imuINTPin), interrupt_handler, FALLING);
   // enable interrupts right away to not miss first reports
   interrupts();
 
-  myIMU.enableLinearAccelerometer(50);  // m/s^2 no gravity, data update every 50 ms
-  myIMU.enableRotationVector(100); //Send data update every 100 ms
+  myIMU.enableLinearAccelerometer(50000);  // m/s^2 no gravity, data update every 50 ms
+  myIMU.enableRotationVector(100000); //Send data update every 100 ms
 
   Serial.println(F("LinearAccelerometer enabled, Output in form x, y, z, accuracy, in m/s^2"));
   Serial.println(F("Rotation vector, Output in form i, j, k, real, accuracy"));
@@ -77,60 +75,53 @@ void setup()
 // This function is called whenever an interrupt is detected by the arduino
 void interrupt_handler()
 {
-  // code snippet from ya-mouse
-   switch (myIMU.getReadings())
-   {
-      case SENSOR_REPORTID_LINEAR_ACCELERATION: {
-        newLinAcc = 1;
-      }
-      break;
-
-      case SENSOR_REPORTID_ROTATION_VECTOR:
-      case SENSOR_REPORTID_GAME_ROTATION_VECTOR: {
-         newQuat = 1;
-      }
-      break;
-      default:
-         // Unhandled Input Report
-         break;
-   }
+  myIMU.markInterrupt(); // only note the edge, the bus work is done in loop()
 }
 
 void loop()
 {
-  Serial.println("Doing other things");
-  delay(10); //You can do many other things. Interrupt handler will retrieve latest data
-
-  // If new data on LinAcc sensor, retrieve it from the library memory
-  if(newLinAcc) {
-    myIMU.getLinAccel(ax, ay, az, linAccuracy);
-    newLinAcc = 0; // mark data as read
-    Serial.print(F("acc :"));
-    Serial.print(ax, 2);
-    Serial.print(F(","));
-    Serial.print(ay, 2);
-    Serial.print(F(","));
-    Serial.print(az, 2);
-    Serial.print(F(","));
-    Serial.print(az, 2);
-    Serial.print(F(","));
-    printAccuracyLevel(linAccuracy);
+  // read the sensor if it has something for us. This returns right away if INT is not asserted.
+  if (myIMU.interruptPending() || digitalRead(imuINTPin) == LOW)
+    myIMU.getReadings();
+
+  // process everything that was decoded since the last time
+  BNO085Sample sample;
+  while (myIMU.readSample(sample))
+  {
+    if (sample.reportID == SENSOR_REPORTID_LINEAR_ACCELERATION)
+    {
+      Serial.print(F("acc :"));
+      Serial.print(myIMU.qToFloat(sample.data[0], 8), 2); // linear acceleration is Q8
+      Serial.print(F(","));
+      Serial.print(myIMU.qToFloat(sample.data[1], 8), 2);
+      Serial.print(F(","));
+      Serial.print(myIMU.qToFloat(sample.data[2], 8), 2);
+      Serial.print(F(","));
+      printAccuracyLevel(sample.status);
+    }
+    else if (sample.reportID == SENSOR_REPORTID_ROTATION_VECTOR)
+    {
+      Serial.print(F("quat:"));
+      Serial.print(myIMU.qToFloat(sample.data[0], 14), 2); // rotation vector is Q14
+      Serial.print(F(","));
+      Serial.print(myIMU.qToFloat(sample.data[1], 14), 2);
+      Serial.print(F(","));
+      Serial.print(myIMU.qToFloat(sample.data[2], 14), 2);
+      Serial.print(F(","));
+      Serial.print(myIMU.qToFloat(sample.data[3], 14), 2);
+      Serial.print(F(","));
+      printAccuracyLevel(sample.status);
+    }
   }
-  // If new data on Rotation Vector sensor, retrieve it from the library memory
-  if(newQuat) {
-    myIMU.getQuat(qx, qy, qz, qw, quatRadianAccuracy, quatAccuracy);
-    newQuat = 0; // mark data as read
-    Serial.print(F("quat:"));
-    Serial.print(qx, 2);
-    Serial.print(F(","));
-    Serial.print(qy, 2);
-    Serial.print(F(","));
-    Serial.print(qz, 2);
-    Serial.print(F(","));
-    Serial.print(qw, 2);
-    Serial.print(F(","));
-    printAccuracyLevel(quatAccuracy);
+
+  if (myIMU.getSampleQueueOverflows() > 0)
+  {
+    Serial.println(F("Sample queue overflowed. Make it bigger or read it more often."));
+    myIMU.enableSampleQueue(sampleQueue, 16); // clears the queue and the counter
   }
+
+  Serial.println("Doing other things");
+  delay(10); //You can do many other things. The queue holds the samples until you are ready
 }
 
 //Given an accuracy number, print what it means
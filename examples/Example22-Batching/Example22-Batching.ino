@@ -0,0 +1,66 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to let the BNO085 batch reports in its own FIFO.
+
+  The accelerometer runs at 100Hz but the hub only delivers the samples every 500ms.
+  Every half second we ask the hub to flush its FIFO and read all of the batched
+  reports in one go, instead of one bus transaction per sample.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+unsigned long lastDrain = 0;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Batching Example");
+
+  Wire.begin();
+
+  if (myIMU.begin() == false)
+  {
+    Serial.println("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing...");
+    while (1);
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.enableAccelerometer(10000, 500000); //Sample every 10ms, batch for up to 500ms
+
+  Serial.println(F("Accelerometer enabled, Output in form reports, x, y, z, in m/s^2"));
+}
+
+void loop()
+{
+  if (millis() - lastDrain > 500)
+  {
+    lastDrain = millis();
+
+    uint16_t reports = myIMU.drainBatch(SENSOR_REPORTID_ACCELEROMETER);
+
+    Serial.print(reports);
+    Serial.print(F(","));
+    Serial.print(myIMU.getAccelX(), 2);
+    Serial.print(F(","));
+    Serial.print(myIMU.getAccelY(), 2);
+    Serial.print(F(","));
+    Serial.print(myIMU.getAccelZ(), 2);
+    Serial.println();
+  }
+}
@@ -0,0 +1,91 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example measures how many bytes are read over I2C and how many of those are packet headers.
+
+  Every I2C read from the BNO085 starts with the 4 byte packet header. By default the library reads the
+  header on its own, then reads the payload in chunks that fit the Wire buffer, each chunk starting with
+  the header again. A larger Wire buffer means fewer chunks, and a single read gets the header and the
+  payload in one transaction.
+
+  The sketch runs for 5 seconds with the default settings, then 5 seconds with single reads, and prints
+  the byte counts for each.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 I2C Byte Count Example");
+
+  Wire.begin();
+
+  //If your platform has a larger Wire buffer than the library detects, pass it here
+  if (myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire, 255, I2C_BUFFER_LENGTH) == false)
+  {
+    Serial.println("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing...");
+    while (1);
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.enableRotationVector(10000); //Send data update every 10ms
+  myIMU.enableAccelerometer(10000);
+  myIMU.enableGyro(10000);
+
+  Serial.print(F("I2C buffer length: "));
+  Serial.println(I2C_BUFFER_LENGTH);
+
+  myIMU.setI2CSingleReadLength(0); //Default. Read the header on its own first.
+  runTest("Header then payload");
+
+  myIMU.setI2CSingleReadLength(I2C_BUFFER_LENGTH); //Read the header and payload together
+  runTest("Single read");
+}
+
+void loop()
+{
+}
+
+void runTest(const char *name)
+{
+  unsigned long reports = 0;
+
+  myIMU.clearI2CByteCounts();
+  unsigned long startTime = millis();
+  while (millis() - startTime < 5000)
+  {
+    if (myIMU.dataAvailable() == true)
+      reports++;
+  }
+
+  uint32_t bytesRead = myIMU.getI2CBytesRead();
+  uint32_t headerBytes = myIMU.getI2CHeaderBytesRead();
+
+  Serial.print(name);
+  Serial.print(F(": packets: "));
+  Serial.print(reports);
+  Serial.print(F(" bytes read: "));
+  Serial.print(bytesRead);
+  Serial.print(F(" header bytes: "));
+  Serial.print(headerBytes);
+  Serial.print(F(" ("));
+  if (bytesRead > 0)
+    Serial.print(100.0 * headerBytes / bytesRead, 1);
+  Serial.println(F("%)"));
+}
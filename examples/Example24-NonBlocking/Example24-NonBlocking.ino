@@ -0,0 +1,76 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to service the BNO085 from a fixed rate control loop without blocking.
+
+  dataAvailable() reads a whole packet and can wait up to 100ms for the sensor. poll() does at most
+  one I2C transaction per call and returns right away, so the loop below keeps its 1ms period.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Connect the INT pin to pin 3. Without it poll() checks the sensor over I2C on every idle call.
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+byte imuINTPin = 3;
+unsigned long nextLoop = 0;
+unsigned long lateLoops = 0;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Non-Blocking Example");
+
+  Wire.begin();
+
+  if (myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire, imuINTPin) == false)
+  {
+    Serial.println("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing...");
+    while (1);
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.enableRotationVector(10000); //Send data update every 10ms
+
+  nextLoop = micros();
+}
+
+void loop()
+{
+  //Wait for the start of the next 1ms loop
+  while ((long)(micros() - nextLoop) < 0)
+    ;
+  nextLoop += 1000;
+
+  //Do a little bit of IMU work
+  if (myIMU.poll() == SENSOR_REPORTID_ROTATION_VECTOR)
+  {
+    Serial.print(myIMU.getQuatI(), 2);
+    Serial.print(F(","));
+    Serial.print(myIMU.getQuatJ(), 2);
+    Serial.print(F(","));
+    Serial.print(myIMU.getQuatK(), 2);
+    Serial.print(F(","));
+    Serial.print(myIMU.getQuatReal(), 2);
+    Serial.print(F(" late loops: "));
+    Serial.println(lateLoops);
+  }
+
+  //Your control loop goes here
+
+  if ((long)(micros() - nextLoop) > 0)
+    lateLoops++; //We overran our deadline
+}
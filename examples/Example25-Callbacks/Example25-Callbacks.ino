@@ -0,0 +1,81 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to have a function called with every sample of a report.
+
+  The BNO085 can send several reports in one packet, and getAccelX() etc only show the last of each.
+  A callback is handed every sample as it is parsed, with its timestamp and its raw fields.
+  getSampleValue() applies the report's Q point to a field.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+//Called for every accelerometer sample
+void onAccelerometer(const BNO085Sample &sample)
+{
+  Serial.print(F("Accel "));
+  Serial.print((unsigned long)sample.timeMicros);
+  Serial.print(F(","));
+  Serial.print(myIMU.getSampleValue(sample, 0), 2);
+  Serial.print(F(","));
+  Serial.print(myIMU.getSampleValue(sample, 1), 2);
+  Serial.print(F(","));
+  Serial.print(myIMU.getSampleValue(sample, 2), 2);
+  Serial.println();
+}
+
+//Called for every rotation vector sample
+void onRotationVector(const BNO085Sample &sample)
+{
+  Serial.print(F("Quat "));
+  Serial.print((unsigned long)sample.timeMicros);
+  for (uint8_t x = 0; x < 5; x++) //i, j, k, real and accuracy in radians
+  {
+    Serial.print(F(","));
+    Serial.print(myIMU.getSampleValue(sample, x), 2);
+  }
+  Serial.println();
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Callback Example");
+
+  Wire.begin();
+
+  if (myIMU.begin() == false)
+  {
+    Serial.println("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing...");
+    while (1);
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.setReportCallback(SENSOR_REPORTID_ACCELEROMETER, onAccelerometer);
+  myIMU.setReportCallback(SENSOR_REPORTID_ROTATION_VECTOR, onRotationVector);
+
+  myIMU.enableAccelerometer(20000, 100000); //Every 20ms, sent in batches every 100ms
+  myIMU.enableRotationVector(50000);        //Send data update every 50ms
+
+  Serial.println(F("Output in form time, x, y, z or time, i, j, k, real, accuracy"));
+}
+
+void loop()
+{
+  myIMU.getReadings(); //The callbacks are called from in here
+}
@@ -0,0 +1,96 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to use the rotation vector without any floating point math.
+
+  getQuatFixed() returns the quaternion as the BNO085 sent it, Q14: 16384 is 1.0.
+  BNO085Fixed works on these with integers only, which is much quicker on boards without an FPU.
+  Angles are binary, 65536 to a turn. toCentidegrees() turns them into 1/100 of a degree.
+
+  Here we capture the orientation when the sketch starts and print how far the board
+  has turned since then, along with where the board's X axis now points.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+BNO085Quat start;
+bool haveStart = false;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Read Example");
+
+  Wire.begin();
+
+  if (myIMU.begin() == false)
+  {
+    Serial.println(F("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing..."));
+    while (1)
+      ;
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.enableRotationVector(50000); //Send data update every 50ms
+
+  Serial.println(F("Rotation vector enabled"));
+  Serial.println(F("Output in form roll, pitch, yaw in 1/100 degree, turn since start, X axis (Q14)"));
+}
+
+void loop()
+{
+  //Look for reports from the IMU
+  if (myIMU.dataAvailable() == true)
+  {
+    BNO085Quat quat;
+    myIMU.getQuatFixed(quat);
+
+    if (haveStart == false)
+    {
+      start = quat;
+      haveStart = true;
+    }
+
+    int16_t roll, pitch, yaw;
+    BNO085Fixed::euler(quat, roll, pitch, yaw);
+
+    //The rotation from the start to now, and its heading
+    BNO085Quat turned = BNO085Fixed::relative(start, quat);
+    int16_t turn = BNO085Fixed::heading(turned);
+
+    //Where the board's X axis points, as a unit vector in Q14
+    BNO085Vector xAxis = {16384, 0, 0};
+    xAxis = BNO085Fixed::rotate(quat, xAxis);
+
+    Serial.print(BNO085Fixed::toCentidegrees(roll));
+    Serial.print(F(","));
+    Serial.print(BNO085Fixed::toCentidegrees(pitch));
+    Serial.print(F(","));
+    Serial.print(BNO085Fixed::toCentidegrees(yaw));
+    Serial.print(F(","));
+    Serial.print(BNO085Fixed::toCentidegrees(turn));
+    Serial.print(F(","));
+    Serial.print(xAxis.x);
+    Serial.print(F(","));
+    Serial.print(xAxis.y);
+    Serial.print(F(","));
+    Serial.print(xAxis.z);
+
+    Serial.println();
+  }
+}
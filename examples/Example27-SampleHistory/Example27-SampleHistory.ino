@@ -0,0 +1,81 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to keep every sample of a report, for code that works on blocks of samples.
+
+  getAccelX() etc only show the last sample. If the sketch looks less often than the BNO085
+  reports, the samples in between are lost. A history keeps each one with its status and
+  timestamp until drain() copies them out, oldest first.
+
+  Here the accelerometer runs at 400Hz and we print the average of each block of 64 samples.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+#define BLOCK_SIZE 64
+BNO085SampleHistory<100> accelHistory; //Room for a block and some more while we work on it
+BNO085Sample block[BLOCK_SIZE];
+uint16_t blockCount = 0;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Read Example");
+
+  Wire.begin();
+
+  if (myIMU.begin() == false)
+  {
+    Serial.println(F("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing..."));
+    while (1)
+      ;
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.enableHistory(SENSOR_REPORTID_ACCELEROMETER, accelHistory);
+  myIMU.enableAccelerometer(2500); //Send data update every 2.5ms
+
+  Serial.println(F("Accelerometer enabled"));
+  Serial.println(F("Output in form time of first sample (us), x, y, z average of each block, samples dropped"));
+}
+
+void loop()
+{
+  myIMU.getReadings(); //Keep reading the BNO085. Samples go into the history as they are parsed.
+
+  blockCount += myIMU.drain(SENSOR_REPORTID_ACCELEROMETER, &block[blockCount], BLOCK_SIZE - blockCount);
+  if (blockCount < BLOCK_SIZE)
+    return;
+
+  float sum[3] = {0, 0, 0};
+  for (uint16_t x = 0; x < BLOCK_SIZE; x++)
+    for (uint8_t axis = 0; axis < 3; axis++)
+      sum[axis] += myIMU.getSampleValue(block[x], axis);
+
+  Serial.print((unsigned long)block[0].timeMicros);
+  for (uint8_t axis = 0; axis < 3; axis++)
+  {
+    Serial.print(F(","));
+    Serial.print(sum[axis] / BLOCK_SIZE, 3);
+  }
+  Serial.print(F(","));
+  Serial.print(myIMU.getHistoryOverflows(SENSOR_REPORTID_ACCELEROMETER));
+  Serial.println();
+
+  blockCount = 0;
+}
@@ -0,0 +1,113 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to read several BNO085s at once with a BNO085Manager.
+
+  Calling dataAvailable() on each sensor in turn can wait up to 100ms on a sensor that has
+  nothing to send, and the others miss their samples meanwhile. The manager never waits:
+  each update() does one small step for the sensor that has had data longest. readSample()
+  hands out the samples of every sensor in the order they were taken.
+
+  Here there are two sensors on I2C (one with the ADR jumper closed) and one on SPI.
+  Wire each INT pin to its own Arduino pin. A sensor without an INT pin is checked every 10ms.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensors onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+#include <SPI.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU1;
+BNO085 myIMU2;
+BNO085 myIMU3;
+
+BNO085Manager manager;
+BNO085Sample queue1[16];
+BNO085Sample queue2[16];
+BNO085Sample queue3[16];
+
+//SPI pins for the third sensor
+byte imuCSPin = 10;
+byte imuWAKPin = 9;
+byte imuINTPin = 8;
+byte imuRSTPin = 7;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Read Example");
+
+  Wire.begin();
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  if (myIMU1.begin(0x4B, Wire, 2) == false || myIMU2.begin(0x4A, Wire, 3) == false)
+  {
+    Serial.println(F("BNO085s not detected on I2C. Check your jumpers and the hookup guide. Freezing..."));
+    while (1)
+      ;
+  }
+  if (myIMU3.beginSPI(imuCSPin, imuWAKPin, imuINTPin, imuRSTPin) == false)
+  {
+    Serial.println(F("BNO085 over SPI not detected. Freezing..."));
+    while (1)
+      ;
+  }
+
+  myIMU1.enableRotationVector(10000); //Send data update every 10ms
+  myIMU2.enableRotationVector(10000);
+  myIMU3.enableRotationVector(10000);
+
+  manager.addDevice(myIMU1, queue1, 16);
+  manager.addDevice(myIMU2, queue2, 16);
+  manager.addDevice(myIMU3, queue3, 16);
+
+  Serial.println(F("Rotation vectors enabled"));
+  Serial.println(F("Output in form sensor, time (us), i, j, k, real"));
+}
+
+void loop()
+{
+  manager.update(); //One step of reading whichever sensor needs it
+
+  BNO085Sample sample;
+  uint8_t sensor;
+  while (manager.readSample(sample, sensor))
+  {
+    Serial.print(sensor);
+    Serial.print(F(","));
+    Serial.print((unsigned long)sample.timeMicros);
+    for (uint8_t x = 0; x < 4; x++)
+    {
+      Serial.print(F(","));
+      Serial.print(myIMU1.getSampleValue(sample, x), 2);
+    }
+    Serial.println();
+  }
+
+  //Print the latency of each sensor every 5 seconds
+  static unsigned long lastStats = 0;
+  if (millis() - lastStats > 5000)
+  {
+    lastStats = millis();
+    for (uint8_t x = 0; x < manager.getDeviceCount(); x++)
+    {
+      BNO085DeviceStats stats = manager.getStats(x);
+      Serial.print(F("Sensor "));
+      Serial.print(x);
+      Serial.print(F(" packets "));
+      Serial.print(stats.packets);
+      Serial.print(F(" longest latency (us) "));
+      Serial.println(stats.maxLatencyMicros);
+    }
+  }
+}
@@ -0,0 +1,100 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to line up the readings of several BNO085s in time.
+
+  Each BNO085 runs on its own clock, and a reading is only timed when it is read, so two sensors'
+  readings can be a whole poll apart. A BNO085Synchronizer learns each sensor's clock and
+  hands out one rotation vector per sensor for the same moment, every 10ms.
+
+  For the best timing wire each INT pin to a pin with an interrupt and call markInterrupt() from it.
+  A sensor with no INT pin still works, it just takes a little longer to line up.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensors onto the shield, one with the ADR jumper closed
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU1;
+BNO085 myIMU2;
+
+BNO085Manager manager;
+BNO085Synchronizer sync;
+BNO085Sample queue1[16];
+BNO085Sample queue2[16];
+
+void imu1Interrupt()
+{
+  myIMU1.markInterrupt();
+}
+
+void imu2Interrupt()
+{
+  myIMU2.markInterrupt();
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Read Example");
+
+  Wire.begin();
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  if (myIMU1.begin(0x4B, Wire, 2) == false || myIMU2.begin(0x4A, Wire, 3) == false)
+  {
+    Serial.println(F("BNO085s not detected on I2C. Check your jumpers and the hookup guide. Freezing..."));
+    while (1)
+      ;
+  }
+  attachInterrupt(digitalPinToInterrupt(2), imu1Interrupt, FALLING);
+  attachInterrupt(digitalPinToInterrupt(3), imu2Interrupt, FALLING);
+
+  myIMU1.enableRotationVector(5000); //Both at the same rate, every 5ms
+  myIMU2.enableRotationVector(5000);
+
+  manager.addDevice(myIMU1, queue1, 16);
+  manager.addDevice(myIMU2, queue2, 16);
+  sync.begin(manager, SENSOR_REPORTID_ROTATION_VECTOR); //At the interval the hub confirmed
+  sync.setOutputInterval(10000); //A pair every 10ms
+
+  Serial.println(F("Rotation vectors enabled"));
+  Serial.println(F("Output in form time (us), real 1, real 2, degrees between the sensors"));
+}
+
+void loop()
+{
+  sync.update(); //One step of reading whichever sensor needs it
+
+  BNO085Sample pair[2];
+  while (sync.readAligned(pair))
+  {
+    if (pair[0].reportID == 0 || pair[1].reportID == 0)
+      continue; //One of them has stopped reporting
+
+    //The rotation from sensor 1 to sensor 2 at the same moment
+    BNO085Quat q1 = {pair[0].data[0], pair[0].data[1], pair[0].data[2], pair[0].data[3]};
+    BNO085Quat q2 = {pair[1].data[0], pair[1].data[1], pair[1].data[2], pair[1].data[3]};
+    BNO085Quat between = BNO085Fixed::relative(q1, q2);
+    float angle = 2 * acos(abs(between.real) / 16384.0) * 180.0 / PI;
+
+    Serial.print((unsigned long)pair[0].timeMicros);
+    Serial.print(F(","));
+    Serial.print(myIMU1.getSampleValue(pair[0], 3), 4);
+    Serial.print(F(","));
+    Serial.print(myIMU2.getSampleValue(pair[1], 3), 4);
+    Serial.print(F(","));
+    Serial.print(angle, 1);
+    Serial.println();
+  }
+}
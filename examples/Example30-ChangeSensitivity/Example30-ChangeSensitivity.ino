@@ -0,0 +1,76 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to have the BNO085 only send a report when its value changes.
+
+  With a change sensitivity set, the hub still samples at the report interval but holds back any
+  report that has not moved by at least that much since the last one it sent. A still sensor
+  then costs almost no bus traffic. Absolute sensitivity is in the report's own units and Q point:
+  the accelerometer is Q8, so 26 is 0.1m/s^2.
+
+  The rotation vector is also marked as a wake-up report, so it is sent on the wake channel and
+  would wake a host that sleeps until the INT pin goes low.
+
+  Flags are sent when the report is enabled, so set them first.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+unsigned long lastPrint = 0;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Read Example");
+
+  Wire.begin();
+
+  if (myIMU.begin() == false)
+  {
+    Serial.println(F("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing..."));
+    while (1)
+      ;
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.setChangeSensitivity(SENSOR_REPORTID_ACCELEROMETER, 26); //Only when an axis moves by 0.1m/s^2
+  myIMU.setWakeUp(SENSOR_REPORTID_ROTATION_VECTOR, true);
+  myIMU.enableAccelerometer(10000);    //Sample every 10ms
+  myIMU.enableRotationVector(50000); //Send data update every 50ms
+
+  Serial.println(F("Accelerometer and rotation vector enabled"));
+  Serial.println(F("Output each second in form accel reports received, suppressed, rotation vector reports received"));
+}
+
+void loop()
+{
+  myIMU.getReadings(); //Keep reading the BNO085
+
+  if (millis() - lastPrint < 1000)
+    return;
+  lastPrint = millis();
+
+  Serial.print(myIMU.getReportsReceived(SENSOR_REPORTID_ACCELEROMETER));
+  Serial.print(F(","));
+  Serial.print(myIMU.getSuppressedReports(SENSOR_REPORTID_ACCELEROMETER));
+  Serial.print(F(","));
+  Serial.print(myIMU.getReportsReceived(SENSOR_REPORTID_ROTATION_VECTOR));
+  Serial.println();
+
+  myIMU.clearReportCounts();
+}
@@ -0,0 +1,80 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows how to find out the rate the BNO085 is really sending a report at.
+
+  Each sensor only runs at certain rates. The hub rounds a requested interval to one it has and
+  answers every enable with a Get Feature Response saying what it used. The library waits for
+  that answer and keeps it, so getReportInterval() and getReportRate() give the real numbers
+  to size buffers and schedules from. requestFeature() asks the hub again at any time.
+
+  Here we ask for 60Hz from the accelerometer and 333Hz from the rotation vector.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+void printRate(uint8_t reportID, long requested)
+{
+  Serial.print(F("Report 0x"));
+  Serial.print(reportID, HEX);
+  Serial.print(F(": asked for "));
+  Serial.print(requested);
+  Serial.print(F("us, hub uses "));
+  Serial.print(myIMU.getReportInterval(reportID));
+  Serial.print(F("us, "));
+  Serial.print(myIMU.getReportRate(reportID), 1);
+  Serial.println(F("Hz"));
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Read Example");
+
+  Wire.begin();
+
+  if (myIMU.begin() == false)
+  {
+    Serial.println(F("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing..."));
+    while (1)
+      ;
+  }
+
+  Wire.setClock(400000); //Increase I2C data rate to 400kHz
+
+  myIMU.enableAccelerometer(16667); //60Hz
+  myIMU.enableRotationVector(3000); //333Hz
+
+  printRate(SENSOR_REPORTID_ACCELEROMETER, 16667);
+  printRate(SENSOR_REPORTID_ROTATION_VECTOR, 3000);
+
+  BNO085Feature feature;
+  if (myIMU.requestFeature(SENSOR_REPORTID_ROTATION_VECTOR, feature) == true)
+  {
+    Serial.print(F("Rotation vector batch interval "));
+    Serial.print(feature.batchInterval);
+    Serial.print(F("us, flags 0x"));
+    Serial.println(feature.flags, HEX);
+  }
+  else
+    Serial.println(F("No answer to Get Feature Request"));
+}
+
+void loop()
+{
+  myIMU.getReadings(); //Keep reading the BNO085
+}
@@ -0,0 +1,77 @@
+/*
+  Using the BNO085 IMU
+  SparkFun Electronics
+  License: This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+
+  Feel like supporting our work? Buy a board from SparkFun!
+  https://www.sparkfun.com/products/14586
+
+  This example shows what the BNO085 advertised about itself when it started.
+
+  After every reset the hub sends an advertisement: each application it runs, the channels they
+  use and the largest reads and writes it handles. The library parses it as it is read. Packets
+  are then sent and matched on the channel numbers it gave, and no read is longer than its max
+  transfer, so firmware with a different layout still works.
+
+  Hardware Connections:
+  Attach the Qwiic Shield to your Arduino/Photon/ESP32 or other
+  Plug the sensor onto the shield
+  Serial.print it out at 115200 baud to serial monitor.
+*/
+
+#include <Wire.h>
+
+#include "SparkFun_BNO085_Arduino_Library.h" // Click here to get the library: http://librarymanager/All#SparkFun_BNO080
+BNO085 myIMU;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("BNO085 Read Example");
+
+  Wire.begin();
+
+  if (myIMU.begin() == false)
+  {
+    Serial.println(F("BNO085 not detected at default I2C address. Check your jumpers and the hookup guide. Freezing..."));
+    while (1)
+      ;
+  }
+
+  BNO085Advertisement advertisement;
+  if (myIMU.getAdvertisement(advertisement) == false)
+  {
+    Serial.println(F("No advertisement seen. Using the default channels."));
+    return;
+  }
+
+  Serial.print(F("Max cargo read/write: "));
+  Serial.print(advertisement.maxCargoRead);
+  Serial.print(F("/"));
+  Serial.println(advertisement.maxCargoWrite);
+  Serial.print(F("Max transfer read/write: "));
+  Serial.print(advertisement.maxTransferRead);
+  Serial.print(F("/"));
+  Serial.println(advertisement.maxTransferWrite);
+
+  Serial.println(F("Channels in form number, application GUID, used as, wake"));
+  BNO085Channel channel;
+  for (uint8_t x = 0; myIMU.getChannel(x, channel); x++)
+  {
+    Serial.print(channel.number);
+    Serial.print(F(","));
+    Serial.print(channel.guid);
+    Serial.print(F(","));
+    if (channel.role == BNO085_NO_CHANNEL)
+      Serial.print(F("-"));
+    else
+      Serial.print(channel.role);
+    Serial.print(F(","));
+    Serial.println(channel.wake ? F("yes") : F("no"));
+  }
+}
+
+void loop()
+{
+}
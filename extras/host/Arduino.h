@@ -0,0 +1,139 @@
+/*
+  Minimal Arduino core for building the BNO085 library on a Linux/macOS host
+
+  Only the parts of the Arduino API the library and the host tools use are here.
+  Time is simulated: micros() and millis() return a virtual clock that moves forward
+  with delay(), delayMicroseconds() and the bus transfers done through Wire and SPI.
+  This lets a sketch-style loop run against BNO085Emulator as fast as the host can go
+  while every timestamp stays what it would have been on a real board.
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+//Strings live in RAM on the host
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(void *const *)(addr))
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+//Virtual clock
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+//Advance the virtual clock. Pending emulator events (reports, INT edges) happen on the way.
+void hostAdvanceMicros(uint32_t us);
+uint64_t hostMicros64(void); //The virtual clock without the 32-bit rollover of micros()
+
+//Pins. The emulator owns the pins it is attached to, all others read HIGH.
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+//Interrupts. Handlers attached to the emulator's INT pin run on the falling edge.
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void noInterrupts(void);
+void interrupts(void);
+void hostRunInterrupt(uint8_t pin); //Called by the emulator when a watched pin falls
+
+class Print
+{
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str) { return (str == NULL ? 0 : write((const uint8_t *)str, strlen(str))); }
+
+	size_t print(const __FlashStringHelper *);
+	size_t print(const char[]);
+	size_t print(char);
+	size_t print(unsigned char, int = DEC);
+	size_t print(int, int = DEC);
+	size_t print(unsigned int, int = DEC);
+	size_t print(long, int = DEC);
+	size_t print(unsigned long, int = DEC);
+	size_t print(long long, int = DEC);
+	size_t print(unsigned long long, int = DEC);
+	size_t print(double, int = 2);
+
+	size_t println(const __FlashStringHelper *);
+	size_t println(const char[]);
+	size_t println(char);
+	size_t println(unsigned char, int = DEC);
+	size_t println(int, int = DEC);
+	size_t println(unsigned int, int = DEC);
+	size_t println(long, int = DEC);
+	size_t println(unsigned long, int = DEC);
+	size_t println(long long, int = DEC);
+	size_t println(unsigned long long, int = DEC);
+	size_t println(double, int = 2);
+	size_t println(void);
+
+private:
+	size_t printNumber(unsigned long long n, uint8_t base);
+	size_t printFloat(double number, uint8_t digits);
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+};
+
+//Serial writes to stdout and never has anything to read
+class HardwareSerial : public Stream
+{
+public:
+	void begin(unsigned long) {}
+	operator bool() { return (true); }
+	size_t write(uint8_t c);
+	size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
+	int available() { return (0); }
+	int read() { return (-1); }
+	int peek() { return (-1); }
+	void flush() {}
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,1115 @@
+/*
+  BNO085 SHTP device emulator for host builds
+  See BNO085Emulator.h
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#include "BNO085Emulator.h"
+
+BNO085Emulator *BNO085Emulator::_first = NULL;
+
+//SHTP channels
+#define EMU_CHANNEL_COMMAND 0
+#define EMU_CHANNEL_EXECUTABLE 1
+#define EMU_CHANNEL_CONTROL 2
+#define EMU_CHANNEL_REPORTS 3
+#define EMU_CHANNEL_WAKE_REPORTS 4
+#define EMU_CHANNEL_GYRO 5
+
+//Control channel report IDs
+#define EMU_GET_FEATURE_RESPONSE 0xFC
+#define EMU_SET_FEATURE_COMMAND 0xFD
+#define EMU_GET_FEATURE_REQUEST 0xFE
+#define EMU_PRODUCT_ID_REQUEST 0xF9
+#define EMU_PRODUCT_ID_RESPONSE 0xF8
+#define EMU_FRS_READ_REQUEST 0xF4
+#define EMU_FRS_READ_RESPONSE 0xF3
+#define EMU_COMMAND_REQUEST 0xF2
+#define EMU_COMMAND_RESPONSE 0xF1
+#define EMU_FORCE_SENSOR_FLUSH 0xF0
+#define EMU_FLUSH_COMPLETED 0xEF
+#define EMU_BASE_TIMESTAMP 0xFB
+#define EMU_TIMESTAMP_REBASE 0xFA
+
+#define EMU_GYRO_INTEGRATED_RV 0x2A
+#define EMU_MIN_INTERVAL 1000 //Fastest any simulated sensor runs, in microseconds
+
+//Set Feature flags
+#define EMU_FEATURE_CHANGE_RELATIVE 0x01
+#define EMU_FEATURE_CHANGE_ENABLED 0x02
+#define EMU_FEATURE_WAKE_UP 0x04
+
+//Length of each input report we can produce, report ID included. 0 if we don't produce it.
+static uint8_t emuReportLength(uint8_t reportID)
+{
+	switch (reportID)
+	{
+	case 0x10: //Tap detector
+		return 5;
+	case 0x12: //Significant motion
+	case 0x13: //Stability classifier
+	case 0x19: //Shake detector
+	case 0x1C: //Stability detector
+		return 6;
+	case 0x01: //Accelerometer
+	case 0x02: //Gyroscope
+	case 0x03: //Magnetic field
+	case 0x04: //Linear acceleration
+	case 0x06: //Gravity
+		return 10;
+	case 0x08: //Game rotation vector
+	case 0x11: //Step counter
+	case 0x29: //AR/VR stabilized game rotation vector
+		return 12;
+	case 0x05: //Rotation vector
+	case 0x09: //Geomagnetic rotation vector
+	case 0x28: //AR/VR stabilized rotation vector
+	case EMU_GYRO_INTEGRATED_RV:
+		return 14;
+	case 0x07: //Uncalibrated gyroscope
+	case 0x0F: //Uncalibrated magnetic field
+	case 0x14: //Raw accelerometer
+	case 0x15: //Raw gyroscope
+	case 0x16: //Raw magnetometer
+	case 0x1E: //Personal activity classifier
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+//Periods the simulated sensors can run at, in microseconds. Like the real hub, a request is rounded
+//to the next of these that is at least as fast, and the Get Feature Response says which.
+static const uint32_t emuPeriods[] = {1000, 2000, 2500, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000};
+
+static uint32_t emuSupportedInterval(uint32_t interval)
+{
+	uint8_t count = sizeof(emuPeriods) / sizeof(emuPeriods[0]);
+	if (interval == 0 || interval >= emuPeriods[count - 1])
+		return (interval); //Off, or slower than any fixed rate
+	uint8_t x = 0;
+	while (x + 1 < count && emuPeriods[x + 1] <= interval)
+		x++;
+	return (emuPeriods[x]);
+}
+
+static void put16(uint8_t *p, int32_t value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+	p[2] = (value >> 16) & 0xFF;
+	p[3] = (value >> 24) & 0xFF;
+}
+
+//Convert to a Q point fixed value, clamped to int16
+static int16_t toQ(float value, uint8_t qPoint)
+{
+	float scaled = value * (float)(1UL << qPoint);
+	if (scaled > 32767)
+		scaled = 32767;
+	if (scaled < -32768)
+		scaled = -32768;
+	return ((int16_t)lroundf(scaled));
+}
+
+BNO085Emulator::BNO085Emulator()
+{
+	memset(&_faults, 0, sizeof(_faults));
+	memset(&_stats, 0, sizeof(_stats));
+
+	//Add ourselves to the list the shims walk
+	_next = _first;
+	_first = this;
+
+	reset(1); //Power on
+}
+
+BNO085Emulator::~BNO085Emulator()
+{
+	BNO085Emulator **link = &_first;
+	while (*link != NULL)
+	{
+		if (*link == this)
+		{
+			*link = _next;
+			break;
+		}
+		link = &(*link)->_next;
+	}
+}
+
+void BNO085Emulator::attachI2C(TwoWire &wirePort, uint8_t address, uint8_t intPin)
+{
+	_i2cPort = &wirePort;
+	_address = address;
+	_int = intPin;
+}
+
+void BNO085Emulator::attachSPI(SPIClass &spiPort, uint8_t csPin, uint8_t wakePin, uint8_t intPin, uint8_t rstPin)
+{
+	_spiPort = &spiPort;
+	_cs = csPin;
+	_wake = wakePin;
+	_int = intPin;
+	_rst = rstPin;
+}
+
+//Start over as the hub does after a reset: everything off, sequence numbers back to 0
+void BNO085Emulator::reset(uint8_t resetCause)
+{
+	_resetCause = resetCause;
+	_sleeping = false;
+	memset(_features, 0, sizeof(_features));
+	_enabled.clear();
+	_batch.clear();
+	_output.clear();
+	memset(_txSequence, 0, sizeof(_txSequence));
+	memcpy(_channelNumbers, _pendingChannelNumbers, sizeof(_channelNumbers));
+	_transferActive = false;
+	memset(_calibration, 0, sizeof(_calibration));
+
+	//The hub announces itself, says the reset is done, then that the sensor hub is up
+	queueAdvertisement();
+
+	uint8_t resetComplete = 1;
+	queuePacket(EMU_CHANNEL_EXECUTABLE, &resetComplete, 1);
+
+	uint8_t initialized[11] = {0, 1}; //Status 0 (success), subsystem 1 (sensor hub)
+	queueCommandResponse(0x84, 0, initialized, sizeof(initialized)); //Unsolicited initialize response
+
+	checkInterrupt();
+}
+
+void BNO085Emulator::setMaxTransferRead(uint16_t maxTransferRead)
+{
+	if (maxTransferRead < 8)
+		maxTransferRead = 8;
+	_maxTransferRead = maxTransferRead;
+}
+
+void BNO085Emulator::setMaxCargoRead(uint16_t maxCargoPlusHeaderRead)
+{
+	if (maxCargoPlusHeaderRead < 32)
+		maxCargoPlusHeaderRead = 32;
+	_maxCargoRead = maxCargoPlusHeaderRead;
+}
+
+//Put one of the hub's channels on another number, as firmware with a different layout would
+//Takes effect at the next reset, when it is advertised
+void BNO085Emulator::setChannelNumber(uint8_t channel, uint8_t number)
+{
+	if (channel < 6)
+		_pendingChannelNumbers[channel] = number;
+}
+
+void BNO085Emulator::setFifoSize(uint16_t packets)
+{
+	_fifoSize = packets;
+}
+
+void BNO085Emulator::setFaults(const BNO085EmulatorFaults &faults)
+{
+	_faults = faults;
+}
+
+void BNO085Emulator::setSeed(uint32_t seed)
+{
+	_random = (seed == 0) ? 1 : seed;
+}
+
+void BNO085Emulator::setYawRate(float yawRate)
+{
+	_yawRate = yawRate;
+}
+
+//The hub paces its sensors and measures timestamps, delays and the raw report clock with its own oscillator
+void BNO085Emulator::setClockDrift(float ppm)
+{
+	_clockDrift = ppm;
+}
+
+uint64_t BNO085Emulator::hubMicros(uint64_t time)
+{
+	return (time + (int64_t)((double)time * _clockDrift / 1000000.0));
+}
+
+uint64_t BNO085Emulator::hostMicros(uint64_t hubTime)
+{
+	return ((uint64_t)((double)hubTime / (1.0 + _clockDrift / 1000000.0) + 0.5));
+}
+
+uint32_t BNO085Emulator::getReportInterval(uint8_t reportID)
+{
+	return (_features[reportID].interval);
+}
+
+uint32_t BNO085Emulator::getBatchInterval(uint8_t reportID)
+{
+	return (_features[reportID].batchInterval);
+}
+
+const BNO085EmulatorStats &BNO085Emulator::getStats()
+{
+	return (_stats);
+}
+
+void BNO085Emulator::clearStats()
+{
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+//xorshift32, returns 0 to 1
+float BNO085Emulator::random()
+{
+	_random ^= _random << 13;
+	_random ^= _random >> 17;
+	_random ^= _random << 5;
+	return ((float)(_random & 0xFFFFFF) / (float)0x1000000);
+}
+
+//INT is low while there is something to read
+//Over SPI the host also waits for INT before it writes, so the hub says it is ready to
+//receive once the bus has been quiet for a millisecond
+bool BNO085Emulator::intAsserted()
+{
+	if (_output.empty() == false)
+		return (true);
+	if (_spiPort != NULL && _spiSelected == false && hostMicros64() - _spiLastDeselect >= 1000)
+		return (true);
+	return (false);
+}
+
+//Run any interrupt handler attached to INT when it falls
+void BNO085Emulator::checkInterrupt()
+{
+	bool level = (intAsserted() == false);
+	if (_int != 255 && _intLevel == true && level == false)
+	{
+		_intLevel = level;
+		hostRunInterrupt(_int);
+		return;
+	}
+	_intLevel = level;
+}
+
+void BNO085Emulator::queuePacket(uint8_t channel, const uint8_t *cargo, uint16_t length)
+{
+	if (_output.size() >= _fifoSize)
+	{
+		_stats.packetsOverflowed++; //The host isn't keeping up
+		return;
+	}
+
+	Packet packet;
+	packet.channel = channel;
+	packet.repeatSequence = false;
+	packet.offset = 0;
+	packet.cargo.assign(cargo, cargo + length);
+	_output.push_back(packet);
+	_stats.packetsQueued++;
+}
+
+//The advertisement is a list of tag, length, value records describing each application
+//on the hub and its channels. See the SHTP reference manual.
+void BNO085Emulator::queueAdvertisement()
+{
+	std::vector<uint8_t> adv;
+
+	struct Tag
+	{
+		static void add(std::vector<uint8_t> &adv, uint8_t tag, const void *value, uint8_t length)
+		{
+			adv.push_back(tag);
+			adv.push_back(length);
+			adv.insert(adv.end(), (const uint8_t *)value, (const uint8_t *)value + length);
+		}
+		static void add8(std::vector<uint8_t> &adv, uint8_t tag, uint8_t value)
+		{
+			add(adv, tag, &value, 1);
+		}
+		static void add16(std::vector<uint8_t> &adv, uint8_t tag, uint16_t value)
+		{
+			uint8_t v[2] = {(uint8_t)(value & 0xFF), (uint8_t)(value >> 8)};
+			add(adv, tag, v, 2);
+		}
+		static void add32(std::vector<uint8_t> &adv, uint8_t tag, uint32_t value)
+		{
+			uint8_t v[4];
+			put32(v, value);
+			add(adv, tag, v, 4);
+		}
+		static void addString(std::vector<uint8_t> &adv, uint8_t tag, const char *value)
+		{
+			add(adv, tag, value, strlen(value) + 1); //Null terminated
+		}
+	};
+
+	adv.push_back(0); //Advertisement response
+
+	//SHTP itself. Each channel number is followed by its name.
+	Tag::add32(adv, 1, 0);					//GUID
+	Tag::add16(adv, 2, 256);			   //Max cargo plus header, write
+	Tag::add16(adv, 3, _maxCargoRead);	   //Max cargo plus header, read
+	Tag::add16(adv, 4, 256);			   //Max transfer, write
+	Tag::add16(adv, 5, _maxTransferRead); //Max transfer, read
+	Tag::addString(adv, 8, "SHTP");		   //App name
+	Tag::add8(adv, 6, _channelNumbers[EMU_CHANNEL_COMMAND]); //Normal channel
+	Tag::addString(adv, 9, "control");	   //Channel name
+
+	//Executable
+	Tag::add32(adv, 1, 1);
+	Tag::addString(adv, 8, "executable");
+	Tag::add8(adv, 6, _channelNumbers[EMU_CHANNEL_EXECUTABLE]);
+	Tag::addString(adv, 9, "device");
+
+	//Sensor hub
+	Tag::add32(adv, 1, 2);
+	Tag::addString(adv, 8, "sensorhub");
+	Tag::add8(adv, 6, _channelNumbers[EMU_CHANNEL_CONTROL]);
+	Tag::addString(adv, 9, "control");
+	Tag::add8(adv, 6, _channelNumbers[EMU_CHANNEL_REPORTS]);
+	Tag::addString(adv, 9, "inputNormal");
+	Tag::add8(adv, 7, _channelNumbers[EMU_CHANNEL_WAKE_REPORTS]); //Wake channel
+	Tag::addString(adv, 9, "inputWake");
+	Tag::add8(adv, 6, _channelNumbers[EMU_CHANNEL_GYRO]);
+	Tag::addString(adv, 9, "inputGyroRv");
+	Tag::addString(adv, 0x80, "1.0.0"); //SH-2 version
+
+	//SH-2 report lengths, pairs of report ID and length
+	std::vector<uint8_t> lengths;
+	for (uint16_t id = 0; id < 256; id++)
+	{
+		uint8_t length = emuReportLength(id);
+		if (length > 0 && id != EMU_GYRO_INTEGRATED_RV)
+		{
+			lengths.push_back(id);
+			lengths.push_back(length);
+		}
+	}
+	lengths.push_back(EMU_BASE_TIMESTAMP);
+	lengths.push_back(5);
+	lengths.push_back(EMU_TIMESTAMP_REBASE);
+	lengths.push_back(5);
+	Tag::add(adv, 0x81, lengths.data(), lengths.size());
+
+	queuePacket(EMU_CHANNEL_COMMAND, adv.data(), adv.size());
+}
+
+//Command response, see 6.3.9 of the SH-2 reference manual
+void BNO085Emulator::queueCommandResponse(uint8_t command, uint8_t commandSequence, const uint8_t *response, uint8_t length)
+{
+	uint8_t cargo[16];
+	memset(cargo, 0, sizeof(cargo));
+	cargo[0] = EMU_COMMAND_RESPONSE;
+	cargo[1] = _commandSequence++;
+	cargo[2] = command;
+	cargo[3] = commandSequence;
+	cargo[4] = 0; //Response sequence
+	if (length > 11)
+		length = 11;
+	memcpy(&cargo[5], response, length);
+	queuePacket(EMU_CHANNEL_CONTROL, cargo, sizeof(cargo));
+}
+
+void BNO085Emulator::queueFeatureResponse(uint8_t reportID)
+{
+	Feature &f = _features[reportID];
+	uint8_t cargo[17];
+	cargo[0] = EMU_GET_FEATURE_RESPONSE;
+	cargo[1] = reportID;
+	cargo[2] = f.flags;
+	put16(&cargo[3], f.sensitivity);
+	put32(&cargo[5], f.interval);
+	put32(&cargo[9], f.batchInterval);
+	put32(&cargo[13], f.specificConfig);
+	queuePacket(EMU_CHANNEL_CONTROL, cargo, sizeof(cargo));
+}
+
+//Handle a packet written by the host
+void BNO085Emulator::handleHostPacket(const uint8_t *packet, uint16_t length)
+{
+	if (length < 4)
+		return;
+	uint16_t packetLength = ((uint16_t)packet[1] << 8 | packet[0]) & 0x7FFF;
+	if (packetLength < 4)
+		return; //Empty header, the host was only reading
+	if (packetLength > length)
+		packetLength = length; //Short write, use what we got
+
+	_stats.hostPackets++;
+	uint8_t channel = 255;
+	for (uint8_t x = 0; x < 6; x++)
+		if (_channelNumbers[x] == packet[2])
+			channel = x; //Back to our own numbering
+	const uint8_t *cargo = &packet[4];
+	uint16_t cargoLength = packetLength - 4;
+
+	if (channel == EMU_CHANNEL_EXECUTABLE && cargoLength > 0)
+	{
+		if (cargo[0] == 1)
+			reset(2); //Soft reset
+		else if (cargo[0] == 2)
+			_sleeping = false; //On
+		else if (cargo[0] == 3)
+			_sleeping = true; //Sleep
+	}
+	else if (channel == EMU_CHANNEL_CONTROL && cargoLength > 0)
+	{
+		handleControl(cargo, cargoLength);
+	}
+	checkInterrupt();
+}
+
+void BNO085Emulator::handleControl(const uint8_t *cargo, uint16_t length)
+{
+	switch (cargo[0])
+	{
+	case EMU_PRODUCT_ID_REQUEST:
+	{
+		uint8_t response[16];
+		memset(response, 0, sizeof(response));
+		response[0] = EMU_PRODUCT_ID_RESPONSE;
+		response[1] = _resetCause;
+		response[2] = 3;					//SW version major
+		response[3] = 2;					//SW version minor
+		put32(&response[4], 10004563);		//SW part number
+		put32(&response[8], 373);			//SW build number
+		put16(&response[12], 7);			//SW version patch
+		queuePacket(EMU_CHANNEL_CONTROL, response, sizeof(response));
+		break;
+	}
+
+	case EMU_SET_FEATURE_COMMAND:
+		if (length >= 17)
+			setFeature(cargo[1], cargo, length);
+		break;
+
+	case EMU_GET_FEATURE_REQUEST:
+		if (length >= 2)
+			queueFeatureResponse(cargo[1]);
+		break;
+
+	case EMU_FORCE_SENSOR_FLUSH:
+		if (length >= 2)
+		{
+			flushBatch(hostMicros64());
+			uint8_t completed[2] = {EMU_FLUSH_COMPLETED, cargo[1]};
+			queuePacket(EMU_CHANNEL_CONTROL, completed, sizeof(completed));
+		}
+		break;
+
+	case EMU_FRS_READ_REQUEST:
+		if (length >= 8)
+			handleFRSRead(cargo[3] << 8 | cargo[2], cargo[5] << 8 | cargo[4], cargo[7] << 8 | cargo[6]);
+		break;
+
+	case EMU_COMMAND_REQUEST:
+	{
+		if (length < 3)
+			break;
+		uint8_t command = cargo[2];
+		uint8_t response[11];
+		memset(response, 0, sizeof(response));
+		if (command == 0x04) //Initialize
+		{
+			response[1] = 1; //Sensor hub
+			queueCommandResponse(command, cargo[1], response, sizeof(response));
+		}
+		else if (command == 0x06) //Save DCD
+		{
+			queueCommandResponse(command, cargo[1], response, sizeof(response));
+		}
+		else if (command == 0x07 && length >= 12) //ME calibration
+		{
+			if (cargo[6] == 0x00) //Configure
+			{
+				_calibration[0] = cargo[3];
+				_calibration[1] = cargo[4];
+				_calibration[2] = cargo[5];
+				_calibration[3] = cargo[7];
+			}
+			response[1] = _calibration[0];
+			response[2] = _calibration[1];
+			response[3] = _calibration[2];
+			response[4] = _calibration[3];
+			queueCommandResponse(command, cargo[1], response, sizeof(response));
+		}
+		//Other commands (tare, DCD periodic save, etc) have no response
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+//Metadata records for the main sensors. Word 1 is the range and word 2 the resolution,
+//both in the Q point given by the low half of word 7.
+void BNO085Emulator::handleFRSRead(uint16_t offset, uint16_t recordID, uint16_t blockSize)
+{
+	uint32_t record[9];
+	memset(record, 0, sizeof(record));
+	uint8_t qPoint = 0;
+	float range = 0;
+
+	switch (recordID)
+	{
+	case 0xE302: //Accelerometer
+		qPoint = 8;
+		range = 78.4532;
+		break;
+	case 0xE306: //Gyroscope
+		qPoint = 9;
+		range = 34.9066;
+		break;
+	case 0xE309: //Magnetic field
+		qPoint = 4;
+		range = 1300;
+		break;
+	case 0xE30B: //Rotation vector
+		qPoint = 14;
+		range = 1;
+		break;
+	default:
+		break;
+	}
+
+	uint8_t response[16];
+	memset(response, 0, sizeof(response));
+	response[0] = EMU_FRS_READ_RESPONSE;
+	put16(&response[12], recordID);
+
+	if (qPoint == 0)
+	{
+		response[1] = 1; //Unrecognized FRS type
+		queuePacket(EMU_CHANNEL_CONTROL, response, sizeof(response));
+		return;
+	}
+
+	record[0] = 0x01010101;						   //Versions
+	record[1] = (uint32_t)(range * (1UL << qPoint)); //Range
+	record[2] = 1;								   //Resolution, one LSB
+	record[3] = 0x00010000 | 2;					   //Revision 1, 2mA
+	record[4] = EMU_MIN_INTERVAL;				   //Min period
+	record[5] = 100;							   //FIFO size
+	record[7] = qPoint;							   //Q1, Q2 = 0
+	record[8] = (uint32_t)qPoint << 16;			   //Q3
+	const uint16_t recordWords = sizeof(record) / sizeof(record[0]);
+
+	if (offset >= recordWords)
+	{
+		response[1] = 4; //Offset out of range
+		queuePacket(EMU_CHANNEL_CONTROL, response, sizeof(response));
+		return;
+	}
+
+	uint16_t end = recordWords;
+	if (blockSize > 0 && offset + blockSize < end)
+		end = offset + blockSize;
+
+	//Two words per response
+	for (uint16_t word = offset; word < end; word += 2)
+	{
+		uint8_t words = (end - word >= 2) ? 2 : 1;
+		uint8_t status = 0; //No error
+		if (word + words >= end)
+			status = (end == recordWords) ? ((blockSize > 0) ? 7 : 3) : 6; //Record and/or block completed
+		response[1] = (words << 4) | status;
+		put16(&response[2], word);
+		put32(&response[4], record[word]);
+		put32(&response[8], (words > 1) ? record[word + 1] : 0);
+		queuePacket(EMU_CHANNEL_CONTROL, response, sizeof(response));
+	}
+}
+
+//With change sensitivity on, a report is only sent once a field has moved at least that far
+//from what was last sent. Only absolute sensitivity is simulated.
+bool BNO085Emulator::unchanged(Feature &f, const Sample &sample)
+{
+	if ((f.flags & EMU_FEATURE_CHANGE_ENABLED) == 0 || (f.flags & EMU_FEATURE_CHANGE_RELATIVE))
+		return (false);
+
+	uint8_t fields = (sample.length - 4) / 2;
+	if (fields > sizeof(f.lastSent) / sizeof(f.lastSent[0]))
+		fields = sizeof(f.lastSent) / sizeof(f.lastSent[0]);
+	bool changed = (f.sent == false);
+	for (uint8_t x = 0; x < fields; x++)
+	{
+		int16_t value = (int16_t)(sample.report[5 + x * 2] << 8 | sample.report[4 + x * 2]);
+		if (abs(value - f.lastSent[x]) >= f.sensitivity)
+			changed = true;
+	}
+	if (changed == false)
+		return (true);
+
+	for (uint8_t x = 0; x < fields; x++)
+		f.lastSent[x] = (int16_t)(sample.report[5 + x * 2] << 8 | sample.report[4 + x * 2]);
+	f.sent = true;
+	return (false);
+}
+
+void BNO085Emulator::setFeature(uint8_t reportID, const uint8_t *cargo, uint16_t length)
+{
+	(void)length;
+	Feature &f = _features[reportID];
+	bool wasEnabled = (f.interval > 0);
+
+	f.flags = cargo[2];
+	f.sensitivity = cargo[4] << 8 | cargo[3];
+	f.interval = (uint32_t)cargo[8] << 24 | (uint32_t)cargo[7] << 16 | (uint32_t)cargo[6] << 8 | cargo[5];
+	f.batchInterval = (uint32_t)cargo[12] << 24 | (uint32_t)cargo[11] << 16 | (uint32_t)cargo[10] << 8 | cargo[9];
+	f.specificConfig = (uint32_t)cargo[16] << 24 | (uint32_t)cargo[15] << 16 | (uint32_t)cargo[14] << 8 | cargo[13];
+
+	if (emuReportLength(reportID) == 0)
+		f.interval = 0; //Not a sensor we have
+	if (f.interval > 0 && f.interval < EMU_MIN_INTERVAL)
+		f.interval = EMU_MIN_INTERVAL;
+	f.interval = emuSupportedInterval(f.interval);
+	f.nextDue = hubMicros(hostMicros64()) + f.interval;
+	f.sent = false;
+
+	if (f.interval > 0 && wasEnabled == false)
+		_enabled.push_back(reportID);
+	else if (f.interval == 0 && wasEnabled == true)
+	{
+		for (size_t x = 0; x < _enabled.size(); x++)
+			if (_enabled[x] == reportID)
+			{
+				_enabled.erase(_enabled.begin() + x);
+				break;
+			}
+	}
+
+	queueFeatureResponse(reportID); //The hub tells the host whenever a sensor's configuration changes
+}
+
+//Fill in the data fields of a report from the simulated motion: a slow turn about Z with a
+//little wobble on the accelerometer. Returns the report length.
+uint8_t BNO085Emulator::buildReport(uint8_t reportID, uint64_t time, uint8_t *report)
+{
+	uint8_t length = emuReportLength(reportID);
+	memset(report, 0, 16);
+	report[0] = reportID;
+
+	float t = time / 1000000.0;
+	float yaw = fmodf(_yawRate * t, 2 * PI);
+	float wobble = 0.2 * sinf(2 * PI * t);
+	float qk = sinf(yaw / 2);
+	float qr = cosf(yaw / 2);
+
+	uint8_t *d = &report[4]; //Data starts after ID, sequence, status and delay
+	switch (reportID)
+	{
+	case 0x01: //Accelerometer, Q8
+		put16(&d[0], toQ(wobble, 8));
+		put16(&d[4], toQ(9.80665, 8));
+		break;
+	case 0x04: //Linear acceleration, Q8
+		put16(&d[0], toQ(wobble, 8));
+		break;
+	case 0x06: //Gravity, Q8
+		put16(&d[4], toQ(9.80665, 8));
+		break;
+	case 0x02: //Gyroscope, Q9
+		put16(&d[4], toQ(_yawRate, 9));
+		break;
+	case 0x07: //Uncalibrated gyroscope, Q9, then the bias
+		put16(&d[4], toQ(_yawRate + 0.01, 9));
+		put16(&d[10], toQ(0.01, 9));
+		break;
+	case 0x03: //Magnetic field, Q4. North turns the other way as we turn.
+	case 0x0F: //Uncalibrated adds a hard iron offset on X, then the bias
+		put16(&d[0], toQ(30 * cosf(yaw) + ((reportID == 0x0F) ? 5 : 0), 4));
+		put16(&d[2], toQ(-30 * sinf(yaw), 4));
+		put16(&d[4], toQ(-40, 4));
+		if (reportID == 0x0F)
+			put16(&d[6], toQ(5, 4));
+		break;
+	case 0x05: //Rotation vectors, Q14, accuracy Q12
+	case 0x08:
+	case 0x09:
+	case 0x28:
+	case 0x29:
+		put16(&d[4], toQ(qk, 14));
+		put16(&d[6], toQ(qr, 14));
+		if (length >= 14)
+			put16(&d[8], toQ(0.05, 12));
+		break;
+	case EMU_GYRO_INTEGRATED_RV: //No ID, sequence, status or delay. Quaternion Q14, angular velocity Q10.
+		memset(report, 0, 16);
+		put16(&report[4], toQ(qk, 14));
+		put16(&report[6], toQ(qr, 14));
+		put16(&report[12], toQ(_yawRate, 10));
+		break;
+	case 0x11: //Step counter, one step every half second
+		put16(&d[4], (int32_t)(t * 2));
+		break;
+	case 0x13: //Stability classifier: 2 = stable, 3 = in motion
+		d[0] = (_yawRate != 0) ? 3 : 2;
+		break;
+	case 0x12: //Significant motion: 1 = motion
+		d[0] = 1;
+		break;
+	case 0x19: //Shake detector: bit 2 = shake on Z
+		d[0] = 0x04;
+		break;
+	case 0x1C: //Stability detector: bit 1 = left the stable state
+		d[0] = (_yawRate != 0) ? 0x02 : 0x01;
+		break;
+	case 0x1E: //Activity classifier: page 0, last page, most likely on foot, 100% confident
+		d[0] = 0x80;
+		d[1] = 4;
+		d[2 + 4] = 100;
+		break;
+	case 0x14: //Raw sensor ADC counts and a microsecond timestamp
+	case 0x15:
+	case 0x16:
+		put16(&d[0], (int32_t)(wobble * 1000));
+		put16(&d[4], 4096);
+		put32(&d[8], (uint32_t)hubMicros(time));
+		break;
+	default:
+		break; //Events (tap, shake, etc.) just report that they happened
+	}
+	return (length);
+}
+
+//Turn samples into input report packets with a base timestamp. Each report's delay is
+//its time after the base. Delays only have 14 bits so a rebase record moves the base on
+//if a batch is long. A new packet is started when the max cargo size is reached.
+void BNO085Emulator::queueReports(std::vector<Sample> &samples, uint64_t now, uint8_t channel)
+{
+	std::vector<uint8_t> cargo;
+	uint64_t base = 0; //On the hub's clock
+
+	for (size_t x = 0; x < samples.size(); x++)
+	{
+		Sample &s = samples[x];
+
+		if (cargo.size() > 0 && cargo.size() + s.length + 5 > (size_t)_maxCargoRead - 4)
+		{
+			queuePacket(channel, cargo.data(), cargo.size());
+			cargo.clear();
+		}
+
+		if (cargo.size() == 0)
+		{
+			//Base timestamp: how long before the transmission the first report happened, in 100us
+			base = hubMicros(s.time);
+			uint8_t record[5] = {EMU_BASE_TIMESTAMP};
+			put32(&record[1], (uint32_t)((hubMicros(now) - base) / 100));
+			cargo.insert(cargo.end(), record, record + 5);
+		}
+
+		uint32_t delay = (hubMicros(s.time) - base) / 100;
+		if (delay > 0x3FFF)
+		{
+			uint8_t record[5] = {EMU_TIMESTAMP_REBASE};
+			put32(&record[1], delay); //Later than the old base, in 100us
+			cargo.insert(cargo.end(), record, record + 5);
+			base += (uint64_t)delay * 100;
+			delay = (hubMicros(s.time) - base) / 100;
+		}
+
+		Feature &f = _features[s.report[0]];
+		s.report[1] = f.sequence++;
+		s.report[2] = 0x03 | ((delay >> 8) << 2); //High accuracy, delay bits 13:8
+		s.report[3] = delay & 0xFF;
+		cargo.insert(cargo.end(), s.report, s.report + s.length);
+		_stats.reportsGenerated++;
+	}
+
+	if (cargo.size() > 0)
+		queuePacket(channel, cargo.data(), cargo.size());
+}
+
+void BNO085Emulator::flushBatch(uint64_t now)
+{
+	if (_batch.empty())
+		return;
+	queueReports(_batch, now, EMU_CHANNEL_REPORTS);
+	_batch.clear();
+}
+
+//Make every report that is due up to now, in time order
+void BNO085Emulator::update()
+{
+	uint64_t now = hostMicros64();
+	uint64_t hubNow = hubMicros(now); //Sensors are paced by the hub's clock
+
+	if (_sleeping == false)
+	{
+		std::vector<Sample> immediate;
+		while (1)
+		{
+			//Find the sensor that is due first
+			uint8_t dueID = 0;
+			uint64_t dueTime = 0;
+			bool found = false;
+			for (size_t x = 0; x < _enabled.size(); x++)
+			{
+				Feature &f = _features[_enabled[x]];
+				if (f.nextDue <= hubNow && (found == false || f.nextDue < dueTime))
+				{
+					dueID = _enabled[x];
+					dueTime = f.nextDue;
+					found = true;
+				}
+			}
+			if (found == false)
+				break;
+
+			Feature &f = _features[dueID];
+			f.nextDue += f.interval;
+			dueTime = hostMicros(dueTime);
+			if (dueTime > now)
+				dueTime = now; //Rounding
+
+			Sample sample;
+			sample.time = dueTime;
+			sample.length = buildReport(dueID, dueTime, sample.report);
+
+			if (dueID == EMU_GYRO_INTEGRATED_RV)
+			{
+				queuePacket(EMU_CHANNEL_GYRO, sample.report, 14); //Gyro-integrated reports go on their own channel, never batched
+				_stats.reportsGenerated++;
+			}
+			else if (unchanged(f, sample))
+				_stats.reportsSuppressed++;
+			else if (f.flags & EMU_FEATURE_WAKE_UP)
+			{
+				std::vector<Sample> wake(1, sample); //Wake reports go out on their own, on the wake channel
+				queueReports(wake, now, EMU_CHANNEL_WAKE_REPORTS);
+			}
+			else if (f.batchInterval > 0)
+			{
+				if (_batch.empty())
+					_batchStart = dueTime;
+				_batch.push_back(sample);
+			}
+			else
+			{
+				//Reports that fall due together go out in the same packet
+				if (immediate.empty() == false && immediate.back().time != dueTime)
+				{
+					queueReports(immediate, now, EMU_CHANNEL_REPORTS);
+					immediate.clear();
+				}
+				immediate.push_back(sample);
+			}
+		}
+		if (immediate.empty() == false)
+			queueReports(immediate, now, EMU_CHANNEL_REPORTS);
+
+		//The batch goes out when its oldest report has waited as long as any batched sensor allows
+		if (_batch.empty() == false)
+		{
+			uint32_t shortest = 0xFFFFFFFF;
+			for (size_t x = 0; x < _enabled.size(); x++)
+			{
+				Feature &f = _features[_enabled[x]];
+				if (f.batchInterval > 0 && f.batchInterval < shortest)
+					shortest = f.batchInterval;
+			}
+			if (shortest == 0xFFFFFFFF || now - _batchStart >= shortest)
+				flushBatch(now);
+		}
+	}
+
+	checkInterrupt();
+}
+
+//Start a transfer of the packet at the front of the queue
+void BNO085Emulator::beginTransfer()
+{
+	update();
+
+	//Fault: the packet is lost on the way but uses up its sequence number
+	while (_output.empty() == false && _output.front().offset == 0 && _faults.dropPacket > 0 && random() < _faults.dropPacket)
+	{
+		_txSequence[_output.front().channel % 6]++;
+		_output.pop_front();
+		_stats.packetsDropped++;
+	}
+
+	_transferActive = true;
+	if (_output.empty())
+	{
+		memset(_transferHeader, 0, sizeof(_transferHeader));
+		_transferCargo = 0;
+		_stats.emptyReads++;
+		return;
+	}
+
+	Packet &p = _output.front();
+	uint16_t remaining = p.cargo.size() - p.offset;
+	uint16_t length = remaining + 4;
+	if (p.offset > 0)
+		length |= 0x8000; //Continuation
+
+	uint8_t channel = p.channel % 6;
+	_transferHeader[0] = length & 0xFF;
+	_transferHeader[1] = length >> 8;
+	_transferHeader[2] = _channelNumbers[p.channel % 6];
+	if (p.repeatSequence == true)
+	{
+		_transferHeader[3] = _txSequence[channel] - 1;
+		p.repeatSequence = false;
+	}
+	else
+		_transferHeader[3] = _txSequence[channel]++;
+
+	_transferCargo = remaining;
+	if (_transferCargo > _maxTransferRead - 4)
+		_transferCargo = _maxTransferRead - 4;
+	_stats.transfersSent++;
+}
+
+//The byte the hub clocks out at this index of the transfer
+uint8_t BNO085Emulator::transferByte(uint16_t index)
+{
+	if (_transferActive == false)
+		beginTransfer();
+	if (index < 4)
+		return (_transferHeader[index]);
+	if (_output.empty() || _transferCargo == 0)
+		return (0);
+
+	uint16_t cargoIndex = index - 4;
+	if (cargoIndex >= _transferCargo)
+	{
+		if (cargoIndex == _transferCargo && _transferCargo < _output.front().cargo.size() - _output.front().offset)
+			_stats.transferOverruns++; //The host read past the advertised max transfer
+		return (0);
+	}
+
+	uint8_t data = _output.front().cargo[_output.front().offset + cargoIndex];
+	if (_faults.corruptByte > 0 && random() < _faults.corruptByte)
+	{
+		data ^= 1 << (_random % 8);
+		_stats.bytesCorrupted++;
+	}
+	return (data);
+}
+
+//The host clocked this many bytes. Whatever cargo it did not read is sent as a continuation.
+void BNO085Emulator::endTransfer(uint16_t bytesClocked)
+{
+	if (_transferActive == false)
+		return;
+	_transferActive = false;
+
+	if (_transferCargo == 0 || bytesClocked <= 4)
+		return;
+
+	uint16_t cargoRead = bytesClocked - 4;
+	if (cargoRead > _transferCargo)
+		cargoRead = _transferCargo;
+
+	Packet &p = _output.front();
+	p.offset += cargoRead;
+	if (p.offset < p.cargo.size())
+		return; //The rest comes in the next transfer
+
+	Packet done = p;
+	_output.pop_front();
+	_stats.packetsSent++;
+
+	//Fault: send the whole packet again with the same sequence number
+	if (_faults.duplicatePacket > 0 && random() < _faults.duplicatePacket)
+	{
+		done.offset = 0;
+		done.repeatSequence = true;
+		_output.push_front(done);
+		_stats.packetsDuplicated++;
+	}
+}
+
+uint8_t BNO085Emulator::i2cWrite(const uint8_t *data, uint16_t length)
+{
+	update();
+	if (_faults.nackWrite > 0 && random() < _faults.nackWrite)
+	{
+		_stats.writesNacked++;
+		return (2); //NACK on address
+	}
+	handleHostPacket(data, length);
+	return (0);
+}
+
+uint16_t BNO085Emulator::i2cRead(uint8_t *buffer, uint16_t length)
+{
+	update();
+	if (_faults.noResponse > 0 && random() < _faults.noResponse)
+	{
+		_stats.readsIgnored++;
+		return (0);
+	}
+
+	beginTransfer();
+	for (uint16_t x = 0; x < length; x++)
+		buffer[x] = transferByte(x);
+	endTransfer(length);
+	checkInterrupt();
+	return (length);
+}
+
+//One byte of an SPI transaction. Framed by CS in pinWrite().
+uint8_t BNO085Emulator::spiExchange(uint8_t data)
+{
+	if (_spiSelected == false)
+		return (0xFF);
+	uint16_t index = _spiIn.size();
+	_spiIn.push_back(data);
+	return (transferByte(index));
+}
+
+//Returns true if the pin belongs to this emulator
+bool BNO085Emulator::pinWrite(uint8_t pin, uint8_t val)
+{
+	if (_spiPort != NULL && pin == _cs)
+	{
+		if (val == LOW && _spiSelected == false)
+		{
+			_spiSelected = true;
+			_spiIn.clear();
+			update();
+		}
+		else if (val == HIGH && _spiSelected == true)
+		{
+			_spiSelected = false;
+			endTransfer(_spiIn.size());
+			handleHostPacket(_spiIn.data(), _spiIn.size()); //Anything the host sent at the same time
+			_spiLastDeselect = hostMicros64();
+			checkInterrupt();
+		}
+		return (true);
+	}
+	if (_spiPort != NULL && pin == _rst)
+	{
+		if (val == HIGH && _rstLevel == false)
+			reset(4); //External reset
+		_rstLevel = (val == HIGH);
+		return (true);
+	}
+	if (_spiPort != NULL && pin == _wake)
+		return (true);
+	return (false);
+}
+
+bool BNO085Emulator::pinRead(uint8_t pin, int &val)
+{
+	if (pin != _int || _int == 255)
+		return (false);
+	update();
+	val = intAsserted() ? LOW : HIGH;
+	return (true);
+}
@@ -0,0 +1,202 @@
+/*
+  BNO085 SHTP device emulator for host builds
+
+  Plays the part of the sensor hub on the other side of the host Wire and SPI shims, so the
+  library can be built and driven on a Linux box without a board:
+  - Sends the advertisement, reset complete and initialize response after every reset
+  - Answers product ID, set/get feature, command (initialize, save DCD, ME calibration)
+    FRS read and force flush requests
+  - Produces input reports at the configured intervals, rounded to the rates it supports, from a
+    simple simulated motion, with batching, base timestamps, delays and rebase records like the
+    real hub
+  - Splits packets into transfers and continuations the way SHTP does when the host reads less
+    than a whole packet
+  - Runs the hub clock fast or slow on demand, for the timestamps and the raw report clock
+  - Injects faults on demand: dropped and duplicated packets, corrupted bytes, NACKed writes
+    and reads that get no response
+
+  Time comes from the virtual clock in Arduino.h, so runs are repeatable and go at full speed.
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#pragma once
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SPI.h"
+
+#include <deque>
+#include <vector>
+
+//Faults to inject. Each is a probability from 0 to 1.
+struct BNO085EmulatorFaults
+{
+	float dropPacket;	   //The packet is thrown away but its sequence number is used up
+	float duplicatePacket; //The packet is sent twice with the same sequence number
+	float corruptByte;	   //Each payload byte sent may have a bit flipped
+	float nackWrite;	   //An I2C write is not acknowledged and the hub never sees it
+	float noResponse;	   //An I2C read returns no bytes
+};
+
+//What the emulator has done since the last clearStats()
+struct BNO085EmulatorStats
+{
+	uint32_t reportsGenerated;	//Input reports produced by the simulated sensors
+	uint32_t reportsSuppressed; //Reports not sent as they changed less than the change sensitivity
+	uint32_t packetsQueued;		//Packets ready to send to the host
+	uint32_t packetsSent;		//Packets the host read all of
+	uint32_t transfersSent;		//Bus transfers with a non-empty header. One packet can take several.
+	uint32_t emptyReads;		//Reads with nothing to send
+	uint32_t packetsOverflowed; //Packets thrown away because the host did not keep up
+	uint32_t transferOverruns;	//Reads longer than the advertised max transfer. The extra bytes are zeros.
+	uint32_t hostPackets;		//Packets the host wrote to us
+	uint32_t packetsDropped;	//Fault injection counts
+	uint32_t packetsDuplicated;
+	uint32_t bytesCorrupted;
+	uint32_t writesNacked;
+	uint32_t readsIgnored;
+};
+
+class BNO085Emulator
+{
+public:
+	BNO085Emulator();
+	~BNO085Emulator();
+
+	//Connect to a bus. I2C reads and writes to the address go to this emulator.
+	//The INT pin is optional over I2C and goes low while the hub has something to send.
+	void attachI2C(TwoWire &wirePort, uint8_t address = 0x4A, uint8_t intPin = 255);
+	void attachSPI(SPIClass &spiPort, uint8_t csPin, uint8_t wakePin, uint8_t intPin, uint8_t rstPin);
+
+	void reset(uint8_t resetCause = 1); //Same as a power cycle. Cause is reported in the product ID response.
+
+	//Hub limits, as sent in the advertisement
+	void setMaxTransferRead(uint16_t maxTransferRead);	//Largest read the host should do, header included
+	void setMaxCargoRead(uint16_t maxCargoPlusHeaderRead); //Largest packet the hub builds, header included
+	void setFifoSize(uint16_t packets);					//Packets held for the host before new ones are thrown away
+	void setChannelNumber(uint8_t channel, uint8_t number); //Move a channel (0 command to 5 gyro) to another number at the next reset
+
+	void setFaults(const BNO085EmulatorFaults &faults);
+	void setSeed(uint32_t seed);   //Fault injection is repeatable for a given seed
+	void setYawRate(float yawRate); //Simulated rotation about Z in rad/s
+	void setClockDrift(float ppm);	//How much faster the hub clock runs than the host's
+
+	uint32_t getReportInterval(uint8_t reportID); //What the host configured, in microseconds
+	uint32_t getBatchInterval(uint8_t reportID);
+	bool intAsserted();
+	const BNO085EmulatorStats &getStats();
+	void clearStats();
+
+	//Called by the host shims
+	void update(); //Produce any reports that are due by now
+	uint8_t i2cWrite(const uint8_t *data, uint16_t length);
+	uint16_t i2cRead(uint8_t *buffer, uint16_t length);
+	uint8_t spiExchange(uint8_t data);
+	bool pinWrite(uint8_t pin, uint8_t val);
+	bool pinRead(uint8_t pin, int &val);
+	uint8_t i2cAddress() { return (_address); }
+	TwoWire *wirePort() { return (_i2cPort); }
+	SPIClass *spiPort() { return (_spiPort); }
+
+	//All emulators that exist, for the shims to walk
+	static BNO085Emulator *first() { return (_first); }
+	BNO085Emulator *next() { return (_next); }
+
+private:
+	struct Packet
+	{
+		uint8_t channel;
+		bool repeatSequence; //Duplicate: reuse the last sequence number
+		uint16_t offset;	 //Cargo bytes already sent
+		std::vector<uint8_t> cargo;
+	};
+
+	struct Sample
+	{
+		uint64_t time;
+		uint8_t length;
+		uint8_t report[16]; //Report ID, sequence, status and delay are filled in when sent
+	};
+
+	struct Feature
+	{
+		uint8_t flags;
+		uint16_t sensitivity;
+		uint32_t interval;
+		uint32_t batchInterval;
+		uint32_t specificConfig;
+		uint64_t nextDue; //On the hub's clock
+		uint8_t sequence;
+		int16_t lastSent[6]; //Fields of the last report sent, for change sensitivity
+		bool sent;
+	};
+
+	static BNO085Emulator *_first;
+	BNO085Emulator *_next;
+
+	TwoWire *_i2cPort = NULL;
+	SPIClass *_spiPort = NULL;
+	uint8_t _address = 0x4A;
+	uint8_t _cs = 255;
+	uint8_t _wake = 255;
+	uint8_t _int = 255;
+	uint8_t _rst = 255;
+	bool _rstLevel = true;
+	bool _intLevel = true; //Last INT level seen by the host, for edge interrupts
+
+	uint16_t _maxTransferRead = 0x7FFF;
+	uint16_t _maxCargoRead = 1024;
+	uint16_t _fifoSize = 256;
+	BNO085EmulatorFaults _faults;
+	uint32_t _random = 0x12345678;
+	float _yawRate = 0.5;
+	float _clockDrift = 0; //ppm
+	BNO085EmulatorStats _stats;
+
+	//Hub state
+	uint8_t _resetCause = 1;
+	bool _sleeping = false;
+	Feature _features[256];
+	std::vector<uint8_t> _enabled; //Report IDs with a non-zero interval
+	std::vector<Sample> _batch;
+	uint64_t _batchStart = 0;
+	uint8_t _commandSequence = 0;
+	uint8_t _calibration[4] = {0, 0, 0, 0}; //Accel, gyro, mag, planar enables
+
+	//Outgoing packets and the transfer in progress
+	std::deque<Packet> _output;
+	uint8_t _txSequence[6];
+	uint8_t _channelNumbers[6] = {0, 1, 2, 3, 4, 5}; //Number on the bus of each of our channels
+	uint8_t _pendingChannelNumbers[6] = {0, 1, 2, 3, 4, 5};
+	bool _transferActive = false;
+	uint8_t _transferHeader[4];
+	uint16_t _transferCargo = 0; //Cargo bytes this transfer may carry
+
+	//SPI transaction in progress
+	bool _spiSelected = false;
+	std::vector<uint8_t> _spiIn;
+	uint64_t _spiLastDeselect = 0;
+
+	float random();
+	uint64_t hubMicros(uint64_t time); //Host time on the hub's clock
+	uint64_t hostMicros(uint64_t hubTime); //And back
+	void queuePacket(uint8_t channel, const uint8_t *cargo, uint16_t length);
+	void queueAdvertisement();
+	void queueCommandResponse(uint8_t command, uint8_t commandSequence, const uint8_t *response, uint8_t length);
+	void queueFeatureResponse(uint8_t reportID);
+	void queueReports(std::vector<Sample> &samples, uint64_t now, uint8_t channel);
+	bool unchanged(Feature &f, const Sample &sample); //Change sensitivity says not to send it
+	void handleHostPacket(const uint8_t *packet, uint16_t length);
+	void handleControl(const uint8_t *cargo, uint16_t length);
+	void handleFRSRead(uint16_t offset, uint16_t recordID, uint16_t blockSize);
+	void setFeature(uint8_t reportID, const uint8_t *cargo, uint16_t length);
+	void flushBatch(uint64_t now);
+	uint8_t buildReport(uint8_t reportID, uint64_t time, uint8_t *report);
+
+	void beginTransfer();
+	uint8_t transferByte(uint16_t index);
+	void endTransfer(uint16_t bytesClocked);
+	void checkInterrupt();
+};
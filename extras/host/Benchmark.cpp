@@ -0,0 +1,572 @@
+/*
+  Throughput benchmark for the report parser and the float conversions
+
+  Times the hot paths a sketch pays for on every sample:
+  - parseInputReport() on one packet per report type, on a batched packet and on recorded packets
+  - qToFloat() and the old pow() version of it, the getQuat/getAccel style getters,
+    getRoll()/getPitch()/getYaw() and getEuler()
+  - the BNO085Fixed integer math
+
+  Packets are written straight into shtpHeader/shtpData so the bus shims are not part of the
+  numbers. Each case runs until it has taken --min-time milliseconds, five times over, and the
+  fastest run is kept.
+
+  Results go to stdout (or --json FILE) as JSON with one result per line:
+    {"name": "parse/rotation vector", "unit": "ns/packet", "ns": 41.2, "iterations": 1048576, ...}
+  Give --baseline FILE with an earlier output to compare against. Any case more than --tolerance
+  percent slower than the baseline is listed and the exit code is 2.
+
+  Recorded packets (--packets FILE) are one packet per line in hex, four header bytes then cargo.
+  Words ending in ':' are skipped so lines from printPacket() can be pasted in, but printPacket()
+  stops after 40 bytes of cargo. Lines starting with # are comments.
+
+  Build from the repository root (see README.md in this folder):
+    g++ -std=gnu++11 -O2 -Iextras/host -Isrc extras/host/HostArduino.cpp extras/host/BNO085Emulator.cpp \
+      extras/host/Benchmark.cpp src/SparkFun_BNO085_Arduino_Library.cpp -o bno085_benchmark
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#include "Arduino.h"
+#include "SparkFun_BNO085_Arduino_Library.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+struct BenchmarkResult
+{
+	std::string name;
+	const char *unit;
+	double ns;			 //Per unit
+	uint64_t iterations; //In the fastest run
+	uint32_t perIteration; //Units done by each iteration, e.g. reports in a batched packet
+};
+
+struct Packet
+{
+	uint8_t header[4];
+	std::vector<uint8_t> cargo;
+};
+
+static std::vector<BenchmarkResult> _results;
+static double _minTimeNs = 50e6;
+static const char *_filter = NULL;
+static volatile float _sink; //Keeps the compiler from throwing conversions away
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Timing
+
+static double nowNs()
+{
+	return (std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//Run body() enough times to take at least the minimum time, then keep the fastest of five runs
+template <typename Body>
+static void measure(const std::string &name, const char *unit, uint32_t perIteration, Body body)
+{
+	if (_filter != NULL && name.find(_filter) == std::string::npos)
+		return;
+
+	uint64_t iterations = 64;
+	while (true)
+	{
+		double start = nowNs();
+		for (uint64_t x = 0; x < iterations; x++)
+			body();
+		if (nowNs() - start >= _minTimeNs / 8 || iterations >= ((uint64_t)1 << 40))
+			break;
+		iterations *= 2;
+	}
+	iterations *= 8; //Each run now takes about the minimum time
+
+	double best = 0;
+	for (uint8_t run = 0; run < 5; run++)
+	{
+		double start = nowNs();
+		for (uint64_t x = 0; x < iterations; x++)
+			body();
+		double elapsed = nowNs() - start;
+		if (run == 0 || elapsed < best)
+			best = elapsed;
+	}
+
+	BenchmarkResult result;
+	result.name = name;
+	result.unit = unit;
+	result.ns = best / ((double)iterations * perIteration);
+	result.iterations = iterations;
+	result.perIteration = perIteration;
+	_results.push_back(result);
+	fprintf(stderr, "%-44s %10.2f %s\n", name.c_str(), result.ns, unit);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Packets
+
+static Packet makePacket(uint8_t channel, const std::vector<uint8_t> &cargo)
+{
+	Packet packet;
+	uint16_t length = cargo.size() + 4;
+	packet.header[0] = length & 0xFF;
+	packet.header[1] = length >> 8;
+	packet.header[2] = channel;
+	packet.header[3] = 0;
+	packet.cargo = cargo;
+	return (packet);
+}
+
+static void addBaseTimestamp(std::vector<uint8_t> &cargo, uint32_t delta)
+{
+	cargo.push_back(SHTP_REPORT_BASE_TIMESTAMP);
+	for (uint8_t x = 0; x < 4; x++)
+		cargo.push_back((delta >> (8 * x)) & 0xFF);
+}
+
+//A plausible report: ID, sequence, status, delay, then little endian 16-bit values
+static void addReport(std::vector<uint8_t> &cargo, uint8_t reportID, uint8_t length, uint8_t sequence)
+{
+	static const int16_t values[] = {1638, -3277, 4915, 14189, 2621, 100, -200, 300, 50, 60, 70, 80};
+
+	cargo.push_back(reportID);
+	cargo.push_back(sequence);
+	cargo.push_back(0x03); //High accuracy
+	cargo.push_back(0);
+	for (uint8_t x = 4, v = 0; x < length; x += 2, v++)
+	{
+		cargo.push_back(values[v] & 0xFF);
+		if (x + 1 < length)
+			cargo.push_back((uint16_t)values[v] >> 8);
+	}
+}
+
+//Copy a packet into the library's receive buffers as receivePacket() would
+static void loadPacket(BNO085 &myIMU, const Packet &packet)
+{
+	memcpy(myIMU.shtpHeader, packet.header, 4);
+	uint16_t length = packet.cargo.size();
+	if (length > MAX_PACKET_SIZE)
+		length = MAX_PACKET_SIZE;
+	memcpy(myIMU.shtpData, packet.cargo.data(), length);
+}
+
+//Read packets from a file of hex lines. Returns false if the file can't be opened.
+static bool loadRecorded(const char *fileName, std::vector<Packet> &packets)
+{
+	FILE *file = fopen(fileName, "r");
+	if (file == NULL)
+		return (false);
+
+	char line[4096];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		if (line[0] == '#')
+			continue;
+
+		std::vector<uint8_t> bytes;
+		char *word = strtok(line, " \t\r\n");
+		while (word != NULL)
+		{
+			size_t length = strlen(word);
+			if (length > 0 && word[length - 1] == ':')
+			{
+				word = strtok(NULL, " \t\r\n"); //A label like "Header:" or "Body:"
+				continue;
+			}
+			char *end;
+			unsigned long value = strtoul(word, &end, 16);
+			if (length != 2 || *end != '\0')
+				break; //Anything else ends the packet
+			bytes.push_back(value);
+			word = strtok(NULL, " \t\r\n");
+		}
+		if (bytes.size() < 4)
+			continue;
+
+		Packet packet;
+		memcpy(packet.header, bytes.data(), 4);
+		packet.cargo.assign(bytes.begin() + 4, bytes.end());
+
+		//Make the length match what was recorded, keeping the continuation bit
+		uint16_t length = packet.cargo.size() + 4;
+		packet.header[0] = length & 0xFF;
+		packet.header[1] = (packet.header[1] & 0x80) | (length >> 8);
+		packets.push_back(packet);
+	}
+	fclose(file);
+	return (true);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Benchmarks
+
+static void benchmarkParse(BNO085 &myIMU, const std::vector<Packet> &recorded)
+{
+	static const struct
+	{
+		const char *name;
+		uint8_t reportID;
+		uint8_t length;
+	} reports[] = {
+		{"accelerometer", SENSOR_REPORTID_ACCELEROMETER, 10},
+		{"gyroscope", SENSOR_REPORTID_GYROSCOPE, 10},
+		{"magnetometer", SENSOR_REPORTID_MAGNETIC_FIELD, 10},
+		{"linear acceleration", SENSOR_REPORTID_LINEAR_ACCELERATION, 10},
+		{"gravity", SENSOR_REPORTID_GRAVITY, 10},
+		{"rotation vector", SENSOR_REPORTID_ROTATION_VECTOR, 14},
+		{"game rotation vector", SENSOR_REPORTID_GAME_ROTATION_VECTOR, 12},
+		{"geomagnetic rotation vector", SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR, 14},
+		{"ar/vr rotation vector", SENSOR_REPORTID_AR_VR_STABILIZED_ROTATION_VECTOR, 14},
+		{"ar/vr game rotation vector", SENSOR_REPORTID_AR_VR_STABILIZED_GAME_ROTATION_VECTOR, 12},
+		{"tap detector", SENSOR_REPORTID_TAP_DETECTOR, 5},
+		{"step counter", SENSOR_REPORTID_STEP_COUNTER, 12},
+		{"stability classifier", SENSOR_REPORTID_STABILITY_CLASSIFIER, 6},
+		{"activity classifier", SENSOR_REPORTID_PERSONAL_ACTIVITY_CLASSIFIER, 16},
+		{"raw accelerometer", SENSOR_REPORTID_RAW_ACCELEROMETER, 16},
+		{"raw gyroscope", SENSOR_REPORTID_RAW_GYROSCOPE, 16},
+		{"raw magnetometer", SENSOR_REPORTID_RAW_MAGNETOMETER, 16},
+	};
+
+	//One report per packet, like an unbatched sensor
+	for (uint8_t x = 0; x < sizeof(reports) / sizeof(reports[0]); x++)
+	{
+		std::vector<uint8_t> cargo;
+		addBaseTimestamp(cargo, 0);
+		addReport(cargo, reports[x].reportID, reports[x].length, 0);
+		Packet packet = makePacket(CHANNEL_REPORTS, cargo);
+		measure(std::string("parse/") + reports[x].name, "ns/packet", 1, [&]() {
+			loadPacket(myIMU, packet);
+			myIMU.parseInputReport();
+		});
+	}
+
+	//Gyro integrated rotation vector has its own channel and no header fields
+	{
+		std::vector<uint8_t> cargo(14, 0);
+		cargo[6] = 0x00; //Real part 1.0 in Q14
+		cargo[7] = 0x40;
+		Packet packet = makePacket(CHANNEL_GYRO, cargo);
+		measure("parse/gyro integrated rotation vector", "ns/packet", 1, [&]() {
+			loadPacket(myIMU, packet);
+			myIMU.parseInputReport();
+		});
+	}
+
+	//A batch as the hub sends it: base timestamp, then accelerometer and rotation vector reports
+	{
+		std::vector<uint8_t> cargo;
+		addBaseTimestamp(cargo, 120);
+		uint32_t count = 0;
+		for (uint8_t x = 0; cargo.size() + 14 <= MAX_PACKET_SIZE; x++, count++)
+		{
+			if (x & 1)
+				addReport(cargo, SENSOR_REPORTID_ROTATION_VECTOR, 14, x);
+			else
+				addReport(cargo, SENSOR_REPORTID_ACCELEROMETER, 10, x);
+		}
+		Packet packet = makePacket(CHANNEL_REPORTS, cargo);
+		measure("parse/batch", "ns/packet", 1, [&]() {
+			loadPacket(myIMU, packet);
+			myIMU.parseInputReport();
+		});
+		measure("parse/batch per report", "ns/report", count, [&]() {
+			loadPacket(myIMU, packet);
+			myIMU.parseInputReport();
+		});
+	}
+
+	if (recorded.size() > 0)
+	{
+		measure("parse/recorded", "ns/packet", recorded.size(), [&]() {
+			for (size_t x = 0; x < recorded.size(); x++)
+			{
+				loadPacket(myIMU, recorded[x]);
+				myIMU.parseInputReport();
+			}
+		});
+	}
+
+	//The copy into shtpData is in every number above. This is how much of it that is.
+	{
+		std::vector<uint8_t> cargo;
+		addBaseTimestamp(cargo, 0);
+		addReport(cargo, SENSOR_REPORTID_ROTATION_VECTOR, 14, 0);
+		Packet packet = makePacket(CHANNEL_REPORTS, cargo);
+		measure("parse/overhead of loading a packet", "ns/packet", 1, [&]() {
+			loadPacket(myIMU, packet);
+			_sink = myIMU.shtpData[0];
+		});
+	}
+}
+
+//qToFloat() as it was before the scale was built from the exponent bits, for comparison
+static float qToFloatPow(int16_t fixedPointValue, uint8_t qPoint)
+{
+	float qFloat = fixedPointValue;
+	qFloat *= pow(2, qPoint * -1);
+	return (qFloat);
+}
+
+static void benchmarkConvert(BNO085 &myIMU)
+{
+	//Leave a rotation vector, accelerometer and gyro in the library to convert
+	std::vector<uint8_t> cargo;
+	addBaseTimestamp(cargo, 0);
+	addReport(cargo, SENSOR_REPORTID_ROTATION_VECTOR, 14, 0);
+	addReport(cargo, SENSOR_REPORTID_ACCELEROMETER, 10, 0);
+	addReport(cargo, SENSOR_REPORTID_GYROSCOPE, 10, 0);
+	loadPacket(myIMU, makePacket(CHANNEL_REPORTS, cargo));
+	myIMU.parseInputReport();
+
+	int16_t values[256];
+	for (uint16_t x = 0; x < 256; x++)
+		values[x] = (int16_t)(x * 257 - 32768);
+	uint8_t index = 0;
+
+	volatile uint8_t qPointStore = 14; //Read every time, so the compiler cannot fold pow() away
+	measure("convert/qToFloat with pow() (old)", "ns/call", 1, [&]() {
+		_sink = qToFloatPow(values[index++], qPointStore);
+	});
+	measure("convert/qToFloat", "ns/call", 1, [&]() {
+		_sink = myIMU.qToFloat(values[index++], qPointStore);
+	});
+	measure("convert/qToFloat<14>", "ns/call", 1, [&]() {
+		_sink = BNO085::qToFloat<14>(values[index++]);
+	});
+	float converted[BNO085_SAMPLE_WORDS];
+	measure("convert/qToFloat array of 7", "ns/value", BNO085_SAMPLE_WORDS, [&]() {
+		myIMU.qToFloat(&values[index], converted, BNO085_SAMPLE_WORDS, qPointStore);
+		index += BNO085_SAMPLE_WORDS;
+		_sink = converted[0];
+	});
+	BNO085Sample sample = {};
+	sample.reportID = SENSOR_REPORTID_ROTATION_VECTOR;
+	for (uint8_t x = 0; x < BNO085_SAMPLE_WORDS; x++)
+		sample.data[x] = values[x * 31];
+	measure("convert/rotation vector sample, 5 pow() conversions (old)", "ns/sample", 1, [&]() {
+		for (uint8_t x = 0; x < 5; x++)
+			_sink = qToFloatPow(sample.data[x], (x < 4) ? qPointStore : qPointStore - 2);
+	});
+	measure("convert/rotation vector sample, getSampleValues", "ns/sample", 1, [&]() {
+		myIMU.getSampleValues(sample, converted);
+		_sink = converted[4];
+	});
+	measure("convert/getQuatI", "ns/call", 1, [&]() {
+		_sink = myIMU.getQuatI();
+	});
+	measure("convert/quaternion (I, J, K, real, accuracy)", "ns/call", 5, [&]() {
+		_sink = myIMU.getQuatI();
+		_sink = myIMU.getQuatJ();
+		_sink = myIMU.getQuatK();
+		_sink = myIMU.getQuatReal();
+		_sink = myIMU.getQuatRadianAccuracy();
+	});
+	measure("convert/getAccelX", "ns/call", 1, [&]() {
+		_sink = myIMU.getAccelX();
+	});
+	measure("convert/getGyroX", "ns/call", 1, [&]() {
+		_sink = myIMU.getGyroX();
+	});
+	measure("convert/getRoll", "ns/call", 1, [&]() {
+		_sink = myIMU.getRoll();
+	});
+	measure("convert/getPitch", "ns/call", 1, [&]() {
+		_sink = myIMU.getPitch();
+	});
+	measure("convert/getYaw", "ns/call", 1, [&]() {
+		_sink = myIMU.getYaw();
+	});
+	measure("convert/euler (roll, pitch, yaw)", "ns/sample", 1, [&]() {
+		_sink = myIMU.getRoll();
+		_sink = myIMU.getPitch();
+		_sink = myIMU.getYaw();
+	});
+	float roll, pitch, yaw;
+	measure("convert/getEuler", "ns/sample", 1, [&]() {
+		myIMU.getEuler(roll, pitch, yaw);
+		_sink = roll + pitch + yaw;
+	});
+	measure("convert/getEuler fast", "ns/sample", 1, [&]() {
+		myIMU.getEuler(roll, pitch, yaw, true);
+		_sink = roll + pitch + yaw;
+	});
+
+	//Integer only
+	BNO085Quat quat;
+	myIMU.getQuatFixed(quat);
+	BNO085Quat other = BNO085Fixed::conjugate(quat);
+	BNO085Vector vector = {100, 200, 2509};
+	int16_t fixedRoll, fixedPitch, fixedYaw;
+	measure("fixed/euler", "ns/sample", 1, [&]() {
+		BNO085Fixed::euler(quat, fixedRoll, fixedPitch, fixedYaw);
+		_sink = fixedRoll + fixedPitch + fixedYaw;
+	});
+	measure("fixed/heading", "ns/call", 1, [&]() {
+		_sink = BNO085Fixed::heading(quat);
+	});
+	measure("fixed/multiply", "ns/call", 1, [&]() {
+		other = BNO085Fixed::multiply(quat, other);
+		_sink = other.real;
+	});
+	measure("fixed/normalize", "ns/call", 1, [&]() {
+		_sink = BNO085Fixed::normalize(quat).real;
+	});
+	measure("fixed/rotate", "ns/call", 1, [&]() {
+		vector = BNO085Fixed::rotate(quat, vector);
+		_sink = vector.z;
+	});
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Output
+
+static std::string jsonString(const std::string &text)
+{
+	std::string out = "\"";
+	for (size_t x = 0; x < text.size(); x++)
+	{
+		if (text[x] == '"' || text[x] == '\\')
+			out += '\\';
+		out += text[x];
+	}
+	return (out + "\"");
+}
+
+static void writeJSON(FILE *file)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "  \"benchmark\": \"BNO085 parse and convert\",\n");
+#ifdef __VERSION__
+	fprintf(file, "  \"compiler\": %s,\n", jsonString(__VERSION__).c_str());
+#endif
+	fprintf(file, "  \"maxPacketSize\": %d,\n", MAX_PACKET_SIZE);
+	fprintf(file, "  \"results\": [\n");
+	for (size_t x = 0; x < _results.size(); x++)
+	{
+		const BenchmarkResult &r = _results[x];
+		fprintf(file, "    {\"name\": %s, \"unit\": \"%s\", \"ns\": %.3f, \"iterations\": %llu, \"perIteration\": %u}%s\n",
+				jsonString(r.name).c_str(), r.unit, r.ns, (unsigned long long)r.iterations, r.perIteration,
+				x + 1 < _results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+}
+
+//Read the name and ns of each result in an earlier output. Relies on one result per line.
+static bool loadBaseline(const char *fileName, std::map<std::string, double> &baseline)
+{
+	FILE *file = fopen(fileName, "r");
+	if (file == NULL)
+		return (false);
+
+	char line[1024];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		char *name = strstr(line, "\"name\": \"");
+		char *ns = strstr(line, "\"ns\": ");
+		if (name == NULL || ns == NULL)
+			continue;
+		name += 9;
+		char *end = strchr(name, '"');
+		if (end == NULL)
+			continue;
+		baseline[std::string(name, end - name)] = atof(ns + 6);
+	}
+	fclose(file);
+	return (true);
+}
+
+static void usage()
+{
+	fprintf(stderr, "Usage: bno085_benchmark [--json FILE] [--packets FILE] [--min-time MS] [--filter TEXT]\n");
+	fprintf(stderr, "                        [--baseline FILE] [--tolerance PERCENT]\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *jsonFile = NULL;
+	const char *packetFile = NULL;
+	const char *baselineFile = NULL;
+	double tolerance = 10;
+
+	for (int x = 1; x < argc; x++)
+	{
+		std::string arg = argv[x];
+		if (x + 1 >= argc)
+		{
+			usage();
+			return (1);
+		}
+		if (arg == "--json")
+			jsonFile = argv[++x];
+		else if (arg == "--packets")
+			packetFile = argv[++x];
+		else if (arg == "--baseline")
+			baselineFile = argv[++x];
+		else if (arg == "--tolerance")
+			tolerance = atof(argv[++x]);
+		else if (arg == "--min-time")
+			_minTimeNs = atof(argv[++x]) * 1e6;
+		else if (arg == "--filter")
+			_filter = argv[++x];
+		else
+		{
+			usage();
+			return (1);
+		}
+	}
+
+	std::vector<Packet> recorded;
+	if (packetFile != NULL && loadRecorded(packetFile, recorded) == false)
+	{
+		fprintf(stderr, "Can't read %s\n", packetFile);
+		return (1);
+	}
+
+	BNO085 myIMU; //Never begun. The parser and getters don't touch the bus.
+	benchmarkParse(myIMU, recorded);
+	benchmarkConvert(myIMU);
+
+	FILE *out = stdout;
+	if (jsonFile != NULL && (out = fopen(jsonFile, "w")) == NULL)
+	{
+		fprintf(stderr, "Can't write %s\n", jsonFile);
+		return (1);
+	}
+	writeJSON(out);
+	if (out != stdout)
+		fclose(out);
+
+	if (baselineFile != NULL)
+	{
+		std::map<std::string, double> baseline;
+		if (loadBaseline(baselineFile, baseline) == false)
+		{
+			fprintf(stderr, "Can't read %s\n", baselineFile);
+			return (1);
+		}
+
+		uint8_t regressions = 0;
+		for (size_t x = 0; x < _results.size(); x++)
+		{
+			std::map<std::string, double>::iterator before = baseline.find(_results[x].name);
+			if (before == baseline.end() || before->second <= 0)
+				continue;
+			double change = (_results[x].ns / before->second - 1) * 100;
+			if (change > tolerance)
+			{
+				fprintf(stderr, "Slower: %s %.2f -> %.2f %s (%+.1f%%)\n", _results[x].name.c_str(), before->second,
+						_results[x].ns, _results[x].unit, change);
+				regressions++;
+			}
+		}
+		if (regressions > 0)
+			return (2);
+		fprintf(stderr, "No case more than %.0f%% slower than %s\n", tolerance, baselineFile);
+	}
+
+	return (0);
+}
@@ -0,0 +1,644 @@
+/*
+  Drive the BNO085 library against the emulator on a host
+
+  Runs a few scenarios the way a sketch would and prints what the library saw next to what
+  the emulator sent:
+  1. I2C, rotation vector at 100Hz and a batched accelerometer
+  2. I2C with short reads so every packet comes as continuations
+  3. SPI with dropped, duplicated and corrupted packets
+  4. A binary capture of an I2C run, replayed into a second BNO085 object
+  5. Report timestamps and the hub clock estimate, with the hub clock running fast
+  6. A 400Hz accelerometer kept in a sample history and drained in windows
+  7. Four BNO085s on I2C and SPI serviced by a BNO085Manager, one of them quiet and without INT
+  8. Three BNO085s with clocks that drift apart, their rotation vectors aligned by a BNO085Synchronizer
+  9. An accelerometer with a change sensitivity and a rotation vector on the wake channel
+  10. Report rates the hub rounds, read back with Get Feature
+  11. A hub with its channels moved and a short max transfer, over I2C and SPI
+
+  Some scenarios end with checks. The demo exits with 1 if any of them fail.
+
+  Build from the repository root (see README.md in this folder):
+    g++ -std=gnu++11 -O2 -Iextras/host -Isrc extras/host/HostArduino.cpp extras/host/BNO085Emulator.cpp \
+      extras/host/EmulatorDemo.cpp src/SparkFun_BNO085_Arduino_Library.cpp -o bno085_emulator_demo
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SPI.h"
+#include "BNO085Emulator.h"
+#include "SparkFun_BNO085_Arduino_Library.h"
+
+#include <stdio.h>
+#include <vector>
+
+//Holds a capture in memory so it can be replayed
+class CaptureBuffer : public Stream
+{
+public:
+	size_t write(uint8_t c)
+	{
+		bytes.push_back(c);
+		return (1);
+	}
+	using Print::write;
+	int available() { return (bytes.size() - position); }
+	int read() { return (position < bytes.size() ? bytes[position++] : -1); }
+	int peek() { return (position < bytes.size() ? bytes[position] : -1); }
+
+	std::vector<uint8_t> bytes;
+	size_t position = 0;
+};
+
+//Call getReadings() for this long (virtual time) and count the reports that came back
+static uint32_t run(BNO085 &myIMU, uint32_t milliseconds)
+{
+	BNO085Sample queue[64];
+	myIMU.enableSampleQueue(queue, 64);
+
+	uint32_t reports = 0;
+	unsigned long start = millis();
+	while (millis() - start < milliseconds)
+	{
+		myIMU.getReadings();
+		BNO085Sample sample;
+		while (myIMU.readSample(sample))
+			reports++;
+		delayMicroseconds(200); //The rest of the loop
+	}
+
+	myIMU.enableSampleQueue(NULL, 0);
+	return (reports);
+}
+
+//A check that fails the run. Each prints its result so a failure says what went wrong.
+static int failures = 0;
+static void check(bool passed, const char *what)
+{
+	printf("  check %s: %s\n", passed ? "passed" : "FAILED", what);
+	if (passed == false)
+		failures++;
+}
+
+static void printStats(const char *name, BNO085 &myIMU, BNO085Emulator &hub)
+{
+	const BNO085EmulatorStats &e = hub.getStats();
+	BNO085ReceiveStats r = myIMU.getReceiveStats();
+	printf("%s\n", name);
+	printf("  hub:     reports %u, packets queued %u sent %u, transfers %u, dropped %u, duplicated %u, corrupted bytes %u, overflowed %u\n",
+		   e.reportsGenerated, e.packetsQueued, e.packetsSent, e.transfersSent, e.packetsDropped, e.packetsDuplicated, e.bytesCorrupted, e.packetsOverflowed);
+	printf("  library: packets %u, gaps %u, lost %u, duplicates %u, resets %u, reassembled %u, abandoned %u, bytes skipped %u\n",
+		   r.packets, r.gaps, r.lost, r.duplicates, r.resets, myIMU.getTransfersReassembled(), myIMU.getTransfersAbandoned(), myIMU.getBytesSkipped());
+}
+
+//How far a rotation vector sample's time is from when the emulator's yaw had its angle, in us
+//The emulator turns at yawRate from time 0, so the yaw gives the time it was taken
+static double yawTimeError(const BNO085Sample &sample, float yawRate)
+{
+	double yaw = 2 * atan2((double)sample.data[2], (double)sample.data[3]);
+	double expected = fmod(yawRate * (sample.timeMicros / 1000000.0), 2 * PI);
+	double error = fmod(yaw - expected + 3 * PI, 2 * PI) - PI;
+	return (error / yawRate * 1000000.0);
+}
+
+//Timing errors of the samples as the library timed them, before aligning
+static double rawErrorMax[3];
+static double rawErrorTotal[3];
+static uint32_t rawErrorCount[3];
+template <uint8_t device>
+static void rawTiming(const BNO085Sample &sample)
+{
+	double error = fabs(yawTimeError(sample, 10));
+	if (error > rawErrorMax[device])
+		rawErrorMax[device] = error;
+	rawErrorTotal[device] += error;
+	rawErrorCount[device]++;
+}
+
+static BNO085 *markedIMU = NULL;
+static void markedIMUInterrupt()
+{
+	markedIMU->markInterrupt();
+}
+
+int main()
+{
+	//1. I2C, rotation vector at 100Hz and the accelerometer at 50Hz batched for 100ms
+	{
+		BNO085Emulator hub;
+		hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		BNO085 myIMU;
+		if (myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire) == false)
+		{
+			printf("BNO085 not detected over I2C\n");
+			return (1);
+		}
+		myIMU.enableRotationVector(10000);
+		myIMU.enableAccelerometer(20000, 100000);
+		hub.clearStats();
+		uint32_t reports = run(myIMU, 2000);
+		printStats("I2C, 100Hz rotation vector and batched accelerometer, 2s", myIMU, hub);
+		printf("  reports parsed %u, yaw %.3f rad, accel z %.2f m/s^2\n", reports, myIMU.getYaw(), myIMU.getAccelZ());
+	}
+
+	//2. I2C, reading at most 24 bytes of cargo at a time so the hub sends continuations
+	{
+		BNO085Emulator hub;
+		hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		BNO085 myIMU;
+		myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire);
+		myIMU.setMaxReadLength(24);
+		myIMU.enableGyro(5000, 50000);
+		hub.clearStats();
+		uint32_t reports = run(myIMU, 1000);
+		printStats("I2C, batched gyro read in 24 byte pieces, 1s", myIMU, hub);
+		printf("  reports parsed %u, gyro z %.3f rad/s\n", reports, myIMU.getGyroZ());
+
+		//Batch for a second, then drain after 300ms: the batch comes in many 24 byte pieces
+		myIMU.enableGyro(5000, 1000000);
+		myIMU.drainBatch(SENSOR_REPORTID_GYROSCOPE);
+		hub.clearStats();
+		delay(300);
+		uint16_t drained = myIMU.drainBatch(SENSOR_REPORTID_GYROSCOPE);
+		printf("  drained %u reports, hub sent %u\n", drained, hub.getStats().reportsGenerated);
+		check(drained == hub.getStats().reportsGenerated, "drainBatch() counted each report the hub sent once");
+	}
+
+	//3. SPI with faults
+	{
+		BNO085Emulator hub;
+		hub.attachSPI(SPI, 10, 9, 8, 7);
+		BNO085 myIMU;
+		myIMU.beginSPI(10, 9, 8, 7);
+		BNO085ReceiveStats started = myIMU.getReceiveStats();
+		check(started.gaps == 0 && started.lost == 0 && myIMU.getTransfersAbandoned() == 0, "beginSPI() lost nothing");
+
+		BNO085EmulatorFaults faults = {0.02, 0.01, 0.0001, 0, 0};
+		hub.setFaults(faults);
+		hub.setSeed(32); //Drops the packet numbered 255, so the next one starts again from 0
+		myIMU.enableRotationVector(5000);
+		hub.clearStats();
+		myIMU.clearReceiveStats();
+		uint32_t reports = run(myIMU, 2000);
+		printStats("SPI, 200Hz rotation vector with 2% dropped, 1% duplicated packets, 2s", myIMU, hub);
+		printf("  reports parsed %u\n", reports);
+		BNO085ReceiveStats r = myIMU.getReceiveStats();
+		check(r.resets == 0 && r.lost == hub.getStats().packetsDropped, "every dropped packet counted as lost, none as a reset");
+
+		//Now the hub resets on its own. Every channel starts from 0 again.
+		hub.setFaults(BNO085EmulatorFaults());
+		hub.reset();
+		run(myIMU, 200);
+		BNO085ReceiveStats afterReset = myIMU.getReceiveStats();
+		printf("  after a hub reset: gaps %u, resets %u\n", afterReset.gaps, afterReset.resets);
+		check(afterReset.resets > 0 && afterReset.gaps == r.gaps, "the hub reset counted as resets, not gaps");
+	}
+
+	//4. Capture an I2C run with continuations, then replay it as fast as possible
+	{
+		CaptureBuffer capture;
+		BNO085Emulator hub;
+		hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		BNO085 myIMU;
+		myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire);
+		myIMU.setMaxReadLength(24);
+		myIMU.clearReceiveStats();
+		myIMU.enableCapture(capture);
+		myIMU.enableRotationVector(10000);
+		myIMU.enableAccelerometer(20000, 100000);
+		uint32_t reports = run(myIMU, 1000);
+		myIMU.disableCapture();
+		BNO085ReceiveStats live = myIMU.getReceiveStats();
+		printf("Capture of I2C rotation vector and batched accelerometer in 24 byte pieces, 1s\n");
+		printf("  live:    packets %u, reassembled %u, reports parsed %u, yaw %.3f rad, %u bytes captured\n",
+			   live.packets, myIMU.getTransfersReassembled(), reports, myIMU.getYaw(), (uint32_t)capture.bytes.size());
+
+		BNO085 replayIMU;
+		replayIMU.beginReplay(capture);
+		BNO085Sample queue[64];
+		replayIMU.enableSampleQueue(queue, 64);
+		uint32_t replayed = 0;
+		while (replayIMU.replayFinished() == false)
+		{
+			replayIMU.getReadings();
+			BNO085Sample sample;
+			while (replayIMU.readSample(sample))
+				replayed++;
+		}
+		BNO085ReceiveStats r = replayIMU.getReceiveStats();
+		printf("  replay:  packets %u, gaps %u, reassembled %u, reports parsed %u, yaw %.3f rad\n",
+			   r.packets, r.gaps, replayIMU.getTransfersReassembled(), replayed, replayIMU.getYaw());
+	}
+
+	//5. Batched accelerometer and raw accelerometer at 100Hz with a hub clock 150ppm fast
+	{
+		BNO085Emulator hub;
+		hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		hub.setClockDrift(150);
+		BNO085 myIMU;
+		myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire);
+		myIMU.enableAccelerometer(10000, 200000);
+		myIMU.enableRawAccelerometer(10000);
+
+		BNO085Sample queue[64];
+		myIMU.enableSampleQueue(queue, 64);
+		uint64_t lastTime = 0;
+		uint32_t samples = 0;
+		uint32_t backwards = 0;
+		int64_t worstError = 0;
+		uint32_t rawSamples = 0;
+		uint32_t rawClose = 0;
+		int64_t worstAlign = 0;
+		unsigned long start = millis();
+		while (millis() - start < 20000)
+		{
+			myIMU.getReadings();
+			BNO085Sample sample;
+			while (myIMU.readSample(sample))
+			{
+				if (sample.reportID == SENSOR_REPORTID_RAW_ACCELEROMETER && millis() - start > 5000)
+				{
+					//The raw report's hub time, mapped to micros(), should match the time from base and delay
+					//unless the packet sat behind another one and was read late
+					uint32_t hubTime = (uint32_t)(uint16_t)sample.data[5] << 16 | (uint16_t)sample.data[4];
+					uint64_t hub64 = myIMU.getHubMicros() + (int32_t)(hubTime - (uint32_t)myIMU.getHubMicros());
+					int64_t error = (int64_t)(myIMU.hubToHostMicros(hub64) - sample.timeMicros);
+					if (error < 0)
+						error = -error;
+					rawSamples++;
+					if (error < 1000)
+						rawClose++;
+					//And against when the hub really sampled it, in the emulator's time
+					int64_t alignError = (int64_t)myIMU.hubToHostMicros(hub64) - (int64_t)((double)hub64 / (1 + 150e-6) + 0.5);
+					if (alignError < 0)
+						alignError = -alignError;
+					if (alignError > worstAlign)
+						worstAlign = alignError;
+				}
+				if (sample.reportID != SENSOR_REPORTID_ACCELEROMETER)
+					continue;
+				//The hub samples every 10ms from when the sensor was enabled
+				if (samples > 0)
+				{
+					if (sample.timeMicros <= lastTime)
+						backwards++;
+					int64_t error = (int64_t)(sample.timeMicros - lastTime) - 10000;
+					if (error < 0)
+						error = -error;
+					if (error > worstError)
+						worstError = error;
+				}
+				lastTime = sample.timeMicros;
+				samples++;
+			}
+			delayMicroseconds(200); //The rest of the loop
+		}
+		printf("Timestamps of a batched accelerometer, hub clock 150ppm fast, 20s\n");
+		printf("  samples %u, out of order %u, worst interval error %d us\n", samples, backwards, (int)worstError);
+		printf("  micros() vs hub clock %.1f ppm, raw reports after 5s with hub time within 1ms of micros() %u of %u\n", myIMU.getClockDrift(), rawClose, rawSamples);
+		printf("  hubToHostMicros() off from the true sample time by at most %d us\n", (int)worstAlign);
+		check(worstAlign < 1000 && rawSamples > 0, "hub times mapped to micros() within 1ms");
+		check(fabs(myIMU.getClockDrift() + 150) < 5, "clock drift from the report count within 5 ppm");
+	}
+
+	//6. A 400Hz accelerometer kept in a history and drained in windows every 100ms
+	{
+		BNO085Emulator hub;
+		hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		BNO085 myIMU;
+		myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire);
+		BNO085SampleHistory<64> accelHistory;
+		myIMU.enableHistory(SENSOR_REPORTID_ACCELEROMETER, accelHistory);
+		myIMU.enableAccelerometer(2500);
+		hub.clearStats();
+
+		BNO085Sample window[32];
+		uint32_t samples = 0;
+		uint32_t windows = 0;
+		uint32_t gaps = 0;
+		uint64_t lastTime = 0;
+		unsigned long start = millis();
+		unsigned long lastDrain = start;
+		while (millis() - start < 2000)
+		{
+			myIMU.getReadings();
+			if (millis() - lastDrain >= 100)
+			{
+				lastDrain = millis();
+				uint16_t count;
+				while ((count = myIMU.drain(SENSOR_REPORTID_ACCELEROMETER, window, 32)) > 0)
+				{
+					for (uint16_t x = 0; x < count; x++)
+					{
+						if (samples > 0 && window[x].timeMicros - lastTime >= 5000) //A missing sample would leave at least two periods
+							gaps++;
+						lastTime = window[x].timeMicros;
+						samples++;
+					}
+					windows++;
+				}
+			}
+			delayMicroseconds(200); //The rest of the loop
+		}
+		myIMU.enableAccelerometer(0); //Stop, and collect what was still on its way
+		for (uint8_t x = 0; x < 100; x++)
+		{
+			myIMU.getReadings();
+			delay(1);
+		}
+		uint32_t generated = hub.getStats().reportsGenerated;
+		uint16_t count;
+		while ((count = myIMU.drain(SENSOR_REPORTID_ACCELEROMETER, window, 32)) > 0)
+			samples += count;
+		printf("History of a 400Hz accelerometer drained every 100ms, 2s\n");
+		printf("  hub reports %u, drained %u in %u windows, gaps %u, overflows %u\n",
+			   generated, samples, windows, gaps, myIMU.getHistoryOverflows(SENSOR_REPORTID_ACCELEROMETER));
+	}
+
+	//7. Four devices: two on I2C (one with no INT pin, reporting once a second) and two on SPI
+	{
+		BNO085Emulator hubs[4];
+		hubs[0].attachI2C(Wire, 0x4A, 2);
+		hubs[1].attachI2C(Wire, 0x4B);
+		hubs[2].attachSPI(SPI, 10, 9, 8, 7);
+		hubs[3].attachSPI(SPI, 20, 19, 18, 17);
+		BNO085 imus[4];
+		imus[0].begin(0x4A, Wire, 2);
+		imus[1].begin(0x4B, Wire);
+		imus[2].beginSPI(10, 9, 8, 7);
+		imus[3].beginSPI(20, 19, 18, 17);
+		imus[0].enableAccelerometer(5000);
+		imus[1].enableAccelerometer(1000000);
+		imus[2].enableRotationVector(2500);
+		imus[3].enableGyro(5000, 20000);
+
+		BNO085Manager manager;
+		static BNO085Sample queues[4][32];
+		for (uint8_t x = 0; x < 4; x++)
+		{
+			manager.addDevice(imus[x], queues[x], 32);
+			hubs[x].clearStats();
+		}
+
+		uint32_t merged[4] = {0, 0, 0, 0};
+		uint32_t outOfOrder = 0;
+		uint64_t lastTime = 0;
+		unsigned long start = millis();
+		while (millis() - start < 2000)
+		{
+			manager.update();
+			BNO085Sample sample;
+			uint8_t device;
+			while (manager.readSample(sample, device))
+			{
+				if (sample.timeMicros < lastTime)
+					outOfOrder++;
+				lastTime = sample.timeMicros;
+				merged[device]++;
+			}
+			delayMicroseconds(50); //The rest of the loop
+		}
+		printf("Four devices with a BNO085Manager, 2s\n");
+		for (uint8_t x = 0; x < 4; x++)
+		{
+			BNO085DeviceStats stats = manager.getStats(x);
+			printf("  device %u: hub reports %u, merged %u, packets %u, transactions %u, longest wait %u us, latency mean %u max %u us\n",
+				   x, hubs[x].getStats().reportsGenerated, merged[x], stats.packets, stats.transactions, stats.maxWaitMicros,
+				   stats.packets ? (uint32_t)(stats.totalLatencyMicros / stats.packets) : 0, stats.maxLatencyMicros);
+		}
+		printf("  samples out of time order %u\n", outOfOrder);
+	}
+
+	//8. Three devices whose clocks run 100ppm fast, 60ppm slow and 30ppm fast, turning together at 10rad/s.
+	//One has an INT pin marked from an interrupt, one is only polled, one is on SPI.
+	{
+		Wire.setClock(400000);
+		BNO085Emulator hubs[3];
+		hubs[0].attachI2C(Wire, 0x4A, 2);
+		hubs[1].attachI2C(Wire, 0x4B);
+		hubs[2].attachSPI(SPI, 10, 9, 8, 7);
+		const float drifts[3] = {100, -60, 30};
+		BNO085 imus[3];
+		imus[0].begin(0x4A, Wire, 2);
+		imus[1].begin(0x4B, Wire);
+		imus[2].beginSPI(10, 9, 8, 7);
+		imus[0].setReportCallback(SENSOR_REPORTID_ROTATION_VECTOR, rawTiming<0>);
+		imus[1].setReportCallback(SENSOR_REPORTID_ROTATION_VECTOR, rawTiming<1>);
+		imus[2].setReportCallback(SENSOR_REPORTID_ROTATION_VECTOR, rawTiming<2>);
+		markedIMU = &imus[0];
+		attachInterrupt(digitalPinToInterrupt(2), markedIMUInterrupt, FALLING);
+
+		BNO085Manager manager;
+		static BNO085Sample queues[3][32];
+		for (uint8_t x = 0; x < 3; x++)
+		{
+			hubs[x].setClockDrift(drifts[x]);
+			hubs[x].setYawRate(10);
+			imus[x].enableRotationVector(5000);
+			manager.addDevice(imus[x], queues[x], 32);
+		}
+		BNO085Synchronizer sync;
+		sync.begin(manager, SENSOR_REPORTID_ROTATION_VECTOR); //At the interval the hubs confirmed
+		sync.setOutputInterval(5000);
+
+		//Leave the clock estimates 2s to settle, then measure for 28s. The polled device's reads are late
+		//by up to 15ms, so its drift takes this long to pin down to a few ppm.
+		uint32_t sets = 0;
+		uint32_t missing = 0;
+		double alignedMax = 0;
+		double alignedTotal = 0;
+		double spreadMax = 0;
+		unsigned long start = millis();
+		while (millis() - start < 30000)
+		{
+			if (millis() - start == 2000)
+			{
+				//Only count from here on
+				memset(rawErrorMax, 0, sizeof(rawErrorMax));
+				memset(rawErrorTotal, 0, sizeof(rawErrorTotal));
+				memset(rawErrorCount, 0, sizeof(rawErrorCount));
+			}
+			sync.update();
+			BNO085Sample set[3];
+			while (sync.readAligned(set))
+			{
+				if (millis() - start < 2000)
+					continue;
+				sets++;
+				double lowest = 0;
+				double highest = 0;
+				for (uint8_t x = 0; x < 3; x++)
+				{
+					if (set[x].reportID == 0)
+					{
+						missing++;
+						continue;
+					}
+					double error = yawTimeError(set[x], 10);
+					if (fabs(error) > alignedMax)
+						alignedMax = fabs(error);
+					alignedTotal += fabs(error);
+					if (x == 0 || error < lowest)
+						lowest = error;
+					if (x == 0 || error > highest)
+						highest = error;
+				}
+				if (highest - lowest > spreadMax)
+					spreadMax = highest - lowest;
+			}
+			delayMicroseconds(50); //The rest of the loop
+		}
+		detachInterrupt(digitalPinToInterrupt(2));
+		printf("Three drifting devices aligned by a BNO085Synchronizer, 30s\n");
+		for (uint8_t x = 0; x < 3; x++)
+		{
+			printf("  device %u: hub clock %+.0f ppm, estimated micros() drift %+.1f ppm, sample times as read off by mean %.0f max %.0f us, largest correction %u us\n",
+				   x, drifts[x], sync.getClockDrift(x), rawErrorCount[x] ? rawErrorTotal[x] / rawErrorCount[x] : 0, rawErrorMax[x], sync.getMaxCorrection(x));
+		}
+		printf("  sets after 2s %u, missing reports %u, aligned times off by mean %.0f max %.0f us, largest spread in a set %.0f us\n",
+			   sets, missing, sets ? alignedTotal / (sets * 3 - missing) : 0, alignedMax, spreadMax);
+		bool driftClose = true;
+		for (uint8_t x = 0; x < 3; x++)
+			if (fabs(sync.getClockDrift(x) + drifts[x]) > 5) //micros() runs slow by as much as the hub runs fast
+				driftClose = false;
+		check(driftClose, "every device's estimated drift within 5 ppm of its hub clock");
+	}
+
+	//9. Accelerometer at 100Hz only sent when it moves by 0.1m/s^2, rotation vector on the wake channel
+	{
+		BNO085Emulator hub;
+		hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		BNO085 myIMU;
+		myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire);
+		myIMU.setChangeSensitivity(SENSOR_REPORTID_ACCELEROMETER, 26); //0.1m/s^2 in Q8
+		myIMU.setWakeUp(SENSOR_REPORTID_ROTATION_VECTOR, true);
+		myIMU.enableAccelerometer(10000);
+		myIMU.enableRotationVector(20000);
+		hub.clearStats();
+		myIMU.clearReportCounts();
+		uint32_t reports = run(myIMU, 5000);
+		const BNO085EmulatorStats &e = hub.getStats();
+		printStats("I2C, accelerometer with change sensitivity and a wake-up rotation vector, 5s", myIMU, hub);
+		printf("  reports parsed %u, hub suppressed %u, library counted accelerometer %u received %u suppressed, rotation vector %u received\n",
+			   reports, e.reportsSuppressed, myIMU.getReportsReceived(SENSOR_REPORTID_ACCELEROMETER),
+			   myIMU.getSuppressedReports(SENSOR_REPORTID_ACCELEROMETER), myIMU.getReportsReceived(SENSOR_REPORTID_ROTATION_VECTOR));
+		int32_t missed = (int32_t)e.reportsSuppressed - (int32_t)myIMU.getSuppressedReports(SENSOR_REPORTID_ACCELEROMETER);
+		check(missed >= -1 && missed <= 1, "held back accelerometer reports counted to within one");
+	}
+
+	//10. Ask for rates the hub does not have and read back what it used
+	{
+		BNO085Emulator hub;
+		hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		BNO085 myIMU;
+		myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire);
+		const uint8_t ids[2] = {SENSOR_REPORTID_ACCELEROMETER, SENSOR_REPORTID_ROTATION_VECTOR};
+		const long requested[2] = {16667, 3000}; //60Hz and 333Hz
+		bool confirmed[2];
+		for (uint8_t x = 0; x < 2; x++)
+			confirmed[x] = myIMU.setFeatureCommand(ids[x], requested[x]);
+
+		BNO085Sample queue[64];
+		myIMU.enableSampleQueue(queue, 64);
+		uint32_t counts[2] = {0, 0};
+		unsigned long start = millis();
+		while (millis() - start < 2000)
+		{
+			myIMU.getReadings();
+			BNO085Sample sample;
+			while (myIMU.readSample(sample))
+				counts[(sample.reportID == ids[0]) ? 0 : 1]++;
+			delayMicroseconds(200);
+		}
+		myIMU.enableSampleQueue(NULL, 0);
+
+		BNO085Feature feature;
+		bool asked = myIMU.requestFeature(ids[1], feature);
+		printf("Requested rates the hub rounds, read back with Get Feature, 2s\n");
+		for (uint8_t x = 0; x < 2; x++)
+			printf("  report 0x%02X: requested %ld us, confirmed %s, hub uses %u us (%.1f Hz), measured %.1f Hz\n", ids[x], requested[x],
+				   confirmed[x] ? "yes" : "no", myIMU.getReportInterval(ids[x]), myIMU.getReportRate(ids[x]), counts[x] / 2.0);
+		printf("  get feature request for 0x%02X: %s, interval %u us, batch %u us, flags 0x%02X\n", ids[1], asked ? "answered" : "no answer",
+			   feature.interval, feature.batchInterval, feature.flags);
+
+		//The same with the answers read in 8 byte pieces
+		myIMU.setMaxReadLength(8);
+		bool changed = myIMU.setFeatureCommand(ids[0], 50000);
+		BNO085Feature again;
+		bool askedAgain = myIMU.requestFeature(ids[1], again);
+		printf("  in 8 byte pieces: 0x%02X at 20Hz confirmed %s, hub uses %u us; 0x%02X %s, interval %u us\n", ids[0], changed ? "yes" : "no",
+			   myIMU.getReportInterval(ids[0]), ids[1], askedAgain ? "answered" : "no answer", again.interval);
+		check(changed && myIMU.getReportInterval(ids[0]) == 50000 && askedAgain && again.interval == feature.interval,
+			  "Get Feature Responses in pieces were read whole");
+	}
+
+	//11. A hub with its channels moved and short reads, found from its advertisement, over I2C then SPI
+	for (uint8_t spi = 0; spi < 2; spi++)
+	{
+		BNO085Emulator hub;
+		if (spi)
+			hub.attachSPI(SPI, 10, 9, 8, 7);
+		else
+			hub.attachI2C(Wire, BNO085_DEFAULT_ADDRESS);
+		hub.setChannelNumber(CHANNEL_CONTROL, 6);
+		hub.setChannelNumber(CHANNEL_REPORTS, 9);
+		hub.setChannelNumber(CHANNEL_GYRO, 3);
+		hub.setMaxTransferRead(64);
+		BNO085 myIMU;
+		bool started = spi ? myIMU.beginSPI(10, 9, 8, 7) : myIMU.begin(BNO085_DEFAULT_ADDRESS, Wire);
+		if (started == false)
+		{
+			printf("BNO085 with moved channels not detected over %s\n", spi ? "SPI" : "I2C");
+			return (1);
+		}
+		if (spi == 0)
+		{
+			Wire.setBufferSize(256); //Reads could now be longer than the hub's transfers
+			myIMU.setI2CBufferLength(256);
+		}
+		myIMU.enableRotationVector(10000);
+		myIMU.enableAccelerometer(20000, 100000);
+		myIMU.enableGyroIntegratedRotationVector(10000);
+		hub.clearStats();
+		uint32_t reports = run(myIMU, 2000);
+		while (hub.getStats().packetsSent < hub.getStats().packetsQueued)
+			reports += run(myIMU, 1); //Finish the packet still on its way, so every report queued can be counted
+		Wire.setBufferSize(BUFFER_LENGTH);
+
+		BNO085Advertisement advertisement;
+		bool advertised = myIMU.getAdvertisement(advertisement);
+		printStats(spi ? "SPI, channels moved and 64 byte max transfer read, 2s" : "I2C, channels moved and 64 byte max transfer read, 256 byte Wire buffer, 2s", myIMU, hub);
+		printf("  advertised: max cargo read %u write %u, max transfer read %u write %u, %u channels:",
+			   advertisement.maxCargoRead, advertisement.maxCargoWrite, advertisement.maxTransferRead, advertisement.maxTransferWrite, advertisement.channelCount);
+		BNO085Channel channel;
+		for (uint8_t x = 0; myIMU.getChannel(x, channel); x++)
+			printf(" %u%s", channel.number, channel.wake ? "(wake)" : "");
+		printf("\n  reports parsed %u, reads past the max transfer %u, control on %u, reports on %u, gyro on %u\n", reports, hub.getStats().transferOverruns,
+			   myIMU.getChannelNumber(CHANNEL_CONTROL), myIMU.getChannelNumber(CHANNEL_REPORTS), myIMU.getChannelNumber(CHANNEL_GYRO));
+		check(advertised && advertisement.channelCount == 6 && myIMU.getChannelNumber(CHANNEL_CONTROL) == 6 && myIMU.getChannelNumber(CHANNEL_REPORTS) == 9 && myIMU.getChannelNumber(CHANNEL_GYRO) == 3,
+			  "advertisement parsed and the moved channels found");
+		check(reports > 0 && reports == hub.getStats().reportsGenerated, "every report the hub sent was parsed");
+		check(hub.getStats().transferOverruns == 0, "no read past the advertised max transfer");
+		BNO085ReceiveStats r = myIMU.getReceiveStats();
+		check(r.gaps == 0 && r.lost == 0 && myIMU.getTransfersAbandoned() == 0, "no packet lost or abandoned");
+
+		if (spi)
+		{
+			//Write while reports are waiting. SPI clocks them out under the write.
+			myIMU.clearReceiveStats();
+			for (uint8_t x = 0; x < 20; x++)
+			{
+				delay(7);
+				myIMU.requestCalibrationStatus();
+			}
+			run(myIMU, 100);
+			BNO085ReceiveStats w = myIMU.getReceiveStats();
+			printf("  20 writes with reports waiting: packets %u, gaps %u, lost %u, abandoned %u\n", w.packets, w.gaps, w.lost, myIMU.getTransfersAbandoned());
+			check(w.gaps == 0 && w.lost == 0 && myIMU.getTransfersAbandoned() == 0, "packets read during a write were kept");
+		}
+	}
+
+	return ((failures > 0) ? 1 : 0);
+}
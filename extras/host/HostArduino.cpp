@@ -0,0 +1,383 @@
+/*
+  Minimal Arduino core for host builds: virtual clock, pins, interrupts, Print, Serial, Wire and SPI
+  See Arduino.h
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SPI.h"
+#include "BNO085Emulator.h"
+
+#include <stdio.h>
+
+HardwareSerial Serial;
+TwoWire Wire;
+SPIClass SPI;
+
+//Every digitalRead() costs this much virtual time so polling loops move the clock forward
+#define HOST_PIN_READ_MICROS 1
+
+//The clock moves in steps no longer than this so emulator events land close to their time
+#define HOST_CLOCK_STEP_MICROS 100
+
+static uint64_t _hostMicros = 0;
+static double _hostFraction = 0; //Part of a microsecond left over from bus transfers
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Virtual clock
+
+uint64_t hostMicros64(void)
+{
+	return (_hostMicros);
+}
+
+void hostAdvanceMicros(uint32_t us)
+{
+	while (us > 0)
+	{
+		uint32_t step = (us > HOST_CLOCK_STEP_MICROS) ? HOST_CLOCK_STEP_MICROS : us;
+		_hostMicros += step;
+		us -= step;
+		for (BNO085Emulator *device = BNO085Emulator::first(); device != NULL; device = device->next())
+			device->update();
+	}
+}
+
+//Time taken to clock this many bits at this bus speed
+static void hostAdvanceBits(uint32_t bits, uint32_t clock)
+{
+	if (clock == 0)
+		return;
+	_hostFraction += (double)bits * 1000000.0 / clock;
+	uint32_t whole = (uint32_t)_hostFraction;
+	_hostFraction -= whole;
+	hostAdvanceMicros(whole);
+}
+
+unsigned long micros(void)
+{
+	return ((unsigned long)(uint32_t)_hostMicros);
+}
+
+unsigned long millis(void)
+{
+	return ((unsigned long)(uint32_t)(_hostMicros / 1000));
+}
+
+void delay(unsigned long ms)
+{
+	hostAdvanceMicros(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	hostAdvanceMicros(us);
+}
+
+void yield(void)
+{
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Pins and interrupts
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	(void)pin;
+	(void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+	for (BNO085Emulator *device = BNO085Emulator::first(); device != NULL; device = device->next())
+		if (device->pinWrite(pin, val))
+			return;
+}
+
+int digitalRead(uint8_t pin)
+{
+	hostAdvanceMicros(HOST_PIN_READ_MICROS);
+	int val = HIGH;
+	for (BNO085Emulator *device = BNO085Emulator::first(); device != NULL; device = device->next())
+		if (device->pinRead(pin, val))
+			break;
+	return (val);
+}
+
+#define HOST_MAX_INTERRUPTS 8
+static struct
+{
+	uint8_t pin;
+	void (*handler)(void);
+} _hostInterrupts[HOST_MAX_INTERRUPTS];
+static uint8_t _hostInterruptCount = 0;
+static bool _hostInterruptsEnabled = true;
+static bool _hostInterruptPending[256];
+static bool _hostInHandler = false;
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+	(void)mode; //Handlers run on the falling edge of the emulator's INT pin
+	for (uint8_t x = 0; x < _hostInterruptCount; x++)
+		if (_hostInterrupts[x].pin == interruptNum)
+		{
+			_hostInterrupts[x].handler = userFunc;
+			return;
+		}
+	if (_hostInterruptCount < HOST_MAX_INTERRUPTS)
+	{
+		_hostInterrupts[_hostInterruptCount].pin = interruptNum;
+		_hostInterrupts[_hostInterruptCount].handler = userFunc;
+		_hostInterruptCount++;
+	}
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+	for (uint8_t x = 0; x < _hostInterruptCount; x++)
+		if (_hostInterrupts[x].pin == interruptNum)
+			_hostInterrupts[x].handler = NULL;
+}
+
+void hostRunInterrupt(uint8_t pin)
+{
+	if (_hostInterruptsEnabled == false || _hostInHandler == true)
+	{
+		_hostInterruptPending[pin] = true; //Runs when interrupts are enabled again
+		return;
+	}
+	for (uint8_t x = 0; x < _hostInterruptCount; x++)
+		if (_hostInterrupts[x].pin == pin && _hostInterrupts[x].handler != NULL)
+		{
+			_hostInHandler = true;
+			_hostInterrupts[x].handler();
+			_hostInHandler = false;
+		}
+}
+
+void noInterrupts(void)
+{
+	_hostInterruptsEnabled = false;
+}
+
+void interrupts(void)
+{
+	_hostInterruptsEnabled = true;
+	for (uint16_t pin = 0; pin < 256; pin++)
+		if (_hostInterruptPending[pin])
+		{
+			_hostInterruptPending[pin] = false;
+			hostRunInterrupt(pin);
+		}
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Print and Serial
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+		n += write(*buffer++);
+	return (n);
+}
+
+size_t Print::printNumber(unsigned long long n, uint8_t base)
+{
+	char buf[8 * sizeof(long long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2)
+		base = 10;
+	do
+	{
+		char c = n % base;
+		n /= base;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return (write(str));
+}
+
+size_t Print::printFloat(double number, uint8_t digits)
+{
+	if (isnan(number))
+		return (print("nan"));
+	if (isinf(number))
+		return (print("inf"));
+
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.*f", digits, number);
+	return (write(buf));
+}
+
+size_t Print::print(const __FlashStringHelper *s) { return (write(reinterpret_cast<const char *>(s))); }
+size_t Print::print(const char s[]) { return (write(s)); }
+size_t Print::print(char c) { return (write((uint8_t)c)); }
+size_t Print::print(unsigned char n, int base) { return (print((unsigned long)n, base)); }
+size_t Print::print(int n, int base) { return (print((long)n, base)); }
+size_t Print::print(unsigned int n, int base) { return (print((unsigned long)n, base)); }
+size_t Print::print(long n, int base) { return (print((long long)n, base)); }
+size_t Print::print(unsigned long n, int base) { return (print((unsigned long long)n, base)); }
+size_t Print::print(long long n, int base)
+{
+	if (base == 10 && n < 0)
+		return (print('-') + printNumber((unsigned long long)(-n), 10));
+	if (base == 0)
+		return (write((uint8_t)n));
+	return (printNumber((unsigned long long)n, base));
+}
+size_t Print::print(unsigned long long n, int base)
+{
+	if (base == 0)
+		return (write((uint8_t)n));
+	return (printNumber(n, base));
+}
+size_t Print::print(double n, int digits) { return (printFloat(n, digits)); }
+
+size_t Print::println(void) { return (write("\r\n")); }
+size_t Print::println(const __FlashStringHelper *s) { return (print(s) + println()); }
+size_t Print::println(const char s[]) { return (print(s) + println()); }
+size_t Print::println(char c) { return (print(c) + println()); }
+size_t Print::println(unsigned char n, int base) { return (print(n, base) + println()); }
+size_t Print::println(int n, int base) { return (print(n, base) + println()); }
+size_t Print::println(unsigned int n, int base) { return (print(n, base) + println()); }
+size_t Print::println(long n, int base) { return (print(n, base) + println()); }
+size_t Print::println(unsigned long n, int base) { return (print(n, base) + println()); }
+size_t Print::println(long long n, int base) { return (print(n, base) + println()); }
+size_t Print::println(unsigned long long n, int base) { return (print(n, base) + println()); }
+size_t Print::println(double n, int digits) { return (print(n, digits) + println()); }
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	if (c != '\r')
+		putchar(c);
+	return (1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+	for (size_t x = 0; x < size; x++)
+		write(buffer[x]);
+	return (size);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Wire
+
+static BNO085Emulator *findI2CDevice(TwoWire *port, uint8_t address)
+{
+	for (BNO085Emulator *device = BNO085Emulator::first(); device != NULL; device = device->next())
+		if (device->wirePort() == port && device->i2cAddress() == address)
+			return (device);
+	return (NULL);
+}
+
+void TwoWire::setClock(uint32_t clockFrequency)
+{
+	_clock = clockFrequency;
+}
+
+void TwoWire::setBufferSize(uint16_t bufferSize)
+{
+	if (bufferSize > sizeof(_rxBuffer))
+		bufferSize = sizeof(_rxBuffer);
+	_bufferSize = bufferSize;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	_txAddress = address;
+	_txLength = 0;
+}
+
+//Returns 0 on success, 2 if the address was not acknowledged
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+	(void)sendStop;
+	hostAdvanceBits((1 + _txLength) * 9, _clock); //Address byte, data bytes, one ack bit each
+
+	BNO085Emulator *device = findI2CDevice(this, _txAddress);
+	if (device == NULL)
+		return (2);
+	return (device->i2cWrite(_txBuffer, _txLength));
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool sendStop)
+{
+	(void)sendStop;
+	_rxIndex = 0;
+	_rxLength = 0;
+	if (quantity > _bufferSize)
+		quantity = _bufferSize;
+
+	hostAdvanceBits((1 + quantity) * 9, _clock);
+
+	BNO085Emulator *device = findI2CDevice(this, address);
+	if (device == NULL)
+		return (0);
+	_rxLength = device->i2cRead(_rxBuffer, quantity);
+	return (_rxLength);
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+	if (_txLength >= sizeof(_txBuffer))
+		return (0);
+	_txBuffer[_txLength++] = data;
+	return (1);
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+	size_t n = 0;
+	while (quantity--)
+		n += write(*data++);
+	return (n);
+}
+
+int TwoWire::available()
+{
+	return (_rxLength - _rxIndex);
+}
+
+int TwoWire::read()
+{
+	if (_rxIndex >= _rxLength)
+		return (-1);
+	return (_rxBuffer[_rxIndex++]);
+}
+
+int TwoWire::peek()
+{
+	if (_rxIndex >= _rxLength)
+		return (-1);
+	return (_rxBuffer[_rxIndex]);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//SPI
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+	_clock = settings.clock;
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+	hostAdvanceBits(8, _clock);
+	uint8_t incoming = 0xFF; //Deselected devices leave MISO high
+	for (BNO085Emulator *device = BNO085Emulator::first(); device != NULL; device = device->next())
+		if (device->spiPort() == this)
+			incoming &= device->spiExchange(data);
+	return (incoming);
+}
+
+void SPIClass::transfer(void *buffer, size_t count)
+{
+	uint8_t *bytes = (uint8_t *)buffer;
+	for (size_t x = 0; x < count; x++)
+		bytes[x] = transfer(bytes[x]);
+}
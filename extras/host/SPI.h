@@ -0,0 +1,47 @@
+/*
+  Host version of the Arduino SPI library
+
+  Bytes go to the BNO085Emulator attached to this port (see BNO085Emulator::attachSPI).
+  The emulator watches its CS pin through digitalWrite() to frame each transaction.
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#pragma once
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+
+class SPISettings
+{
+public:
+	SPISettings(uint32_t clock = 4000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0) : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+	uint32_t clock;
+	uint8_t bitOrder;
+	uint8_t dataMode;
+};
+
+class SPIClass
+{
+public:
+	void begin() {}
+	void end() {}
+	void beginTransaction(SPISettings settings);
+	void endTransaction() {}
+
+	uint8_t transfer(uint8_t data);
+	void transfer(void *buffer, size_t count);
+
+private:
+	uint32_t _clock = 4000000;
+};
+
+extern SPIClass SPI;
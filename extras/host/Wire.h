@@ -0,0 +1,47 @@
+/*
+  Host version of the Arduino Wire library
+
+  Transactions go to the BNO085Emulator attached to this port (see BNO085Emulator::attachI2C).
+  Like the AVR core, a single requestFrom() returns at most 32 bytes. Use setBufferSize()
+  to model platforms with a larger Wire buffer.
+
+  SparkFun code, firmware, and software is released under the MIT License.
+	Please see LICENSE.md for further details.
+*/
+
+#pragma once
+
+#include "Arduino.h"
+
+#define BUFFER_LENGTH 32
+
+class TwoWire : public Stream
+{
+public:
+	void begin() {}
+	void setClock(uint32_t clockFrequency);
+	void setBufferSize(uint16_t bufferSize);
+
+	void beginTransmission(uint8_t address);
+	uint8_t endTransmission(bool sendStop = true);
+	uint8_t requestFrom(uint8_t address, size_t quantity, bool sendStop = true);
+
+	size_t write(uint8_t data);
+	size_t write(const uint8_t *data, size_t quantity);
+	using Print::write;
+	int available();
+	int read();
+	int peek();
+
+private:
+	uint32_t _clock = 100000;
+	uint16_t _bufferSize = BUFFER_LENGTH;
+	uint8_t _txAddress = 0;
+	uint8_t _txBuffer[512];
+	uint16_t _txLength = 0;
+	uint8_t _rxBuffer[512];
+	uint16_t _rxLength = 0;
+	uint16_t _rxIndex = 0;
+};
+
+extern TwoWire Wire;
@@ -24,12 +24,104 @@
 
 #include "SparkFun_BNO085_Arduino_Library.h"
 
+//Stops the compiler moving memory reads and writes across this point. The sample queue and
+//history fill a slot, then publish it with the volatile head. volatile alone does not keep the
+//slot copy ahead of that write, so an interrupt could otherwise publish a slot not yet filled.
+#define BNO085_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+const uint8_t BNO085_TRANSPORTS = 0; //Every BNO085 refers to this. See the header.
+
+//Sensor reports by ID: length, Q point, fields at that Q point, Q point of the rest, where it is stored
+//Lengths and Q points come from the report descriptions in the SH-2 reference manual
+static constexpr BNO085ReportDescriptor reportDescriptors[BNO085_REPORT_ID_COUNT] PROGMEM = {
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x00
+	{10, 8, 3, 0, BNO085_STORE_ACCEL},			  //0x01 Accelerometer
+	{10, 9, 3, 0, BNO085_STORE_GYRO},			  //0x02 Gyroscope
+	{10, 4, 3, 0, BNO085_STORE_MAG},			  //0x03 Magnetic field
+	{10, 8, 3, 0, BNO085_STORE_LINEAR_ACCEL},	  //0x04 Linear acceleration
+	{14, 14, 4, 12, BNO085_STORE_QUAT},			  //0x05 Rotation vector
+	{10, 8, 3, 0, BNO085_STORE_GRAVITY},		  //0x06 Gravity
+	{16, 9, 6, 0, BNO085_STORE_UNCALIBRATED_GYRO}, //0x07 Uncalibrated gyroscope
+	{12, 14, 4, 0, BNO085_STORE_QUAT},			  //0x08 Game rotation vector
+	{14, 14, 4, 12, BNO085_STORE_QUAT},			  //0x09 Geomagnetic rotation vector
+	{8, 0, 0, 0, BNO085_STORE_NONE},			  //0x0A Pressure
+	{8, 0, 0, 0, BNO085_STORE_NONE},			  //0x0B Ambient light
+	{6, 8, 1, 0, BNO085_STORE_NONE},			  //0x0C Humidity
+	{6, 4, 1, 0, BNO085_STORE_NONE},			  //0x0D Proximity
+	{6, 7, 1, 0, BNO085_STORE_NONE},			  //0x0E Temperature
+	{16, 4, 6, 0, BNO085_STORE_UNCALIBRATED_MAG},  //0x0F Uncalibrated magnetic field
+	{5, 0, 0, 0, BNO085_STORE_TAP},				  //0x10 Tap detector
+	{12, 0, 0, 0, BNO085_STORE_STEP},			  //0x11 Step counter
+	{6, 0, 0, 0, BNO085_STORE_SIGNIFICANT_MOTION}, //0x12 Significant motion
+	{6, 0, 0, 0, BNO085_STORE_STABILITY},		  //0x13 Stability classifier
+	{16, 0, 0, 0, BNO085_STORE_RAW_ACCEL},		  //0x14 Raw accelerometer
+	{16, 0, 0, 0, BNO085_STORE_RAW_GYRO},		  //0x15 Raw gyroscope
+	{16, 0, 0, 0, BNO085_STORE_RAW_MAG},		  //0x16 Raw magnetometer
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x17
+	{8, 0, 0, 0, BNO085_STORE_NONE},			  //0x18 Step detector
+	{6, 0, 0, 0, BNO085_STORE_SHAKE},			  //0x19 Shake detector
+	{6, 0, 0, 0, BNO085_STORE_NONE},			  //0x1A Flip detector
+	{6, 0, 0, 0, BNO085_STORE_NONE},			  //0x1B Pickup detector
+	{6, 0, 0, 0, BNO085_STORE_STABILITY_DETECTOR}, //0x1C Stability detector
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x1D
+	{16, 0, 0, 0, BNO085_STORE_ACTIVITY},		  //0x1E Personal activity classifier
+	{6, 0, 0, 0, BNO085_STORE_NONE},			  //0x1F Sleep detector
+	{6, 0, 0, 0, BNO085_STORE_NONE},			  //0x20 Tilt detector
+	{6, 0, 0, 0, BNO085_STORE_NONE},			  //0x21 Pocket detector
+	{6, 0, 0, 0, BNO085_STORE_NONE},			  //0x22 Circle detector
+	{6, 0, 0, 0, BNO085_STORE_NONE},			  //0x23 Heart rate monitor
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x24
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x25
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x26
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x27
+	{14, 14, 4, 12, BNO085_STORE_QUAT},			  //0x28 AR/VR stabilized rotation vector
+	{12, 14, 4, 0, BNO085_STORE_QUAT},			  //0x29 AR/VR stabilized game rotation vector
+	{14, 14, 4, 10, BNO085_STORE_NONE},			  //0x2A Gyro-integrated rotation vector. Normally comes on the gyro channel.
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x2B
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x2C
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x2D
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x2E
+	{0, 0, 0, 0, BNO085_STORE_NONE},			  //0x2F
+};
+
+//Applications and channels the library uses, by the names the hub advertises them with
+static const char applicationNames[3][11] PROGMEM = {"SHTP", "executable", "sensorhub"};
+struct BNO085ChannelName
+{
+	uint8_t application; //Index in applicationNames
+	char name[12];
+	uint8_t role; //CHANNEL_x
+};
+static const BNO085ChannelName channelNames[BNO085_CHANNEL_COUNT] PROGMEM = {
+	{0, "control", CHANNEL_COMMAND},
+	{1, "device", CHANNEL_EXECUTABLE},
+	{2, "control", CHANNEL_CONTROL},
+	{2, "inputNormal", CHANNEL_REPORTS},
+	{2, "inputWake", CHANNEL_WAKE_REPORTS},
+	{2, "inputGyroRv", CHANNEL_GYRO},
+};
+
+//True if the null terminated name matches one stored in PROGMEM
+static bool nameMatches(const uint8_t *name, const char *storedName)
+{
+	for (uint8_t x = 0;; x++)
+	{
+		char c = pgm_read_byte(&storedName[x]);
+		if (name[x] != (uint8_t)c)
+			return (false);
+		if (c == 0)
+			return (true);
+	}
+}
+
+#ifndef BNO085_NO_I2C
 //Attempt communication with the device
 //Return true if we got a 'Polo' back from Marco
-bool BNO085::begin(uint8_t deviceAddress, TwoWire &wirePort, uint8_t intPin)
+bool BNO085::begin(uint8_t deviceAddress, TwoWire &wirePort, uint8_t intPin, uint16_t i2cBufferLength)
 {
 	_deviceAddress = deviceAddress; //If provided, store the I2C address from user
 	_i2cPort = &wirePort;			//Grab which port the user wants us to use
+	setI2CBufferLength(i2cBufferLength);
 	_int = intPin;					//Get the pin that the user wants to use for interrupts. By default, it's 255 and we'll not use it in dataAvailable() function.
 	if (_int != 255)
 	{
@@ -77,10 +169,14 @@ bool BNO085::begin(uint8_t deviceAddress, TwoWire &wirePort, uint8_t intPin)
 
 	return (false); //Something went wrong
 }
+#endif
 
+#ifndef BNO085_NO_SPI
 bool BNO085::beginSPI(uint8_t user_CSPin, uint8_t user_WAKPin, uint8_t user_INTPin, uint8_t user_RSTPin, uint32_t spiPortSpeed, SPIClass &spiPort)
 {
+#ifndef BNO085_NO_I2C
 	_i2cPort = NULL; //This null tells the send/receive functions to use SPI
+#endif
 
 	//Get user settings
 	_spiPort = &spiPort;
@@ -117,14 +213,22 @@ bool BNO085::beginSPI(uint8_t user_CSPin, uint8_t user_WAKPin, uint8_t user_INTP
 	//At system startup, the hub must send its full advertisement message (see 5.2 and 5.3) to the
 	//host. It must not send any other data until this step is complete.
 	//When BNO085 first boots it broadcasts big startup packet
-	//Read it and dump it
+	//It is parsed as it is read: channel numbers and transfer sizes follow it from here on
+	//Until then reads are SHTP_FIRST_TRANSFER_READ long, so it comes as continuations. Read them all.
 	waitForSPI(); //Wait for assertion of INT before reading advert message.
-	receivePacket();
+	while (receivePacket() == true && _rxTransferRemaining > 0)
+		waitForSPI();
 
-	//The BNO085 will then transmit an unsolicited Initialize Response (see 6.4.5.2)
-	//Read it and dump it
-	waitForSPI(); //Wait for assertion of INT before reading Init response
-	receivePacket();
+	//The BNO085 will then transmit a reset message and an unsolicited Initialize Response (see 6.4.5.2)
+	//Read and dump them all. SPI is full duplex: anything still queued when the product ID request
+	//goes out would be clocked out under it and lost.
+	for (uint8_t packets = 0; packets < 8; packets++)
+	{
+		if (waitForSPI() == false || receivePacket() == false)
+			break; //Nothing more
+		if (_rxTransferRemaining == 0 && shtpHeader[2] == CHANNEL_CONTROL && shtpData[0] == SHTP_REPORT_COMMAND_RESPONSE && (shtpData[2] & 0x7F) == COMMAND_INITIALIZE)
+			break; //The Initialize Response is the last thing sent after a reset
+	}
 
 	//Check communication with device
 	shtpData[0] = SHTP_REPORT_PRODUCT_ID_REQUEST; //Request the product ID and reset info
@@ -159,6 +263,7 @@ bool BNO085::beginSPI(uint8_t user_CSPin, uint8_t user_WAKPin, uint8_t user_INTP
 
 	return (false); //Something went wrong
 }
+#endif
 
 //Calling this function with nothing sets the debug port to Serial
 //You can also call it with other streams like Serial1, SerialUSB, etc.
@@ -168,6 +273,50 @@ void BNO085::enableDebugging(Stream &debugPort)
 	_printDebug = true;
 }
 
+#ifndef BNO085_NO_I2C
+//Set the size of the Wire receive buffer. Reads from the BNO085 are chunked to fit it.
+//I2C_BUFFER_LENGTH is detected for common platforms. Use this if your platform has a larger buffer.
+void BNO085::setI2CBufferLength(uint16_t i2cBufferLength)
+{
+	if (i2cBufferLength < 8)
+		i2cBufferLength = 8; //We need room for the 4 byte header and some data
+	_i2cBufferLength = i2cBufferLength;
+
+	if (_i2cSingleReadLength > _i2cBufferLength)
+		_i2cSingleReadLength = _i2cBufferLength;
+}
+
+//Read the header and up to this many bytes (header included) in a single I2C transaction
+//Packets that fit need only one read instead of a header read plus a data read.
+//Packets that are shorter are padded by the BNO085, so pick the size of the packets you expect.
+//Set to 0 to read the header on its own first (the default)
+void BNO085::setI2CSingleReadLength(uint16_t readLength)
+{
+	if (readLength > _i2cBufferLength)
+		readLength = _i2cBufferLength;
+	_i2cSingleReadLength = readLength;
+}
+
+//Returns the total number of bytes read over I2C since the last clearI2CByteCounts()
+uint32_t BNO085::getI2CBytesRead()
+{
+	return (_i2cBytesRead);
+}
+
+//Returns how many of the bytes read over I2C were packet headers
+//Each read transaction starts with the 4 byte header, so this is the cost of chunking
+uint32_t BNO085::getI2CHeaderBytesRead()
+{
+	return (_i2cHeaderBytesRead);
+}
+
+void BNO085::clearI2CByteCounts()
+{
+	_i2cBytesRead = 0;
+	_i2cHeaderBytesRead = 0;
+}
+#endif
+
 //Updates the latest variables if possible
 //Returns false if new readings are not available
 bool BNO085::dataAvailable(void)
@@ -176,6 +325,20 @@ bool BNO085::dataAvailable(void)
 }
 
 uint16_t BNO085::getReadings(void)
+{
+	if (_rxTransferRemaining == 0)
+		_reportsUpdated = 0; //Clear the reports found by the last call
+
+	if (receiveAnnouncedPacket() == true)
+	{
+		return dispatchPacket();
+	}
+	return 0;
+}
+
+//Read the next packet, timed from the INT edge that announced it
+//Returns false if there is nothing to read
+bool BNO085::receiveAnnouncedPacket(void)
 {
 	//If we have an interrupt pin connection available, check if data is available.
 	//If int pin is not set, then we'll rely on receivePacket() to timeout
@@ -183,28 +346,390 @@ uint16_t BNO085::getReadings(void)
 	if (_int != 255)
 	{
 		if (digitalRead(_int) == HIGH)
-			return 0;
+			return (false);
 	}
+	_rxIntMarked = _intPending; //If the ISR saw the edge, time the packet from it
+	_intPending = false;
 
-	if (receivePacket() == true)
+	return (receivePacket());
+}
+
+//Handle a packet that has been fully received
+//Returns the ID of the first sensor report, or the command response ID
+uint16_t BNO085::dispatchPacket(void)
+{
+	if (_rxTransferRemaining > 0)
+		return 0; //Wait for the rest of the transfer
+
+	//Check to see if this packet is a sensor reporting its data to us
+	//Sensor reports are parsed by streamByte() as they come off the bus, so there is nothing left to do but report them
+	if ((shtpHeader[2] == CHANNEL_REPORTS || shtpHeader[2] == CHANNEL_WAKE_REPORTS) && shtpData[0] == SHTP_REPORT_BASE_TIMESTAMP)
+	{
+		return _packetFirstReportID; //The rawAccelX, etc variables have been updated depending on which feature reports were found
+	}
+	else if (shtpHeader[2] == CHANNEL_CONTROL)
+	{
+		return parseCommandReport(); //This will update responses to commands, calibrationStatus, etc.
+	}
+	else if (shtpHeader[2] == CHANNEL_GYRO)
+	{
+		return _packetFirstReportID; //The rawQuatI, etc variables have been updated
+	}
+	return 0;
+}
+
+//Non-blocking version of getReadings()
+//Each call does at most one bus transaction and returns right away. Call it as often as you can.
+//The receive is split into steps: idle (check INT), header, payload (one I2C chunk per call) and dispatch.
+//Over SPI the header and payload are read in one step because CS must stay low for the whole packet.
+//Returns the same as getReadings() on the call that completes a packet, 0 otherwise
+uint16_t BNO085::poll(void)
+{
+	switch (_rxState)
 	{
-		//Check to see if this packet is a sensor reporting its data to us
-		if (shtpHeader[2] == CHANNEL_REPORTS && shtpData[0] == SHTP_REPORT_BASE_TIMESTAMP)
+	case SHTP_RX_IDLE:
+		//If we have an interrupt pin connection available, check if data is available.
+		if (_int != 255 && digitalRead(_int) == HIGH)
+			return 0;
+
+		if (_rxTransferRemaining == 0)
+			_reportsUpdated = 0; //Clear the reports found by the last transfer
+		_rxIntMarked = _intPending;
+		_intPending = false;
+		_rxState = SHTP_RX_HEADER;
+		//Start reading right away
+		//Fall through
+
+	case SHTP_RX_HEADER:
+		if (readsWholePackets())
+		{
+			if (receivePacket() == false)
+			{
+				_rxState = SHTP_RX_IDLE;
+				return 0;
+			}
+			_rxState = SHTP_RX_DISPATCH;
+			return 0;
+		}
+
+#ifndef BNO085_NO_I2C
+		if (receiveI2CHeader(false) == false)
 		{
-			return parseInputReport(); //This will update the rawAccelX, etc variables depending on which feature report is found
+			_rxState = SHTP_RX_IDLE; //Error or nothing to read
+			return 0;
 		}
-		else if (shtpHeader[2] == CHANNEL_CONTROL)
+		if (_rxDataSpot < _rxDataLength)
+			_rxState = SHTP_RX_PAYLOAD;
+		else
+			_rxState = SHTP_RX_DISPATCH;
+		return 0;
+
+	case SHTP_RX_PAYLOAD:
+	{
+		uint16_t numberOfBytesRead = getDataChunk(_rxDataLength - _rxDataSpot, _rxDataSpot, false);
+		if (numberOfBytesRead == 0)
 		{
-			return parseCommandReport(); //This will update responses to commands, calibrationStatus, etc.
+			abortTransfer(); //Give up on this packet
+			_rxState = SHTP_RX_IDLE;
+			return 0;
 		}
-    else if(shtpHeader[2] == CHANNEL_GYRO)
-    {
-      return parseInputReport(); //This will update the rawAccelX, etc variables depending on which feature report is found
-    }
+		_rxDataSpot += numberOfBytesRead;
+		if (_rxDataSpot >= _rxDataLength)
+			_rxState = SHTP_RX_DISPATCH;
+		return 0;
+	}
+#endif
+
+	case SHTP_RX_DISPATCH:
+		if (readsWholePackets() == false)
+			endFragment(_rxDataLength); //SPI and replay finished their fragment in receivePacket()
+		_rxState = SHTP_RX_IDLE;
+		return dispatchPacket();
 	}
+
 	return 0;
 }
 
+//Call this from your INT pin interrupt handler. It only records that the edge happened, and when.
+//Do the bus work from loop() with poll() or getReadings(). Reading the BNO085 from inside an interrupt
+//blocks for the whole transfer and updates the getAccelX(), etc values while loop() may be reading them.
+void BNO085::markInterrupt(void)
+{
+	_intMicros = micros();
+	_intPending = true;
+}
+
+//Returns true if markInterrupt() has been called since the last packet was read
+bool BNO085::interruptPending(void)
+{
+	return (_intPending);
+}
+
+//Give the library an array to queue decoded samples in
+//Every sensor report that is parsed is copied into the queue with its timestamp, so none are lost
+//between reads. The queue is single producer (whatever reads the BNO085) / single consumer (readSample).
+//It holds up to queueSize - 1 samples. Pass NULL to stop queueing.
+void BNO085::enableSampleQueue(BNO085Sample *queue, uint8_t queueSize)
+{
+	_sampleQueue = NULL; //Stop the producer while we reset the indexes
+	_sampleHead = 0;
+	_sampleTail = 0;
+	_sampleQueueOverflows = 0;
+	_sampleQueueSize = queueSize;
+	if (queueSize >= 2)
+		_sampleQueue = queue;
+}
+
+//Copy the oldest queued sample into sample
+//Returns false if the queue is empty
+bool BNO085::readSample(BNO085Sample &sample)
+{
+	uint8_t tail = _sampleTail;
+	if (_sampleQueue == NULL || tail == _sampleHead)
+		return (false); //Nothing queued
+
+	BNO085_BARRIER();
+	sample = _sampleQueue[tail];
+
+	if (++tail >= _sampleQueueSize)
+		tail = 0;
+	BNO085_BARRIER();
+	_sampleTail = tail; //Hand the slot back to the producer
+	return (true);
+}
+
+//Copy the oldest queued sample into sample, leaving it in the queue
+//Returns false if the queue is empty
+bool BNO085::peekSample(BNO085Sample &sample)
+{
+	uint8_t tail = _sampleTail;
+	if (_sampleQueue == NULL || tail == _sampleHead)
+		return (false);
+
+	BNO085_BARRIER();
+	sample = _sampleQueue[tail];
+	return (true);
+}
+
+//Returns the number of samples waiting in the queue
+uint8_t BNO085::samplesAvailable(void)
+{
+	if (_sampleQueue == NULL)
+		return (0);
+
+	uint8_t head = _sampleHead;
+	uint8_t tail = _sampleTail;
+	if (head >= tail)
+		return (head - tail);
+	return (_sampleQueueSize - tail + head);
+}
+
+//Returns the number of samples dropped because the queue was full
+//Use this to size the queue
+uint32_t BNO085::getSampleQueueOverflows(void)
+{
+	return (_sampleQueueOverflows);
+}
+
+//Keep every sample of reportID in history, as well as queueing it
+//Declare the history with its size, for example BNO085SampleHistory<128> accelHistory;
+//A report can have one history. Enabling another for the same report replaces it.
+void BNO085::enableHistory(uint8_t reportID, BNO085History &history)
+{
+	disableHistory(reportID);
+	history.clear();
+	history._reportID = reportID;
+	history._next = _histories;
+	_histories = &history; //Publish it once it is ready
+}
+
+//Stop keeping samples of reportID. What is in the history is left there.
+void BNO085::disableHistory(uint8_t reportID)
+{
+	BNO085History **link = &_histories;
+	while (*link != NULL)
+	{
+		if ((*link)->_reportID == reportID)
+		{
+			*link = (*link)->_next;
+			return;
+		}
+		link = &(*link)->_next;
+	}
+}
+
+BNO085History *BNO085::findHistory(uint8_t reportID)
+{
+	for (BNO085History *history = _histories; history != NULL; history = history->_next)
+		if (history->_reportID == reportID)
+			return (history);
+	return (NULL);
+}
+
+//Copy up to maxSamples of the oldest samples of reportID into destination, and remove them
+//Returns the number copied, 0 if there is no history for reportID
+uint16_t BNO085::drain(uint8_t reportID, BNO085Sample *destination, uint16_t maxSamples)
+{
+	BNO085History *history = findHistory(reportID);
+	if (history == NULL)
+		return (0);
+	return (history->drain(destination, maxSamples));
+}
+
+//Returns the number of samples of reportID waiting to be drained
+uint16_t BNO085::historyAvailable(uint8_t reportID)
+{
+	BNO085History *history = findHistory(reportID);
+	if (history == NULL)
+		return (0);
+	return (history->available());
+}
+
+//Returns the number of samples of reportID dropped because its history was full
+uint32_t BNO085::getHistoryOverflows(uint8_t reportID)
+{
+	BNO085History *history = findHistory(reportID);
+	if (history == NULL)
+		return (0);
+	return (history->getOverflows());
+}
+
+//Add a sample at the head. If the history is full the sample is dropped, as in the sample queue.
+bool BNO085History::push(const BNO085Sample &sample)
+{
+	uint16_t head = _head;
+	uint16_t nextHead = head + 1;
+	if (nextHead >= _size)
+		nextHead = 0;
+	if (nextHead == _tail)
+	{
+		_overflows++;
+		return (false);
+	}
+
+	_samples[head] = sample;
+
+	BNO085_BARRIER();
+	_head = nextHead; //Publish the sample
+	return (true);
+}
+
+//Copy the oldest samples out in at most two runs, one up to the end of the buffer and one from the start
+uint16_t BNO085History::drain(BNO085Sample *destination, uint16_t maxSamples)
+{
+	uint16_t head = _head;
+	uint16_t tail = _tail;
+	uint16_t copied = 0;
+	BNO085_BARRIER();
+
+	while (copied < maxSamples && tail != head)
+	{
+		uint16_t run = (head > tail) ? head - tail : _size - tail;
+		if (run > maxSamples - copied)
+			run = maxSamples - copied;
+		memcpy(&destination[copied], &_samples[tail], run * sizeof(BNO085Sample));
+		copied += run;
+		tail += run;
+		if (tail >= _size)
+			tail = 0;
+	}
+
+	BNO085_BARRIER();
+	_tail = tail; //Hand the slots back to the producer
+	return (copied);
+}
+
+//Returns the number of samples waiting to be drained
+uint16_t BNO085History::available()
+{
+	uint16_t head = _head;
+	uint16_t tail = _tail;
+	if (head >= tail)
+		return (head - tail);
+	return (_size - tail + head);
+}
+
+//Throw away everything in the history and reset the overflow count
+//Only call this when nothing is adding to it, for example before enableHistory()
+void BNO085History::clear()
+{
+	_head = 0;
+	_tail = 0;
+	_overflows = 0;
+}
+
+//Turn a parsed report into a BNO085Sample for its callback and the sample queue
+//Nothing is copied if there is neither
+void BNO085::deliverSample(uint8_t reportID, uint8_t *report, uint8_t reportLength)
+{
+	BNO085SampleCallback callback = NULL;
+	if (reportID < BNO085_REPORT_ID_COUNT)
+		callback = _reportCallbacks[reportID];
+	if (callback == NULL && _sampleQueue == NULL && _histories == NULL)
+		return;
+
+	BNO085Sample sample;
+	sample.reportID = reportID;
+	sample.timeStamp = timeStamp;
+	sample.timeMicros = _reportMicros;
+
+	//The gyro channel reports have no ID, sequence, status or delay bytes
+	uint8_t spot = 4;
+	sample.status = report[2] & 0x03;
+	sample.sequence = report[1];
+	if (reportID == SENSOR_REPORTID_GYRO_INTEGRATED_ROTATION_VECTOR && _streamChannel == CHANNEL_GYRO)
+	{
+		spot = 0;
+		sample.status = 0;
+		sample.sequence = 0;
+	}
+
+	for (uint8_t x = 0; x < BNO085_SAMPLE_WORDS; x++)
+	{
+		uint16_t lsb = (spot < reportLength) ? report[spot] : 0;
+		uint16_t msb = (spot + 1 < reportLength) ? report[spot + 1] : 0;
+		sample.data[x] = (int16_t)(msb << 8 | lsb);
+		spot += 2;
+	}
+
+	if (callback != NULL)
+		callback(sample);
+	queueSample(sample);
+
+	BNO085History *history = findHistory(reportID);
+	if (history != NULL)
+		history->push(sample);
+}
+
+//Copy a sample into the sample queue, if there is one
+//Only the producer writes _sampleHead, and the barrier keeps the slot filled before the new head is published
+void BNO085::queueSample(const BNO085Sample &sample)
+{
+	if (_sampleQueue == NULL)
+		return;
+
+	uint8_t head = _sampleHead;
+	uint8_t nextHead = head + 1;
+	if (nextHead >= _sampleQueueSize)
+		nextHead = 0;
+	if (nextHead == _sampleTail)
+	{
+		_sampleQueueOverflows++; //Queue is full. Drop the newest sample.
+		return;
+	}
+
+	_sampleQueue[head] = sample;
+
+	BNO085_BARRIER();
+	_sampleHead = nextHead; //Publish the sample
+}
+
+//Returns the current step of the non-blocking receive
+uint8_t BNO085::getReceiveState(void)
+{
+	return (_rxState);
+}
+
 //This function pulls the data from the command response report
 
 //Unit responds with packet that contains the following:
@@ -236,6 +761,13 @@ uint16_t BNO085::parseCommandReport(void)
 		}
 		return shtpData[0];
 	}
+	else if (shtpData[0] == SHTP_REPORT_GET_FEATURE_RESPONSE)
+	{
+		uint16_t dataLength = ((uint16_t)shtpHeader[1] << 8 | shtpHeader[0]) & ~(1 << 15);
+		if (dataLength >= 4 + 17)
+			storeFeature(shtpData);
+		return shtpData[0];
+	}
 	else
 	{
 		//This sensor report ID is unhandled.
@@ -261,162 +793,940 @@ uint16_t BNO085::parseCommandReport(void)
 //shtpData[5 + 8:9]: k/accel z/gyro z/etc
 //shtpData[5 + 10:11]: real/gyro temp/etc
 //shtpData[5 + 12:13]: Accuracy estimate
+//Additional feature reports may be strung together after the first one. Each one is
+//walked using its known length (see getReportLength) and parsed in turn.
+//receivePacket() already does this as the bytes arrive. This re-parses whatever is in shtpData.
+//Returns the ID of the first report found. Use getUpdatedReports() to see all of them.
 uint16_t BNO085::parseInputReport(void)
 {
 	//Calculate the number of data bytes in this packet
-	int16_t dataLength = ((uint16_t)shtpHeader[1] << 8 | shtpHeader[0]);
+	uint16_t dataLength = ((uint16_t)shtpHeader[1] << 8 | shtpHeader[0]);
 	dataLength &= ~(1 << 15); //Clear the MSbit. This bit indicates if this package is a continuation of the last.
 	//Ignore it for now. TODO catch this as an error and exit
 
+	if (dataLength < 4)
+		return 0; //Empty packet
 	dataLength -= 4; //Remove the header bytes from the data count
+	if (dataLength > MAX_PACKET_SIZE)
+		dataLength = MAX_PACKET_SIZE; //Anything past this was not stored by receivePacket
 
-	timeStamp = ((uint32_t)shtpData[4] << (8 * 3)) | ((uint32_t)shtpData[3] << (8 * 2)) | ((uint32_t)shtpData[2] << (8 * 1)) | ((uint32_t)shtpData[1] << (8 * 0));
+	beginStream(shtpHeader[2]);
+	for (uint16_t x = 0; x < dataLength; x++)
+		streamByte(shtpData[x]);
+	endStream();
 
-	// The gyro-integrated input reports are sent via the special gyro channel and do no include the usual ID, sequence, and status fields
-	if(shtpHeader[2] == CHANNEL_GYRO) {
-		rawQuatI = (uint16_t)shtpData[1] << 8 | shtpData[0];
-		rawQuatJ = (uint16_t)shtpData[3] << 8 | shtpData[2];
-		rawQuatK = (uint16_t)shtpData[5] << 8 | shtpData[4];
-		rawQuatReal = (uint16_t)shtpData[7] << 8 | shtpData[6];
-		rawFastGyroX = (uint16_t)shtpData[9] << 8 | shtpData[8];
-		rawFastGyroY = (uint16_t)shtpData[11] << 8 | shtpData[10];
-		rawFastGyroZ = (uint16_t)shtpData[13] << 8 | shtpData[12];
+	return _packetFirstReportID;
+}
 
-		return SENSOR_REPORTID_GYRO_INTEGRATED_ROTATION_VECTOR;
-	}
+//Get ready to parse the payload of a new packet on the given channel, one byte at a time
+//Only the sensor report channels are parsed. Bytes on other channels are ignored by streamByte().
+void BNO085::beginStream(uint8_t channelNumber)
+{
+	_streamChannel = channelNumber;
+	_streamActive = (channelNumber == CHANNEL_REPORTS || channelNumber == CHANNEL_WAKE_REPORTS || channelNumber == CHANNEL_GYRO);
+	_advState = (channelNumber == CHANNEL_COMMAND) ? SHTP_ADV_START : SHTP_ADV_OFF; //Could be the advertisement
+	_streamSkipping = false;
+	_streamIndex = 0;
+	_streamLength = 0;
+	_baseMicros = _packetMicros;
+
+	_packetFirstReportID = 0;
+	_packetReportCount = 0;
+}
 
-	uint8_t status = shtpData[5 + 2] & 0x03; //Get status bits
-	uint16_t data1 = (uint16_t)shtpData[5 + 5] << 8 | shtpData[5 + 4];
-	uint16_t data2 = (uint16_t)shtpData[5 + 7] << 8 | shtpData[5 + 6];
-	uint16_t data3 = (uint16_t)shtpData[5 + 9] << 8 | shtpData[5 + 8];
-	uint16_t data4 = 0;
-	uint16_t data5 = 0; //We would need to change this to uin32_t to capture time stamp value on Raw Accel/Gyro/Mag reports
+//Feed the next payload byte of the current packet to the parser
+//Each report is collected into a small buffer and parsed as soon as its last byte arrives,
+//so a packet of any length can be decoded without holding the whole thing in RAM
+void BNO085::streamByte(uint8_t incoming)
+{
+	if (_streamActive == false)
+		return;
 
-	if (dataLength - 5 > 9)
-	{
-		data4 = (uint16_t)shtpData[5 + 11] << 8 | shtpData[5 + 10];
-	}
-	if (dataLength - 5 > 11)
+	if (_streamSkipping == true)
 	{
-		data5 = (uint16_t)shtpData[5 + 13] << 8 | shtpData[5 + 12];
+		_bytesSkipped++;
+		return;
 	}
 
-	//Store these generic values to their proper global variable
-	if (shtpData[5] == SENSOR_REPORTID_ACCELEROMETER)
-	{
-		accelAccuracy = status;
-		rawAccelX = data1;
-		rawAccelY = data2;
-		rawAccelZ = data3;
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_LINEAR_ACCELERATION)
-	{
-		accelLinAccuracy = status;
-		rawLinAccelX = data1;
-		rawLinAccelY = data2;
-		rawLinAccelZ = data3;
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_GYROSCOPE)
+	if (_streamIndex == 0) //This is the first byte of a new report
 	{
-		gyroAccuracy = status;
-		rawGyroX = data1;
-		rawGyroY = data2;
-		rawGyroZ = data3;
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_MAGNETIC_FIELD)
-	{
-		magAccuracy = status;
-		rawMagX = data1;
-		rawMagY = data2;
-		rawMagZ = data3;
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_ROTATION_VECTOR ||
-		shtpData[5] == SENSOR_REPORTID_GAME_ROTATION_VECTOR ||
-		shtpData[5] == SENSOR_REPORTID_AR_VR_STABILIZED_ROTATION_VECTOR ||
-		shtpData[5] == SENSOR_REPORTID_AR_VR_STABILIZED_GAME_ROTATION_VECTOR)
-		{
-		quatAccuracy = status;
-		rawQuatI = data1;
-		rawQuatJ = data2;
-		rawQuatK = data3;
-		rawQuatReal = data4;
+		// The gyro-integrated input reports are sent via the special gyro channel and do no include the usual ID, sequence, and status fields
+		if (_streamChannel == CHANNEL_GYRO)
+			_streamLength = 14;
+		else
+			_streamLength = getReportLength(incoming);
 
-		//Only available on rotation vector and ar/vr stabilized rotation vector,
-		// not game rot vector and not ar/vr stabilized rotation vector
-		rawQuatRadianAccuracy = data5;
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_TAP_DETECTOR)
-	{
-		tapDetector = shtpData[5 + 4]; //Byte 4 only
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_STEP_COUNTER)
-	{
-		stepCount = data3; //Bytes 8/9
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_STABILITY_CLASSIFIER)
-	{
-		stabilityClassifier = shtpData[5 + 4]; //Byte 4 only
+		if (_streamLength == 0 || _streamLength > MAX_REPORT_SIZE)
+		{
+			//We don't know how long this report is so we can't find the start of the next one
+			if (_printDebug == true)
+			{
+				_debugPort->print(F("streamByte: Unknown report ID: 0x"));
+				_debugPort->println(incoming, HEX);
+			}
+			_streamSkipping = true;
+			_bytesSkipped++;
+			return;
+		}
 	}
-	else if (shtpData[5] == SENSOR_REPORTID_PERSONAL_ACTIVITY_CLASSIFIER)
-	{
-		activityClassifier = shtpData[5 + 5]; //Most likely state
 
-		//Load activity classification confidences into the array
-		for (uint8_t x = 0; x < 9; x++)					   //Hardcoded to max of 9. TODO - bring in array size
-			_activityConfidences[x] = shtpData[5 + 6 + x]; //5 bytes of timestamp, byte 6 is first confidence byte
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_RAW_ACCELEROMETER)
-	{
-		memsRawAccelX = data1;
-		memsRawAccelY = data2;
-		memsRawAccelZ = data3;
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_RAW_GYROSCOPE)
-	{
-		memsRawGyroX = data1;
-		memsRawGyroY = data2;
-		memsRawGyroZ = data3;
-	}
-	else if (shtpData[5] == SENSOR_REPORTID_RAW_MAGNETOMETER)
-	{
-		memsRawMagX = data1;
-		memsRawMagY = data2;
-		memsRawMagZ = data3;
-	}
-	else
+	_streamReport[_streamIndex++] = incoming;
+
+	if (_streamIndex == _streamLength)
 	{
-		//This sensor report ID is unhandled.
-		//See reference manual to add additional feature reports as needed
-		return 0;
+		uint8_t reportID;
+		if (_streamChannel == CHANNEL_GYRO)
+			reportID = parseGyroIntegratedReport(_streamReport);
+		else
+			reportID = parseReport(_streamReport, _streamLength);
+
+		if (reportID != 0)
+		{
+			if (reportID < 64)
+				_reportsUpdated |= (uint64_t)1 << reportID;
+			if (_packetFirstReportID == 0)
+				_packetFirstReportID = reportID;
+			_packetReportCount++;
+
+			deliverSample(reportID, _streamReport, _streamLength);
+			if (_reportModeCount > 0)
+				countReport(reportID);
+		}
+
+		_streamIndex = 0; //Ready for the next report
 	}
+}
 
-	//TODO additional feature reports may be strung together. Parse them all.
-	return shtpData[5];
+//The packet is over. Any partial report left in the buffer was truncated and is counted as skipped.
+void BNO085::endStream()
+{
+	if (_streamActive == true)
+		_bytesSkipped += _streamIndex;
+	_streamActive = false;
+	_streamIndex = 0;
+	_advState = SHTP_ADV_OFF;
 }
 
-// Quaternion to Euler conversion
-// https://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles
-// https://github.com/sparkfun/SparkFun_MPU-9250-DMP_Arduino_Library/issues/5#issuecomment-306509440
-// Return the roll (rotation around the x-axis) in Radians
-float BNO085::getRoll()
+//Work out whether a packet starts a new transfer or continues the one in progress
+//A cargo longer than the host reads in one go is sent as several packets. Every packet after the
+//first has the continuation bit (MSbit of the length) set and a length covering what is left.
+//The fragments are stored one after the other in shtpData and the report parser carries on
+//across them, so a report split between two packets is still decoded.
+//Returns the number of payload bytes to read from this packet
+uint16_t BNO085::beginFragment(uint8_t channelNumber, uint16_t packetLength)
 {
-	float dqw = getQuatReal();
-	float dqx = getQuatI();
-	float dqy = getQuatJ();
-	float dqz = getQuatK();
+	bool continuation = (packetLength & (1 << 15)) != 0;
+	uint16_t cargoLength = (packetLength & ~(1 << 15)) - 4; //Remove the header bytes from the data count
 
-	float norm = sqrt(dqw*dqw + dqx*dqx + dqy*dqy + dqz*dqz);
-	dqw = dqw/norm;
-	dqx = dqx/norm;
-	dqy = dqy/norm;
-	dqz = dqz/norm;
+	if (_rxTransferRemaining > 0) //We are in the middle of a transfer
+	{
+		if (continuation == true && channelNumber == _rxTransferChannel && cargoLength == _rxTransferRemaining)
+		{
+			//This is the next piece. Carry on from where the last one left off.
+			_rxTransferContinued = true;
+			_rxFragmentLength = cargoLength;
+			return (fragmentReadLength(cargoLength));
+		}
 
-	float ysqr = dqy * dqy;
+		//The rest of the last transfer never came
+		abortTransfer();
+	}
+
+	//Start a new transfer
+	//Every report in it is timed from when its first packet was sent
+	_packetMicros = extendMicros(_rxFragmentMicros);
+	beginStream(channelNumber);
+	_rxTransferChannel = channelNumber;
+	_rxTransferOffset = 0;
+	_rxTransferContinued = false;
+	_rxTransferDiscard = false;
+	_rxFragmentLength = cargoLength;
+
+	bool tooLong = (cargoLength > _maxTransferLength);
+	if (_advertisement.maxCargoRead > 4 && cargoLength > _advertisement.maxCargoRead - 4)
+		tooLong = true; //More than the hub said it ever sends, so the header is garbage
+	if (continuation == true || tooLong == true)
+		discardTransfer(); //We missed the start of this transfer, or it is too big to reassemble
+
+	return (fragmentReadLength(cargoLength));
+}
+
+//Read the rest of the transfer in progress and throw it away
+void BNO085::discardTransfer()
+{
+	_transfersAbandoned++;
+	_rxTransferDiscard = true;
+	endStream(); //Any partial report is counted as skipped
+}
+
+//How much of a fragment with this much cargo to read now. The rest comes as a continuation.
+uint16_t BNO085::fragmentReadLength(uint16_t cargoLength)
+{
+	if (_maxReadLength > 0 && cargoLength > _maxReadLength)
+		cargoLength = _maxReadLength;
+	return (readLimit(cargoLength));
+}
+
+//Cargo bytes one read can take. The hub pads a read longer than the max transfer it advertised.
+//Until the advertisement has been read, reads are kept short enough for any hub.
+uint16_t BNO085::readLimit(uint16_t length)
+{
+	uint16_t maxTransferRead = (_advertised == true) ? _advertisement.maxTransferRead : SHTP_FIRST_TRANSFER_READ;
+	if (maxTransferRead > 4 && length > maxTransferRead - 4)
+		return (maxTransferRead - 4);
+	return (length);
+}
+
+//We have read bytesRead payload bytes of the current fragment
+//If that is the end of the transfer, finish parsing it. Otherwise wait for the continuation.
+void BNO085::endFragment(uint16_t bytesRead)
+{
+	_rxTransferOffset += bytesRead;
+	_rxTransferRemaining = _rxFragmentLength - bytesRead;
+	if (_rxTransferRemaining > 0)
+		return; //More to come. Leave the parser where it is.
+
+	endStream();
+	if (_rxTransferContinued == true && _rxTransferDiscard == false)
+	{
+		_transfersReassembled++;
+
+		//Make the header describe the whole transfer so shtpData can be parsed again
+		uint16_t transferLength = _rxTransferOffset + 4;
+		shtpHeader[0] = transferLength & 0xFF;
+		shtpHeader[1] = transferLength >> 8;
+	}
+}
+
+//Give up on the transfer in progress
+void BNO085::abortTransfer()
+{
+	if (_rxTransferRemaining > 0 && _rxTransferDiscard == false)
+		_transfersAbandoned++;
+	endStream(); //Any partial report is counted as skipped
+	captureFinish();
+	_rxTransferRemaining = 0;
+}
+
+//Read at most this many payload bytes per packet. Longer packets are read as continuations
+//and reassembled. Smaller reads keep each bus transaction short. 0 reads whole packets (the default).
+void BNO085::setMaxReadLength(uint16_t maxReadLength)
+{
+	_maxReadLength = maxReadLength;
+}
+
+//Transfers with more cargo than this are read and thrown away rather than reassembled
+void BNO085::setMaxTransferLength(uint16_t maxTransferLength)
+{
+	_maxTransferLength = maxTransferLength;
+}
+
+//Returns the number of transfers that arrived in more than one packet and were put back together
+uint32_t BNO085::getTransfersReassembled()
+{
+	return (_transfersReassembled);
+}
+
+//Returns the number of transfers that were thrown away: cut short, missing their start, or too long
+uint32_t BNO085::getTransfersAbandoned()
+{
+	return (_transfersAbandoned);
+}
+
+//The limits the hub advertised after its last reset
+bool BNO085::getAdvertisement(BNO085Advertisement &advertisement)
+{
+	advertisement = _advertisement;
+	return (_advertised);
+}
+
+bool BNO085::getChannel(uint8_t index, BNO085Channel &channel)
+{
+	if (index >= _advertisement.channelCount)
+		return (false);
+	channel = _channels[index];
+	return (true);
+}
+
+//The number the hub uses on the bus for CHANNEL_x. The defaults until an advertisement says otherwise.
+uint8_t BNO085::getChannelNumber(uint8_t channel)
+{
+	if (channel >= BNO085_CHANNEL_COUNT)
+		return (BNO085_NO_CHANNEL);
+	return (_channelNumbers[channel]);
+}
+
+//Which CHANNEL_x a channel number from the bus is
+uint8_t BNO085::localChannel(uint8_t number)
+{
+	if (number < BNO085_CHANNEL_COUNT && _channelNumbers[number] == number)
+		return (number); //Where SHTP normally puts it
+	for (uint8_t x = 0; x < BNO085_CHANNEL_COUNT; x++)
+		if (_channelNumbers[x] == number)
+			return (x);
+	return (BNO085_NO_CHANNEL);
+}
+
+//Parse the next byte of a packet on channel 0. If it is the advertisement, it lists each application
+//on the hub with its channels and limits, as tag, length, value records.
+void BNO085::advertisementByte(uint8_t incoming)
+{
+	switch (_advState)
+	{
+	case SHTP_ADV_START:
+		endRestart(incoming == SHTP_ADVERTISEMENT);
+		if (incoming != SHTP_ADVERTISEMENT)
+		{
+			_advState = SHTP_ADV_OFF; //Some other SHTP command response
+			return;
+		}
+		//The hub has reset. Start again from the defaults.
+		_advertised = true;
+		memset(&_advertisement, 0, sizeof(_advertisement));
+		for (uint8_t x = 0; x < BNO085_CHANNEL_COUNT; x++)
+			_channelNumbers[x] = x;
+		_advApplication = 255;
+		_advGuid = 0;
+		_advChannelNamed = true;
+		_advState = SHTP_ADV_TAG;
+		break;
+
+	case SHTP_ADV_TAG:
+		_advTag = incoming;
+		_advState = SHTP_ADV_LENGTH;
+		break;
+
+	case SHTP_ADV_LENGTH:
+		_advLength = incoming;
+		_advIndex = 0;
+		memset(_advValue, 0, sizeof(_advValue));
+		_advState = SHTP_ADV_VALUE;
+		if (_advLength == 0)
+		{
+			advertisementRecord();
+			_advState = SHTP_ADV_TAG;
+		}
+		break;
+
+	case SHTP_ADV_VALUE:
+		if (_advIndex < sizeof(_advValue))
+			_advValue[_advIndex] = incoming; //Longer values are only names we have no use for
+		if (++_advIndex == _advLength)
+		{
+			advertisementRecord();
+			_advState = SHTP_ADV_TAG;
+		}
+		break;
+	}
+}
+
+//Act on a whole advertisement record in _advTag and _advValue
+void BNO085::advertisementRecord()
+{
+	uint16_t value16 = (uint16_t)_advValue[1] << 8 | _advValue[0];
+	bool nameFits = (_advLength > 0 && _advLength <= sizeof(_advValue) && _advValue[_advLength - 1] == 0);
+
+	switch (_advTag)
+	{
+	case SHTP_TAG_GUID:
+		_advGuid = (uint32_t)_advValue[3] << 24 | (uint32_t)_advValue[2] << 16 | (uint32_t)_advValue[1] << 8 | _advValue[0];
+		_advApplication = 255; //Until its name comes
+		_advChannelNamed = true;
+		break;
+	case SHTP_TAG_MAX_CARGO_WRITE:
+		_advertisement.maxCargoWrite = value16;
+		break;
+	case SHTP_TAG_MAX_CARGO_READ:
+		_advertisement.maxCargoRead = value16;
+		break;
+	case SHTP_TAG_MAX_TRANSFER_WRITE:
+		_advertisement.maxTransferWrite = value16;
+		break;
+	case SHTP_TAG_MAX_TRANSFER_READ:
+		_advertisement.maxTransferRead = value16;
+		break;
+
+	case SHTP_TAG_NORMAL_CHANNEL:
+	case SHTP_TAG_WAKE_CHANNEL:
+		_advChannelNamed = true; //A name that follows is for a channel we could not keep
+		if (_advertisement.channelCount < BNO085_MAX_CHANNELS)
+		{
+			BNO085Channel &channel = _channels[_advertisement.channelCount++];
+			channel.guid = _advGuid;
+			channel.number = _advValue[0];
+			channel.role = BNO085_NO_CHANNEL;
+			channel.wake = (_advTag == SHTP_TAG_WAKE_CHANNEL);
+			_advChannelNamed = false;
+		}
+		break;
+
+	case SHTP_TAG_APP_NAME:
+		_advApplication = 255;
+		for (uint8_t x = 0; x < 3 && nameFits; x++)
+			if (nameMatches(_advValue, applicationNames[x]))
+				_advApplication = x;
+		break;
+
+	case SHTP_TAG_CHANNEL_NAME:
+		if (_advChannelNamed == true)
+			break;
+		_advChannelNamed = true;
+		for (uint8_t x = 0; x < BNO085_CHANNEL_COUNT && nameFits; x++)
+		{
+			if (pgm_read_byte(&channelNames[x].application) == _advApplication && nameMatches(_advValue, channelNames[x].name))
+			{
+				BNO085Channel &channel = _channels[_advertisement.channelCount - 1];
+				channel.role = pgm_read_byte(&channelNames[x].role);
+				_channelNumbers[channel.role] = channel.number;
+				break;
+			}
+		}
+		break;
+	}
+}
+
+//Each channel has its own sequence number that goes up by one with every packet the hub sends
+//Compare it to what we expect to find out if packets were lost or repeated
+void BNO085::checkSequence(uint8_t channelNumber, uint8_t sequenceNumber)
+{
+	if (channelNumber >= 6)
+		return; //Not a channel we know about
+
+	BNO085ReceiveStats &stats = _rxStats[channelNumber];
+	stats.packets++;
+	if (channelNumber == CHANNEL_COMMAND)
+		endRestart(false); //The last packet on channel 0 was not the advertisement
+
+	if (_rxSequenceValid & (1 << channelNumber))
+	{
+		uint8_t gap = sequenceNumber - _rxSequence[channelNumber]; //Wraps at 256
+		if (gap == 0)
+		{
+			//All good
+		}
+		else if (gap == 0xFF)
+			stats.duplicates++; //Same number as the last packet
+		else if (sequenceNumber == 0 && (_rxResetSeen & (1 << channelNumber)))
+			stats.resets++; //The hub reset and started counting again
+		else if (sequenceNumber == 0 && channelNumber == CHANNEL_COMMAND)
+			_rxRestartGap = gap; //A reset if this packet is the advertisement, see endRestart()
+		else
+			countGap(channelNumber, gap); //Numbers only start again at 0 after a reset, so this is a gap too
+	}
+
+	_rxSequence[channelNumber] = sequenceNumber + 1;
+	_rxSequenceValid |= (1 << channelNumber);
+	_rxResetSeen &= ~(1 << channelNumber);
+}
+
+void BNO085::countGap(uint8_t channelNumber, uint8_t gap)
+{
+	_rxStats[channelNumber].gaps++;
+	_rxStats[channelNumber].lost += gap;
+	if (_printDebug == true)
+	{
+		_debugPort->print(F("Lost "));
+		_debugPort->print(gap);
+		_debugPort->print(F(" packets on channel "));
+		_debugPort->println(channelNumber);
+	}
+}
+
+//Settle a packet on channel 0 that started the numbering again. If it is the advertisement the hub
+//has reset, and the next packet on every other channel may start from 0 as well.
+void BNO085::endRestart(bool advertisement)
+{
+	if (_rxRestartGap == 0)
+		return;
+	if (advertisement == true)
+	{
+		_rxStats[CHANNEL_COMMAND].resets++;
+		_rxResetSeen = 0x3F & ~(1 << CHANNEL_COMMAND);
+	}
+	else
+		countGap(CHANNEL_COMMAND, _rxRestartGap);
+	_rxRestartGap = 0;
+}
+
+//Returns the receive statistics for one channel
+BNO085ReceiveStats BNO085::getReceiveStats(uint8_t channelNumber)
+{
+	if (channelNumber >= 6)
+	{
+		BNO085ReceiveStats empty = {0, 0, 0, 0, 0};
+		return (empty);
+	}
+	return (_rxStats[channelNumber]);
+}
+
+//Returns the receive statistics added up over all channels
+BNO085ReceiveStats BNO085::getReceiveStats()
+{
+	BNO085ReceiveStats total = {0, 0, 0, 0, 0};
+	for (uint8_t x = 0; x < 6; x++)
+	{
+		total.packets += _rxStats[x].packets;
+		total.gaps += _rxStats[x].gaps;
+		total.lost += _rxStats[x].lost;
+		total.duplicates += _rxStats[x].duplicates;
+		total.resets += _rxStats[x].resets;
+	}
+	return (total);
+}
+
+//Zero the receive statistics. The expected sequence numbers are kept.
+void BNO085::clearReceiveStats()
+{
+	memset(_rxStats, 0, sizeof(_rxStats));
+}
+
+//Returns the number of received bytes that could not be stored or parsed
+//This includes bytes past MAX_PACKET_SIZE on non-sensor channels, unknown reports and truncated reports
+uint32_t BNO085::getBytesSkipped()
+{
+	return (_bytesSkipped);
+}
+
+//Store a payload byte of the packet being received
+//The first MAX_PACKET_SIZE bytes are kept in shtpData. Sensor reports are parsed as they arrive.
+void BNO085::receiveByte(uint16_t dataSpot, uint8_t incoming)
+{
+	if (_captureRemaining > 0)
+		captureBytes(&incoming, 1);
+
+	if (_rxTransferDiscard == true)
+	{
+		_bytesSkipped++; //This transfer is being thrown away
+		return;
+	}
+
+	dataSpot += _rxTransferOffset; //Fragments of a transfer are stored one after the other
+	if (dataSpot < MAX_PACKET_SIZE)
+		shtpData[dataSpot] = incoming; //Store data into the shtpData array
+	else if (_streamActive == false && _advState == SHTP_ADV_OFF)
+		_bytesSkipped++; //Nowhere to put it
+
+	parseByte(incoming);
+}
+
+//Hand a stored payload byte to the advertisement and sensor report parsers
+void BNO085::parseByte(uint8_t incoming)
+{
+	if (_advState != SHTP_ADV_OFF)
+		advertisementByte(incoming);
+	streamByte(incoming);
+}
+
+//Parse the gyro-integrated rotation vector report from the special gyro channel
+//These do not include the usual ID, sequence, and status fields
+uint8_t BNO085::parseGyroIntegratedReport(uint8_t *report)
+{
+	rawQuatI = (uint16_t)report[1] << 8 | report[0];
+	rawQuatJ = (uint16_t)report[3] << 8 | report[2];
+	rawQuatK = (uint16_t)report[5] << 8 | report[4];
+	rawQuatReal = (uint16_t)report[7] << 8 | report[6];
+	rawFastGyroX = (uint16_t)report[9] << 8 | report[8];
+	rawFastGyroY = (uint16_t)report[11] << 8 | report[10];
+	rawFastGyroZ = (uint16_t)report[13] << 8 | report[12];
+	_reportMicros = _packetMicros; //No timestamp or delay. These are sent as soon as they are made.
+
+	return SENSOR_REPORTID_GYRO_INTEGRATED_ROTATION_VECTOR;
+}
+
+//Given a pointer to a single report within a packet, update the globals for that report
+//Returns the report ID if this is a sensor report, 0 if it is a timestamp or unknown report
+uint8_t BNO085::parseReport(uint8_t *report, uint8_t reportLength)
+{
+	//Timestamps are in 100us ticks. The base says how long before the packet was sent the reports
+	//start. A rebase moves it on for the reports after it, when their delays would not fit in 14 bits.
+	if (report[0] == SHTP_REPORT_BASE_TIMESTAMP)
+	{
+		timeStamp = ((uint32_t)report[4] << (8 * 3)) | ((uint32_t)report[3] << (8 * 2)) | ((uint32_t)report[2] << (8 * 1)) | ((uint32_t)report[1] << (8 * 0));
+		_baseMicros = _packetMicros - (int64_t)(int32_t)timeStamp * 100;
+		return 0;
+	}
+	if (report[0] == SHTP_REPORT_TIMESTAMP_REBASE)
+	{
+		uint32_t rebase = ((uint32_t)report[4] << (8 * 3)) | ((uint32_t)report[3] << (8 * 2)) | ((uint32_t)report[2] << (8 * 1)) | ((uint32_t)report[1] << (8 * 0));
+		_baseMicros += (int64_t)(int32_t)rebase * 100;
+		return 0;
+	}
+
+	uint8_t reportID = report[0];
+	if (reportID >= BNO085_REPORT_ID_COUNT)
+		return 0; //Not a sensor report
+
+	uint8_t status = report[2] & 0x03; //Get status bits
+	uint16_t delay = (uint16_t)(report[2] & 0xFC) << 6 | report[3]; //The top 6 bits of the delay are in the status byte
+	_reportMicros = _baseMicros + (uint32_t)delay * 100;
+
+	uint16_t data1 = (uint16_t)report[5] << 8 | report[4];
+	uint16_t data2 = (uint16_t)report[7] << 8 | report[6];
+	uint16_t data3 = (uint16_t)report[9] << 8 | report[8];
+	uint16_t data4 = 0;
+	uint16_t data5 = 0; //We would need to change this to uin32_t to capture time stamp value on Raw Accel/Gyro/Mag reports
+	uint16_t data6 = 0;
+
+	if (reportLength > 11)
+	{
+		data4 = (uint16_t)report[11] << 8 | report[10];
+	}
+	if (reportLength > 13)
+	{
+		data5 = (uint16_t)report[13] << 8 | report[12];
+	}
+	if (reportLength > 15)
+	{
+		data6 = (uint16_t)report[15] << 8 | report[14];
+	}
+
+	//Store these generic values to their proper global variable
+	//The descriptor table says where each report goes, so this is one jump whatever the report
+	uint8_t store = pgm_read_byte(&reportDescriptors[reportID].store);
+	switch (store)
+	{
+	case BNO085_STORE_ACCEL:
+		accelAccuracy = status;
+		rawAccelX = data1;
+		rawAccelY = data2;
+		rawAccelZ = data3;
+		break;
+	case BNO085_STORE_LINEAR_ACCEL:
+		accelLinAccuracy = status;
+		rawLinAccelX = data1;
+		rawLinAccelY = data2;
+		rawLinAccelZ = data3;
+		break;
+	case BNO085_STORE_GYRO:
+		gyroAccuracy = status;
+		rawGyroX = data1;
+		rawGyroY = data2;
+		rawGyroZ = data3;
+		break;
+	case BNO085_STORE_MAG:
+		magAccuracy = status;
+		rawMagX = data1;
+		rawMagY = data2;
+		rawMagZ = data3;
+		break;
+	case BNO085_STORE_QUAT:
+		quatAccuracy = status;
+		rawQuatI = data1;
+		rawQuatJ = data2;
+		rawQuatK = data3;
+		rawQuatReal = data4;
+
+		//Only available on rotation vector and ar/vr stabilized rotation vector,
+		// not game rot vector and not ar/vr stabilized rotation vector
+		rawQuatRadianAccuracy = data5;
+		break;
+	case BNO085_STORE_TAP:
+		tapDetector = report[4]; //Byte 4 only
+		break;
+	case BNO085_STORE_STEP:
+		stepCount = data3; //Bytes 8/9
+		break;
+	case BNO085_STORE_STABILITY:
+		stabilityClassifier = report[4]; //Byte 4 only
+		break;
+	case BNO085_STORE_ACTIVITY:
+		activityClassifier = report[5]; //Most likely state
+
+		//Load activity classification confidences into the array, if enableActivityClassifier() gave us one
+		for (uint8_t x = 0; x < 9 && _activityConfidences != NULL; x++) //Hardcoded to max of 9. TODO - bring in array size
+			_activityConfidences[x] = report[6 + x];					   //Byte 6 is first confidence byte
+		break;
+	case BNO085_STORE_RAW_ACCEL:
+		memsRawAccelX = data1;
+		memsRawAccelY = data2;
+		memsRawAccelZ = data3;
+		break;
+	case BNO085_STORE_RAW_GYRO:
+		memsRawGyroX = data1;
+		memsRawGyroY = data2;
+		memsRawGyroZ = data3;
+		break;
+	case BNO085_STORE_RAW_MAG:
+		memsRawMagX = data1;
+		memsRawMagY = data2;
+		memsRawMagZ = data3;
+		break;
+	case BNO085_STORE_GRAVITY:
+		gravityAccuracy = status;
+		rawGravityX = data1;
+		rawGravityY = data2;
+		rawGravityZ = data3;
+		break;
+	case BNO085_STORE_UNCALIBRATED_GYRO:
+		uncalibGyroAccuracy = status;
+		rawUncalibGyroX = data1;
+		rawUncalibGyroY = data2;
+		rawUncalibGyroZ = data3;
+		rawBiasGyroX = data4;
+		rawBiasGyroY = data5;
+		rawBiasGyroZ = data6;
+		break;
+	case BNO085_STORE_UNCALIBRATED_MAG:
+		uncalibMagAccuracy = status;
+		rawUncalibMagX = data1;
+		rawUncalibMagY = data2;
+		rawUncalibMagZ = data3;
+		rawBiasMagX = data4; //Hard iron offset
+		rawBiasMagY = data5;
+		rawBiasMagZ = data6;
+		break;
+	case BNO085_STORE_SIGNIFICANT_MOTION:
+		significantMotion = (data1 & 0x01) != 0; //Bytes 4/5, 1 = motion detected
+		break;
+	case BNO085_STORE_SHAKE:
+		shakeDetector = data1 & 0x07; //Bytes 4/5, one bit per axis
+		break;
+	case BNO085_STORE_STABILITY_DETECTOR:
+		stabilityDetector = data1 & 0x03; //Bytes 4/5, entered or exited the stable state
+		break;
+	default:
+		//No getters for this report. It is still queued and passed to its callback.
+		//See reference manual to add additional feature reports as needed
+		break;
+	}
+
+	//The raw reports also carry the hub's own microsecond clock, which lets us track it against ours
+	if (store == BNO085_STORE_RAW_ACCEL || store == BNO085_STORE_RAW_GYRO || store == BNO085_STORE_RAW_MAG)
+	{
+		uint32_t hubTime = ((uint32_t)report[15] << (8 * 3)) | ((uint32_t)report[14] << (8 * 2)) | ((uint32_t)report[13] << (8 * 1)) | ((uint32_t)report[12] << (8 * 0));
+		if (_hubMicrosValid == false)
+			_hubMicros = hubTime;
+		else
+			_hubMicros += (int32_t)(hubTime - (uint32_t)_hubMicros); //Rolls over every 71 minutes
+		_hubMicrosValid = true;
+		_clock.update(_hubMicros, _reportMicros);
+	}
+
+	//Reports sent every interval also time the hub clock, by how many of them it has sent
+	bool steady = (store >= BNO085_STORE_ACCEL && store <= BNO085_STORE_QUAT) || (store >= BNO085_STORE_RAW_ACCEL && store <= BNO085_STORE_UNCALIBRATED_MAG);
+	if (steady == true)
+		updateReportClock(reportID, report[1]);
+
+	return reportID;
+}
+
+//Given a report ID, return the total length of that report in bytes (including the ID)
+//These come from the report descriptions in the SH-2 reference manual
+//Returns 0 if the report ID is unknown
+uint8_t BNO085::getReportLength(uint8_t reportID)
+{
+	if (reportID < BNO085_REPORT_ID_COUNT)
+		return pgm_read_byte(&reportDescriptors[reportID].length);
+	if (reportID == SHTP_REPORT_TIMESTAMP_REBASE || reportID == SHTP_REPORT_BASE_TIMESTAMP)
+		return 5;
+	return 0;
+}
+
+//Copy what the library knows about a sensor report into descriptor
+//Returns false if the report ID is unknown
+bool BNO085::getReportDescriptor(uint8_t reportID, BNO085ReportDescriptor &descriptor)
+{
+	if (reportID >= BNO085_REPORT_ID_COUNT)
+		return (false);
+	const BNO085ReportDescriptor *entry = &reportDescriptors[reportID];
+	descriptor.length = pgm_read_byte(&entry->length);
+	descriptor.qPoint = pgm_read_byte(&entry->qPoint);
+	descriptor.qFields = pgm_read_byte(&entry->qFields);
+	descriptor.qPoint2 = pgm_read_byte(&entry->qPoint2);
+	descriptor.store = pgm_read_byte(&entry->store);
+	return (descriptor.length != 0);
+}
+
+//Returns data field number field of a sample as a float, using the Q point of its report
+//Fields that are not fixed point are returned as they are
+float BNO085::getSampleValue(const BNO085Sample &sample, uint8_t field)
+{
+	if (field >= BNO085_SAMPLE_WORDS || sample.reportID >= BNO085_REPORT_ID_COUNT)
+		return (0);
+	const BNO085ReportDescriptor *entry = &reportDescriptors[sample.reportID];
+	uint8_t qPoint = pgm_read_byte(&entry->qPoint2);
+	if (field < pgm_read_byte(&entry->qFields))
+		qPoint = pgm_read_byte(&entry->qPoint);
+	return (qToFloat(sample.data[field], qPoint));
+}
+
+//Convert every data field of a sample, using the Q points of its report
+//Returns the number of fields the report has. The rest of values are 0.
+uint8_t BNO085::getSampleValues(const BNO085Sample &sample, float (&values)[BNO085_SAMPLE_WORDS])
+{
+	uint8_t fields = 0;
+	uint8_t qFields = 0;
+	uint8_t qPoint = 0;
+	uint8_t qPoint2 = 0;
+	if (sample.reportID < BNO085_REPORT_ID_COUNT)
+	{
+		const BNO085ReportDescriptor *entry = &reportDescriptors[sample.reportID];
+		uint8_t length = pgm_read_byte(&entry->length);
+		fields = (length > 4) ? (length - 4) / 2 : 0;
+		if (sample.reportID == SENSOR_REPORTID_GYRO_INTEGRATED_ROTATION_VECTOR)
+			fields = 7; //No header bytes when it comes on the gyro channel, and the rest is 7 fields either way
+		if (fields > BNO085_SAMPLE_WORDS)
+			fields = BNO085_SAMPLE_WORDS;
+		qPoint = pgm_read_byte(&entry->qPoint);
+		qFields = pgm_read_byte(&entry->qFields);
+		qPoint2 = pgm_read_byte(&entry->qPoint2);
+	}
+	if (qFields > fields)
+		qFields = fields;
+
+	qToFloat(sample.data, values, qFields, qPoint);
+	qToFloat(sample.data + qFields, values + qFields, fields - qFields, qPoint2);
+	for (uint8_t x = fields; x < BNO085_SAMPLE_WORDS; x++)
+		values[x] = 0;
+	return (fields);
+}
+
+//Call callback with every sample of reportID as it is parsed, before it is queued
+//It is called from wherever the BNO085 is read, so keep it short if that is an interrupt
+//Pass NULL to stop
+void BNO085::setReportCallback(uint8_t reportID, BNO085SampleCallback callback)
+{
+	if (reportID < BNO085_REPORT_ID_COUNT)
+		_reportCallbacks[reportID] = callback;
+}
+
+//Returns a bitmask of the report IDs updated by the last call to getReadings()
+//Bit n is set if report ID n was found. A single packet may contain many reports.
+uint64_t BNO085::getUpdatedReports()
+{
+	return (_reportsUpdated);
+}
+
+//Returns true if the given report ID was updated by the last call to getReadings()
+bool BNO085::reportUpdated(uint8_t reportID)
+{
+	if (reportID >= 64)
+		return (false);
+	return ((_reportsUpdated & ((uint64_t)1 << reportID)) != 0);
+}
+
+//Ask the BNO085 to send everything it has batched for a given sensor, then read and parse
+//every packet until the hub reports the flush is complete
+//See 6.5.6 Force Sensor Flush and 6.5.7 Flush Completed
+//Returns the number of sensor reports parsed. getUpdatedReports() covers all of them.
+uint16_t BNO085::drainBatch(uint8_t reportID)
+{
+	shtpData[0] = SHTP_REPORT_FORCE_SENSOR_FLUSH; //Force sensor flush
+	shtpData[1] = reportID;						  //Sensor to flush
+
+	//Transmit packet on channel 2, 2 bytes
+	if (sendPacket(CHANNEL_CONTROL, 2) == false)
+		return (0);
+
+	_reportsUpdated = 0;
+	uint16_t reportsParsed = 0;
+	uint8_t counter = 0;
+	while (1)
+	{
+		if (receivePacket() == false)
+		{
+			if (counter++ > 100)
+				break; //Give up
+			delay(1);
+			continue;
+		}
+		counter = 0;
+
+		if (shtpHeader[2] == CHANNEL_REPORTS || shtpHeader[2] == CHANNEL_WAKE_REPORTS || shtpHeader[2] == CHANNEL_GYRO)
+		{
+			if (_rxTransferRemaining == 0)
+				reportsParsed += _packetReportCount; //Already parsed as the packet was received. Counted once its last piece is in.
+		}
+		else if (shtpHeader[2] == CHANNEL_CONTROL)
+		{
+			if (shtpData[0] == SHTP_REPORT_FLUSH_COMPLETED && shtpData[1] == reportID)
+				break; //All batched reports for this sensor have been sent
+			parseCommandReport();
+		}
+	}
+
+	return (reportsParsed);
+}
+
+//atan2() from the Abramowitz and Stegun 4.4.49 polynomial for atan on [0, 1]
+//The polynomial is within 1e-5 radians of atan()
+static float fastAtan2(float y, float x)
+{
+	float absX = fabsf(x);
+	float absY = fabsf(y);
+	float big = (absX > absY) ? absX : absY;
+	float small = (absX > absY) ? absY : absX;
+	if (big == 0)
+		return (0);
+
+	float t = small / big;
+	float t2 = t * t;
+	float angle = t * (0.9998660f + t2 * (-0.3302995f + t2 * (0.1801410f + t2 * (-0.0851330f + t2 * 0.0208351f))));
+	if (absY > absX)
+		angle = 1.57079633f - angle;
+	if (x < 0)
+		angle = 3.14159265f - angle;
+	if (y < 0)
+		angle = -angle;
+	return (angle);
+}
+
+// Quaternion to Euler conversion
+// https://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles
+// https://github.com/sparkfun/SparkFun_MPU-9250-DMP_Arduino_Library/issues/5#issuecomment-306509440
+//The Euler angles below work on the raw quaternion. The atan2() terms are all in the same units
+//and pitch is divided by the squared norm, so it needs no Q point and no sqrt() to normalize it.
+
+//Gets roll, pitch and yaw in radians from one read of the rotation vector
+//fast uses a polynomial atan2() and no asin(), which is much quicker on parts without an FPU.
+//Over 2 million random orientations it stayed within 3e-5 radians of the exact roll and yaw and
+//6e-5 radians of the exact pitch (0.0035 degrees). The float library functions are within 5e-5.
+void BNO085::getEuler(float &roll, float &pitch, float &yaw, bool fast)
+{
+	float w = (int16_t)rawQuatReal;
+	float x = (int16_t)rawQuatI;
+	float y = (int16_t)rawQuatJ;
+	float z = (int16_t)rawQuatK;
+
+	float ww = w * w;
+	float xx = x * x;
+	float yy = y * y;
+	float zz = z * z;
+	float norm = ww + xx + yy + zz; //Squared
+	if (norm == 0)
+	{
+		roll = pitch = yaw = 0; //No rotation vector yet
+		return;
+	}
+
+	float sinPitch = 2.0f * (w * y - z * x) / norm;
+	sinPitch = sinPitch > 1.0f ? 1.0f : sinPitch;
+	sinPitch = sinPitch < -1.0f ? -1.0f : sinPitch;
+
+	if (fast)
+	{
+		roll = fastAtan2(2.0f * (w * x + y * z), ww - xx - yy + zz);
+		pitch = fastAtan2(sinPitch, sqrtf(1.0f - sinPitch * sinPitch));
+		yaw = fastAtan2(2.0f * (w * z + x * y), ww + xx - yy - zz);
+	}
+	else
+	{
+		roll = atan2f(2.0f * (w * x + y * z), ww - xx - yy + zz);
+		pitch = asinf(sinPitch);
+		yaw = atan2f(2.0f * (w * z + x * y), ww + xx - yy - zz);
+	}
+}
+
+// Return the roll (rotation around the x-axis) in Radians
+float BNO085::getRoll()
+{
+	float w = (int16_t)rawQuatReal;
+	float x = (int16_t)rawQuatI;
+	float y = (int16_t)rawQuatJ;
+	float z = (int16_t)rawQuatK;
 
 	// roll (x-axis rotation)
-	float t0 = +2.0 * (dqw * dqx + dqy * dqz);
-	float t1 = +1.0 - 2.0 * (dqx * dqx + ysqr);
-	float roll = atan2(t0, t1);
+	float roll = atan2f(2.0f * (w * x + y * z), w * w - x * x - y * y + z * z);
 
 	return (roll);
 }
@@ -424,24 +1734,20 @@ float BNO085::getRoll()
 // Return the pitch (rotation around the y-axis) in Radians
 float BNO085::getPitch()
 {
-	float dqw = getQuatReal();
-	float dqx = getQuatI();
-	float dqy = getQuatJ();
-	float dqz = getQuatK();
-
-	float norm = sqrt(dqw*dqw + dqx*dqx + dqy*dqy + dqz*dqz);
-	dqw = dqw/norm;
-	dqx = dqx/norm;
-	dqy = dqy/norm;
-	dqz = dqz/norm;
+	float w = (int16_t)rawQuatReal;
+	float x = (int16_t)rawQuatI;
+	float y = (int16_t)rawQuatJ;
+	float z = (int16_t)rawQuatK;
 
-	float ysqr = dqy * dqy;
+	float norm = w * w + x * x + y * y + z * z; //Squared
+	if (norm == 0)
+		return (0);
 
 	// pitch (y-axis rotation)
-	float t2 = +2.0 * (dqw * dqy - dqz * dqx);
-	t2 = t2 > 1.0 ? 1.0 : t2;
-	t2 = t2 < -1.0 ? -1.0 : t2;
-	float pitch = asin(t2);
+	float t2 = 2.0f * (w * y - z * x) / norm;
+	t2 = t2 > 1.0f ? 1.0f : t2;
+	t2 = t2 < -1.0f ? -1.0f : t2;
+	float pitch = asinf(t2);
 
 	return (pitch);
 }
@@ -449,27 +1755,66 @@ float BNO085::getPitch()
 // Return the yaw / heading (rotation around the z-axis) in Radians
 float BNO085::getYaw()
 {
-	float dqw = getQuatReal();
-	float dqx = getQuatI();
-	float dqy = getQuatJ();
-	float dqz = getQuatK();
-
-	float norm = sqrt(dqw*dqw + dqx*dqx + dqy*dqy + dqz*dqz);
-	dqw = dqw/norm;
-	dqx = dqx/norm;
-	dqy = dqy/norm;
-	dqz = dqz/norm;
-
-	float ysqr = dqy * dqy;
+	float w = (int16_t)rawQuatReal;
+	float x = (int16_t)rawQuatI;
+	float y = (int16_t)rawQuatJ;
+	float z = (int16_t)rawQuatK;
 
 	// yaw (z-axis rotation)
-	float t3 = +2.0 * (dqw * dqz + dqx * dqy);
-	float t4 = +1.0 - 2.0 * (ysqr + dqz * dqz);
-	float yaw = atan2(t3, t4);
+	float yaw = atan2f(2.0f * (w * z + x * y), w * w + x * x - y * y - z * z);
 
 	return (yaw);
 }
 
+//Gets the rotation vector without converting it, Q14
+void BNO085::getQuatFixed(BNO085Quat &quat)
+{
+	quat.i = rawQuatI;
+	quat.j = rawQuatJ;
+	quat.k = rawQuatK;
+	quat.real = rawQuatReal;
+}
+
+//Gets the acceleration without converting it, Q8
+void BNO085::getAccelFixed(BNO085Vector &accel)
+{
+	accel.x = rawAccelX;
+	accel.y = rawAccelY;
+	accel.z = rawAccelZ;
+}
+
+//Gets the linear acceleration without converting it, Q8
+void BNO085::getLinAccelFixed(BNO085Vector &linAccel)
+{
+	linAccel.x = rawLinAccelX;
+	linAccel.y = rawLinAccelY;
+	linAccel.z = rawLinAccelZ;
+}
+
+//Gets the gravity vector without converting it, Q8
+void BNO085::getGravityFixed(BNO085Vector &gravity)
+{
+	gravity.x = rawGravityX;
+	gravity.y = rawGravityY;
+	gravity.z = rawGravityZ;
+}
+
+//Gets the gyro without converting it, Q9
+void BNO085::getGyroFixed(BNO085Vector &gyro)
+{
+	gyro.x = rawGyroX;
+	gyro.y = rawGyroY;
+	gyro.z = rawGyroZ;
+}
+
+//Gets the magnetic field without converting it, Q4
+void BNO085::getMagFixed(BNO085Vector &mag)
+{
+	mag.x = rawMagX;
+	mag.y = rawMagY;
+	mag.z = rawMagZ;
+}
+
 //Gets the full quaternion
 //i,j,k,real output floats
 void BNO085::getQuat(float &i, float &j, float &k, float &real, float &radAccuracy, uint8_t &accuracy)
@@ -673,6 +2018,165 @@ uint8_t BNO085::getMagAccuracy()
 	return (magAccuracy);
 }
 
+//Gets the full gravity vector
+//x,y,z output floats
+void BNO085::getGravity(float &x, float &y, float &z, uint8_t &accuracy)
+{
+	x = qToFloat(rawGravityX, gravity_Q1);
+	y = qToFloat(rawGravityY, gravity_Q1);
+	z = qToFloat(rawGravityZ, gravity_Q1);
+	accuracy = gravityAccuracy;
+}
+
+//Return the gravity component
+float BNO085::getGravityX()
+{
+	float value = qToFloat(rawGravityX, gravity_Q1);
+	return (value);
+}
+
+//Return the gravity component
+float BNO085::getGravityY()
+{
+	float value = qToFloat(rawGravityY, gravity_Q1);
+	return (value);
+}
+
+//Return the gravity component
+float BNO085::getGravityZ()
+{
+	float value = qToFloat(rawGravityZ, gravity_Q1);
+	return (value);
+}
+
+//Return the gravity accuracy
+uint8_t BNO085::getGravityAccuracy()
+{
+	return (gravityAccuracy);
+}
+
+//Gets the uncalibrated gyro and the gyro bias the hub has estimated
+//Subtract the bias from x,y,z to get the calibrated reading
+void BNO085::getUncalibratedGyro(float &x, float &y, float &z, float &biasX, float &biasY, float &biasZ, uint8_t &accuracy)
+{
+	x = qToFloat(rawUncalibGyroX, gyro_Q1);
+	y = qToFloat(rawUncalibGyroY, gyro_Q1);
+	z = qToFloat(rawUncalibGyroZ, gyro_Q1);
+	biasX = qToFloat(rawBiasGyroX, gyro_Q1);
+	biasY = qToFloat(rawBiasGyroY, gyro_Q1);
+	biasZ = qToFloat(rawBiasGyroZ, gyro_Q1);
+	accuracy = uncalibGyroAccuracy;
+}
+
+//Return the uncalibrated gyro component
+float BNO085::getUncalibratedGyroX()
+{
+	float value = qToFloat(rawUncalibGyroX, gyro_Q1);
+	return (value);
+}
+
+//Return the uncalibrated gyro component
+float BNO085::getUncalibratedGyroY()
+{
+	float value = qToFloat(rawUncalibGyroY, gyro_Q1);
+	return (value);
+}
+
+//Return the uncalibrated gyro component
+float BNO085::getUncalibratedGyroZ()
+{
+	float value = qToFloat(rawUncalibGyroZ, gyro_Q1);
+	return (value);
+}
+
+//Return the gyro bias component
+float BNO085::getUncalibratedGyroBiasX()
+{
+	float value = qToFloat(rawBiasGyroX, gyro_Q1);
+	return (value);
+}
+
+//Return the gyro bias component
+float BNO085::getUncalibratedGyroBiasY()
+{
+	float value = qToFloat(rawBiasGyroY, gyro_Q1);
+	return (value);
+}
+
+//Return the gyro bias component
+float BNO085::getUncalibratedGyroBiasZ()
+{
+	float value = qToFloat(rawBiasGyroZ, gyro_Q1);
+	return (value);
+}
+
+//Return the uncalibrated gyro accuracy
+uint8_t BNO085::getUncalibratedGyroAccuracy()
+{
+	return (uncalibGyroAccuracy);
+}
+
+//Gets the uncalibrated mag and the hard iron offset the hub has estimated
+//Subtract the bias from x,y,z to get the calibrated reading
+void BNO085::getUncalibratedMag(float &x, float &y, float &z, float &biasX, float &biasY, float &biasZ, uint8_t &accuracy)
+{
+	x = qToFloat(rawUncalibMagX, magnetometer_Q1);
+	y = qToFloat(rawUncalibMagY, magnetometer_Q1);
+	z = qToFloat(rawUncalibMagZ, magnetometer_Q1);
+	biasX = qToFloat(rawBiasMagX, magnetometer_Q1);
+	biasY = qToFloat(rawBiasMagY, magnetometer_Q1);
+	biasZ = qToFloat(rawBiasMagZ, magnetometer_Q1);
+	accuracy = uncalibMagAccuracy;
+}
+
+//Return the uncalibrated mag component
+float BNO085::getUncalibratedMagX()
+{
+	float value = qToFloat(rawUncalibMagX, magnetometer_Q1);
+	return (value);
+}
+
+//Return the uncalibrated mag component
+float BNO085::getUncalibratedMagY()
+{
+	float value = qToFloat(rawUncalibMagY, magnetometer_Q1);
+	return (value);
+}
+
+//Return the uncalibrated mag component
+float BNO085::getUncalibratedMagZ()
+{
+	float value = qToFloat(rawUncalibMagZ, magnetometer_Q1);
+	return (value);
+}
+
+//Return the hard iron offset component
+float BNO085::getUncalibratedMagBiasX()
+{
+	float value = qToFloat(rawBiasMagX, magnetometer_Q1);
+	return (value);
+}
+
+//Return the hard iron offset component
+float BNO085::getUncalibratedMagBiasY()
+{
+	float value = qToFloat(rawBiasMagY, magnetometer_Q1);
+	return (value);
+}
+
+//Return the hard iron offset component
+float BNO085::getUncalibratedMagBiasZ()
+{
+	float value = qToFloat(rawBiasMagZ, magnetometer_Q1);
+	return (value);
+}
+
+//Return the uncalibrated mag accuracy
+uint8_t BNO085::getUncalibratedMagAccuracy()
+{
+	return (uncalibMagAccuracy);
+}
+
 //Gets the full high rate gyro vector
 //x,y,z output floats
 void BNO085::getFastGyro(float &x, float &y, float &z)
@@ -711,28 +2215,251 @@ uint8_t BNO085::getTapDetector()
 	return (previousTapDetector);
 }
 
-//Return the step count
-uint16_t BNO085::getStepCount()
-{
-	return (stepCount);
-}
+//Return true if significant motion was detected since the last call
+//The hub turns the sensor off after it fires. Call enableSignificantMotion() again to rearm it.
+bool BNO085::getSignificantMotion()
+{
+	bool previousSignificantMotion = significantMotion;
+	significantMotion = false; //Reset so user code sees exactly one event
+	return (previousSignificantMotion);
+}
+
+//Return the shake detector
+uint8_t BNO085::getShakeDetector()
+{
+	uint8_t previousShakeDetector = shakeDetector;
+	shakeDetector = 0; //Reset so user code sees exactly one shake
+	return (previousShakeDetector);
+}
+
+//Return the stability detector
+uint8_t BNO085::getStabilityDetector()
+{
+	uint8_t previousStabilityDetector = stabilityDetector;
+	stabilityDetector = 0; //Reset so user code sees each change once
+	return (previousStabilityDetector);
+}
+
+//Return the step count
+uint16_t BNO085::getStepCount()
+{
+	return (stepCount);
+}
+
+//Return the stability classifier
+uint8_t BNO085::getStabilityClassification()
+{
+	return (stabilityClassifier);
+}
+
+//Return the activity classifier
+uint8_t BNO085::getActivityClassification()
+{
+	return (activityClassifier);
+}
+
+//Return the time stamp
+uint32_t BNO085::getTimeStamp()
+{
+	return (timeStamp);
+}
+
+//Return when the last report was sampled, in micros() time
+//Built from when the packet was sent less the base timestamp, plus any rebase and the report's delay.
+//It is 64 bits so it does not roll over. Call markInterrupt() from an INT pin interrupt to time the
+//packet from the INT edge. Otherwise it is timed from when it was read, which can be later.
+uint64_t BNO085::getTimeStampMicros()
+{
+	return (_reportMicros);
+}
+
+//Return the hub's clock from the last raw accelerometer, gyro or magnetometer report
+//It is in the hub's microseconds, which can run a little fast or slow. See hubToHostMicros().
+uint64_t BNO085::getHubMicros()
+{
+	return (_hubMicros);
+}
+
+//Convert a time on the hub's clock to micros() time, using the drift and offset seen so far
+//Needs a raw accelerometer, gyro or magnetometer report to be enabled
+//Returns hubMicros unchanged until the first raw report arrives
+uint64_t BNO085::hubToHostMicros(uint64_t hubMicros)
+{
+	return (_clock.hubToHostMicros(hubMicros));
+}
+
+//Returns how far micros() runs ahead of the hub clock, in parts per million
+//Measured from the report count of a steady sensor, which every input packet carrying it adds to,
+//or from the raw reports' hub times until such a sensor has a confirmed interval
+float BNO085::getClockDrift()
+{
+	if (_reportClock.getReadings() > 0)
+		return (_reportClock.getDrift());
+	return (_clock.getDrift());
+}
+
+//Forget the hub clock estimate, for example after the hub resets
+void BNO085::resetClockEstimate()
+{
+	_clock.reset();
+	_hubMicrosValid = false;
+	_reportClock.reset();
+	_clockReportID = 0;
+}
+
+//Reports the hub sent since the one numbered lastSequence, from this one's sequence number
+//The number rolls over at 256. After a longer gap the time between them says how many rollovers.
+static uint32_t reportsSince(uint8_t sequence, uint8_t lastSequence, int32_t elapsed, uint32_t interval)
+{
+	uint32_t count = (uint8_t)(sequence - lastSequence);
+	int32_t expected = (elapsed + (int32_t)(interval / 2)) / (int32_t)interval;
+	if (expected - (int32_t)count > 128)
+		count += (uint32_t)((expected - (int32_t)count + 128) / 256) * 256;
+	return (count);
+}
+
+//The hub paces a steady sensor with its own clock and numbers its reports, so report n was sampled
+//n confirmed intervals into the run on the hub's clock. The first such sensor with a confirmed interval
+//and no change sensitivity (which skips reports) is followed until its interval changes.
+void BNO085::updateReportClock(uint8_t reportID, uint8_t sequence)
+{
+	if (_clockReportID == 0)
+	{
+		uint32_t interval = getReportInterval(reportID);
+		ReportMode *mode = findReportMode(reportID, false);
+		if (interval == 0 || (mode != NULL && (mode->flags & FEATURE_CHANGE_ENABLED)))
+			return;
+		_clockReportID = reportID;
+		_clockInterval = interval;
+		_clockHubMicros = 0;
+		_reportClock.reset();
+	}
+	else if (reportID != _clockReportID || sequence == _clockSequence)
+		return; //Another sensor, or sent twice
+	else
+	{
+		int32_t elapsed = (int32_t)((uint32_t)_reportMicros - _clockLastMicros);
+		_clockHubMicros += (uint64_t)reportsSince(sequence, _clockSequence, elapsed, _clockInterval) * _clockInterval;
+	}
+	_clockSequence = sequence;
+	_clockLastMicros = (uint32_t)_reportMicros;
+	_reportClock.update(_clockHubMicros, _reportMicros);
+}
+
+//Note when the packet about to be read was sent. The hub times its reports from the INT edge that
+//announced the packet, so use the time markInterrupt() saw it if we have it. Otherwise use now.
+void BNO085::markFragmentTime()
+{
+	_rxFragmentMicros = (_rxIntMarked == true) ? _intMicros : micros();
+	_rxIntMarked = false; //Only the first packet after the edge
+}
+
+//Extend a micros() reading to 64 bits so timestamps don't roll over every 71 minutes
+//Readings a little older than the last one are fine. Needs a reading at least every 35 minutes.
+uint64_t BNO085::extendMicros(uint32_t now)
+{
+	if (_lastMicrosValid == false)
+		_lastMicros = now;
+	else
+		_lastMicros += (int32_t)(now - (uint32_t)_lastMicros);
+	_lastMicrosValid = true;
+	return (_lastMicros);
+}
+
+//Track the hub clock against micros(). Each reading gives both clocks for the same moment.
+//Our side is late by however long the packet waited to be read, never early. So the readings with the
+//least delay are the good ones: keep the smallest offset seen in each window of BNO085_CLOCK_WINDOW
+//hub microseconds. The drift is the slope of a least squares line through those, fading out windows
+//older than about BNO085_CLOCK_WINDOWS. A line over many windows averages out how late the best
+//reading of each one still was, which a slope from one window to the next does not.
+void BNO085ClockEstimate::update(uint64_t hubMicros, uint64_t hostMicros)
+{
+	if (_samples == 0)
+	{
+		_offsetBase = (int64_t)(hostMicros - hubMicros);
+		_offset = 0;
+		_lastHub = hubMicros;
+		_windowStart = hubMicros;
+		_windowMin = 0;
+		_windowMinHub = hubMicros;
+		_fitWeight = 0;
+		_samples = 1;
+		return;
+	}
+	_samples++;
+
+	float offset = (float)((int64_t)(hostMicros - hubMicros) - _offsetBase);
+	float windowOffset = offset - _drift * (float)(int64_t)(hubMicros - _windowStart); //As if at the window start
+	if (windowOffset < _windowMin)
+	{
+		_windowMin = windowOffset;
+		_windowMinHub = hubMicros;
+		if (_fitWeight == 0)
+		{
+			//Until the first window is over, this is the best we have
+			_offset = offset;
+			_lastHub = hubMicros;
+		}
+	}
+
+	if ((int64_t)(hubMicros - _windowStart) < BNO085_CLOCK_WINDOW)
+		return;
 
-//Return the stability classifier
-uint8_t BNO085::getStabilityClassification()
-{
-	return (stabilityClassifier);
+	//The window is over. Add its best reading to the line, measuring hub times from it.
+	float bestOffset = _windowMin + _drift * (float)(int64_t)(_windowMinHub - _windowStart);
+	if (_fitWeight > 0)
+	{
+		//Readings are only ever late, so a best reading well above the line is from a window where none got
+		//through quickly, for example while the bus was busy with another device. Hold it to the usual spread
+		//so a run of those cannot tilt the line.
+		float above = bestOffset - (_offset + _drift * (float)(int64_t)(_windowMinHub - _lastHub));
+		float size = (above < 0) ? -above : above;
+		if (_fitWeight > 4 && size > _spread)
+		{
+			if (above > 0)
+				bestOffset -= above - _spread;
+			size = _spread;
+		}
+		_spread += (size - _spread) / ((_fitWeight < BNO085_CLOCK_WINDOWS) ? _fitWeight + 1 : BNO085_CLOCK_WINDOWS);
+	}
+	_fitHub -= (float)(int64_t)(_windowMinHub - _lastHub);
+	_lastHub = _windowMinHub;
+
+	const float keep = 1.0f - 1.0f / BNO085_CLOCK_WINDOWS;
+	_fitWeight = _fitWeight * keep + 1;
+	float hubStep = -_fitHub; //The new reading is at hub time 0
+	float offsetStep = bestOffset - _fitOffset;
+	_fitHub += hubStep / _fitWeight;
+	_fitOffset += offsetStep / _fitWeight;
+	_fitHubHub = _fitHubHub * keep + hubStep * -_fitHub;
+	_fitHubOffset = _fitHubOffset * keep + hubStep * (bestOffset - _fitOffset);
+	if (_fitHubHub > 0)
+		_drift = _fitHubOffset / _fitHubHub;
+	_offset = _fitOffset - _drift * _fitHub; //Where the line is at _lastHub
+
+	_windowStart = hubMicros;
+	_windowMin = offset;
+	_windowMinHub = hubMicros;
 }
 
-//Return the activity classifier
-uint8_t BNO085::getActivityClassification()
+uint64_t BNO085ClockEstimate::hubToHostMicros(uint64_t hubMicros)
 {
-	return (activityClassifier);
+	if (_samples == 0)
+		return (hubMicros);
+	float correction = _offset + _drift * (float)(int64_t)(hubMicros - _lastHub);
+	return (hubMicros + _offsetBase + (int64_t)correction);
 }
 
-//Return the time stamp
-uint32_t BNO085::getTimeStamp()
+void BNO085ClockEstimate::reset()
 {
-	return (timeStamp);
+	_samples = 0;
+	_drift = 0;
+	_fitWeight = 0;
+	_fitHub = 0;
+	_fitOffset = 0;
+	_fitHubHub = 0;
+	_fitHubOffset = 0;
+	_spread = 0;
 }
 
 //Return raw mems value for the accel
@@ -926,7 +2653,8 @@ bool BNO085::readFRSdata(uint16_t recordID, uint8_t startLocation, uint8_t words
 }
 
 //Send command to reset IC
-//Read all advertisement packets from sensor
+//Read all advertisement packets from sensor. The advertisement is parsed as it is read, see advertisementByte().
+//The reset itself goes to the executable channel from the last advertisement seen, or channel 1.
 //The sensor has been seen to reset twice if we attempt too much too quickly.
 //This seems to work reliably.
 void BNO085::softReset(void)
@@ -936,6 +2664,10 @@ void BNO085::softReset(void)
 	//Attempt to start communication with sensor
 	sendPacket(CHANNEL_EXECUTABLE, 1); //Transmit packet on channel 1, 1 byte
 
+	//The hub restarts its sequence numbers after a reset, and turns every sensor off
+	_rxSequenceValid = 0;
+	_featureCount = 0;
+
 	//Read all incoming data and flush it
 	delay(50);
 	while (receivePacket() == true)
@@ -1003,114 +2735,178 @@ uint8_t BNO085::resetReason()
 	return (0);
 }
 
+//Returns 2^-qPoint, the value of one count at that Q point
+//The float is put together from its exponent bits, so there is no pow() and it is exact
+static float qScale(uint8_t qPoint)
+{
+	if (qPoint > 126)
+		return (0); //Smaller than a float can hold
+	uint32_t bits = (uint32_t)(127 - qPoint) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return (scale);
+}
+
 //Given a register value and a Q point, convert to float
 //See https://en.wikipedia.org/wiki/Q_(number_format)
 float BNO085::qToFloat(int16_t fixedPointValue, uint8_t qPoint)
 {
 	float qFloat = fixedPointValue;
-	qFloat *= pow(2, qPoint * -1);
+	qFloat *= qScale(qPoint);
 	return (qFloat);
 }
 
+//Convert count register values that share a Q point. The scale is worked out once.
+void BNO085::qToFloat(const int16_t *fixedPointValues, float *values, uint8_t count, uint8_t qPoint)
+{
+	float scale = qScale(qPoint);
+	for (uint8_t x = 0; x < count; x++)
+		values[x] = fixedPointValues[x] * scale;
+}
+
 //Sends the packet to enable the rotation vector
-void BNO085::enableRotationVector(long microsBetweenReports)
+bool BNO085::enableRotationVector(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_ROTATION_VECTOR, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_ROTATION_VECTOR, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the ar/vr stabilized rotation vector
-void BNO085::enableARVRStabilizedRotationVector(long microsBetweenReports)
+bool BNO085::enableARVRStabilizedRotationVector(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_AR_VR_STABILIZED_ROTATION_VECTOR, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_AR_VR_STABILIZED_ROTATION_VECTOR, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the rotation vector
-void BNO085::enableGameRotationVector(long microsBetweenReports)
+bool BNO085::enableGameRotationVector(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_GAME_ROTATION_VECTOR, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_GAME_ROTATION_VECTOR, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the ar/vr stabilized rotation vector
-void BNO085::enableARVRStabilizedGameRotationVector(long microsBetweenReports)
+bool BNO085::enableARVRStabilizedGameRotationVector(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_AR_VR_STABILIZED_GAME_ROTATION_VECTOR, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_AR_VR_STABILIZED_GAME_ROTATION_VECTOR, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the accelerometer
-void BNO085::enableAccelerometer(long microsBetweenReports)
+bool BNO085::enableAccelerometer(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_ACCELEROMETER, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_ACCELEROMETER, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the accelerometer
-void BNO085::enableLinearAccelerometer(long microsBetweenReports)
+bool BNO085::enableLinearAccelerometer(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_LINEAR_ACCELERATION, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_LINEAR_ACCELERATION, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the gyro
-void BNO085::enableGyro(long microsBetweenReports)
+bool BNO085::enableGyro(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_GYROSCOPE, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_GYROSCOPE, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the magnetometer
-void BNO085::enableMagnetometer(long microsBetweenReports)
+bool BNO085::enableMagnetometer(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_MAGNETIC_FIELD, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_MAGNETIC_FIELD, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the high refresh-rate gyro-integrated rotation vector
-void BNO085::enableGyroIntegratedRotationVector(long microsBetweenReports)
+bool BNO085::enableGyroIntegratedRotationVector(long microsBetweenReports, long microsBetweenBatches)
+{
+	return (setFeatureCommand(SENSOR_REPORTID_GYRO_INTEGRATED_ROTATION_VECTOR, microsBetweenReports, 0, microsBetweenBatches));
+}
+
+//Sends the packet to enable the geomagnetic rotation vector
+//It uses the accelerometer and magnetometer only. Read it with getQuat().
+bool BNO085::enableGeomagneticRotationVector(long microsBetweenReports, long microsBetweenBatches)
+{
+	return (setFeatureCommand(SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR, microsBetweenReports, 0, microsBetweenBatches));
+}
+
+//Sends the packet to enable the gravity vector
+bool BNO085::enableGravity(long microsBetweenReports, long microsBetweenBatches)
+{
+	return (setFeatureCommand(SENSOR_REPORTID_GRAVITY, microsBetweenReports, 0, microsBetweenBatches));
+}
+
+//Sends the packet to enable the uncalibrated gyro
+bool BNO085::enableUncalibratedGyro(long microsBetweenReports, long microsBetweenBatches)
+{
+	return (setFeatureCommand(SENSOR_REPORTID_UNCALIBRATED_GYRO, microsBetweenReports, 0, microsBetweenBatches));
+}
+
+//Sends the packet to enable the uncalibrated magnetometer
+bool BNO085::enableUncalibratedMagnetometer(long microsBetweenReports, long microsBetweenBatches)
+{
+	return (setFeatureCommand(SENSOR_REPORTID_UNCALIBRATED_MAGNETIC_FIELD, microsBetweenReports, 0, microsBetweenBatches));
+}
+
+//Sends the packet to enable the significant motion detector
+//This is a one-shot sensor. It sends one report then turns itself off.
+bool BNO085::enableSignificantMotion(long microsBetweenReports, long microsBetweenBatches)
+{
+	return (setFeatureCommand(SENSOR_REPORTID_SIGNIFICANT_MOTION, microsBetweenReports, 0, microsBetweenBatches));
+}
+
+//Sends the packet to enable the shake detector
+bool BNO085::enableShakeDetector(long microsBetweenReports, long microsBetweenBatches)
+{
+	return (setFeatureCommand(SENSOR_REPORTID_SHAKE_DETECTOR, microsBetweenReports, 0, microsBetweenBatches));
+}
+
+//Sends the packet to enable the stability detector
+bool BNO085::enableStabilityDetector(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_GYRO_INTEGRATED_ROTATION_VECTOR, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_STABILITY_DETECTOR, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the tap detector
-void BNO085::enableTapDetector(long microsBetweenReports)
+bool BNO085::enableTapDetector(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_TAP_DETECTOR, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_TAP_DETECTOR, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the step counter
-void BNO085::enableStepCounter(long microsBetweenReports)
+bool BNO085::enableStepCounter(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_STEP_COUNTER, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_STEP_COUNTER, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the Stability Classifier
-void BNO085::enableStabilityClassifier(long microsBetweenReports)
+bool BNO085::enableStabilityClassifier(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_STABILITY_CLASSIFIER, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_STABILITY_CLASSIFIER, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the raw accel readings
 //Note you must enable basic reporting on the sensor as well
-void BNO085::enableRawAccelerometer(long microsBetweenReports)
+bool BNO085::enableRawAccelerometer(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_RAW_ACCELEROMETER, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_RAW_ACCELEROMETER, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the raw accel readings
 //Note you must enable basic reporting on the sensor as well
-void BNO085::enableRawGyro(long microsBetweenReports)
+bool BNO085::enableRawGyro(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_RAW_GYROSCOPE, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_RAW_GYROSCOPE, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the raw accel readings
 //Note you must enable basic reporting on the sensor as well
-void BNO085::enableRawMagnetometer(long microsBetweenReports)
+bool BNO085::enableRawMagnetometer(long microsBetweenReports, long microsBetweenBatches)
 {
-	setFeatureCommand(SENSOR_REPORTID_RAW_MAGNETOMETER, microsBetweenReports);
+	return (setFeatureCommand(SENSOR_REPORTID_RAW_MAGNETOMETER, microsBetweenReports, 0, microsBetweenBatches));
 }
 
 //Sends the packet to enable the various activity classifiers
-void BNO085::enableActivityClassifier(long microsBetweenReports, uint32_t activitiesToEnable, uint8_t (&activityConfidences)[9])
+bool BNO085::enableActivityClassifier(long microsBetweenReports, uint32_t activitiesToEnable, uint8_t (&activityConfidences)[9], long microsBetweenBatches)
 {
 	_activityConfidences = activityConfidences; //Store pointer to array
 
-	setFeatureCommand(SENSOR_REPORTID_PERSONAL_ACTIVITY_CLASSIFIER, microsBetweenReports, activitiesToEnable);
+	return (setFeatureCommand(SENSOR_REPORTID_PERSONAL_ACTIVITY_CLASSIFIER, microsBetweenReports, activitiesToEnable, microsBetweenBatches));
 }
 
 //Sends the commands to begin calibration of the accelerometer
@@ -1168,35 +2964,279 @@ void BNO085::tareZAxis(uint8_t basisVector)
 }
 
 //Given a sensor's report ID, this tells the BNO085 to begin reporting the values
-void BNO085::setFeatureCommand(uint8_t reportID, long microsBetweenReports)
+bool BNO085::setFeatureCommand(uint8_t reportID, long microsBetweenReports)
 {
-	setFeatureCommand(reportID, microsBetweenReports, 0); //No specific config
+	return (setFeatureCommand(reportID, microsBetweenReports, 0)); //No specific config
 }
 
 //Given a sensor's report ID, this tells the BNO085 to begin reporting the values
 //Also sets the specific config word. Useful for personal activity classifier
-void BNO085::setFeatureCommand(uint8_t reportID, long microsBetweenReports, uint32_t specificConfig)
+//A non-zero batch interval lets the hub hold reports in its FIFO for up to that many microseconds
+//and deliver them together. Use drainBatch() to force them out early.
+//The hub answers with the configuration it actually applied, see getFeature(). Returns false if no answer came.
+bool BNO085::setFeatureCommand(uint8_t reportID, long microsBetweenReports, uint32_t specificConfig, long microsBetweenBatches)
 {
 	shtpData[0] = SHTP_REPORT_SET_FEATURE_COMMAND;	 //Set feature command. Reference page 55
 	shtpData[1] = reportID;							   //Feature Report ID. 0x01 = Accelerometer, 0x05 = Rotation vector
 	shtpData[2] = 0;								   //Feature flags
 	shtpData[3] = 0;								   //Change sensitivity (LSB)
 	shtpData[4] = 0;								   //Change sensitivity (MSB)
+	ReportMode *mode = findReportMode(reportID, false);
+	if (mode != NULL)
+	{
+		shtpData[2] = mode->flags;
+		shtpData[3] = mode->sensitivity & 0xFF;
+		shtpData[4] = mode->sensitivity >> 8;
+		mode->interval = microsBetweenReports;
+		mode->received = 0; //Count from the first report at the new interval
+		mode->timed = false;
+	}
 	shtpData[5] = (microsBetweenReports >> 0) & 0xFF;  //Report interval (LSB) in microseconds. 0x7A120 = 500ms
 	shtpData[6] = (microsBetweenReports >> 8) & 0xFF;  //Report interval
 	shtpData[7] = (microsBetweenReports >> 16) & 0xFF; //Report interval
 	shtpData[8] = (microsBetweenReports >> 24) & 0xFF; //Report interval (MSB)
-	shtpData[9] = 0;								   //Batch Interval (LSB)
-	shtpData[10] = 0;								   //Batch Interval
-	shtpData[11] = 0;								   //Batch Interval
-	shtpData[12] = 0;								   //Batch Interval (MSB)
+	shtpData[9] = (microsBetweenBatches >> 0) & 0xFF;  //Batch Interval (LSB)
+	shtpData[10] = (microsBetweenBatches >> 8) & 0xFF; //Batch Interval
+	shtpData[11] = (microsBetweenBatches >> 16) & 0xFF; //Batch Interval
+	shtpData[12] = (microsBetweenBatches >> 24) & 0xFF; //Batch Interval (MSB)
 	shtpData[13] = (specificConfig >> 0) & 0xFF;	   //Sensor-specific config (LSB)
 	shtpData[14] = (specificConfig >> 8) & 0xFF;	   //Sensor-specific config
 	shtpData[15] = (specificConfig >> 16) & 0xFF;	  //Sensor-specific config
 	shtpData[16] = (specificConfig >> 24) & 0xFF;	  //Sensor-specific config (MSB)
 
 	//Transmit packet on channel 2, 17 bytes
-	sendPacket(CHANNEL_CONTROL, 17);
+	if (sendPacket(CHANNEL_CONTROL, 17) == false)
+		return (false);
+	return (waitForFeature(reportID));
+}
+
+//Ask the hub how a sensor is configured
+//See 6.5.4 Get Feature Request and 6.5.5 Get Feature Response
+bool BNO085::requestFeature(uint8_t reportID, BNO085Feature &feature)
+{
+	shtpData[0] = SHTP_REPORT_GET_FEATURE_REQUEST; //Get feature request
+	shtpData[1] = reportID;						   //Sensor to ask about
+
+	//Transmit packet on channel 2, 2 bytes
+	if (sendPacket(CHANNEL_CONTROL, 2) == false)
+		return (false);
+	if (waitForFeature(reportID) == false)
+		return (false);
+	return (getFeature(reportID, feature));
+}
+
+bool BNO085::getFeature(uint8_t reportID, BNO085Feature &feature)
+{
+	BNO085Feature *stored = findFeature(reportID, false);
+	if (stored == NULL)
+		return (false);
+	feature = *stored;
+	return (true);
+}
+
+uint32_t BNO085::getReportInterval(uint8_t reportID)
+{
+	BNO085Feature *stored = findFeature(reportID, false);
+	return ((stored != NULL) ? stored->interval : 0);
+}
+
+float BNO085::getReportRate(uint8_t reportID)
+{
+	uint32_t interval = getReportInterval(reportID);
+	return ((interval > 0) ? 1000000.0f / interval : 0);
+}
+
+//Read packets until the hub's Get Feature Response for reportID arrives. Anything before it is handled as getReadings() would.
+//Skipped while the non-blocking receive is part way through a packet: the answer is still stored when poll() gets to it.
+bool BNO085::waitForFeature(uint8_t reportID)
+{
+	if (_rxState != SHTP_RX_IDLE || _rxTransferRemaining > 0)
+		return (false);
+
+	uint8_t counter = 0;
+	uint8_t packets = 0;
+	while (packets < 250) //Reports can keep coming, so do not wait for ever
+	{
+		if (receiveAnnouncedPacket() == false)
+		{
+			if (counter++ > 100)
+				break; //Give up
+			delay(1);
+			continue;
+		}
+		counter = 0;
+		packets++;
+
+		if (dispatchPacket() == SHTP_REPORT_GET_FEATURE_RESPONSE && shtpData[1] == reportID)
+			return (true);
+	}
+	return (false);
+}
+
+//Keep the configuration from a Get Feature Response
+//The hub sends one after every Set Feature Command, and whenever it changes a sensor's configuration itself
+void BNO085::storeFeature(const uint8_t *response)
+{
+	BNO085Feature *feature = findFeature(response[1], true);
+	if (feature == NULL)
+		return;
+	feature->flags = response[2];
+	feature->sensitivity = (uint16_t)response[4] << 8 | response[3];
+	feature->interval = (uint32_t)response[8] << 24 | (uint32_t)response[7] << 16 | (uint32_t)response[6] << 8 | response[5];
+	feature->batchInterval = (uint32_t)response[12] << 24 | (uint32_t)response[11] << 16 | (uint32_t)response[10] << 8 | response[9];
+	feature->specificConfig = (uint32_t)response[16] << 24 | (uint32_t)response[15] << 16 | (uint32_t)response[14] << 8 | response[13];
+
+	ReportMode *mode = findReportMode(response[1], false);
+	if (mode != NULL)
+		mode->interval = feature->interval; //Size suppressed reports from the interval really in use
+
+	if (response[1] == _clockReportID && feature->interval != _clockInterval)
+		_clockReportID = 0; //Start the report clock again, from whichever steady sensor reports next
+}
+
+//Find the stored configuration of reportID. With add, a new entry is made, or one for a sensor that is off reused.
+BNO085Feature *BNO085::findFeature(uint8_t reportID, bool add)
+{
+	for (uint8_t x = 0; x < _featureCount; x++)
+		if (_features[x].reportID == reportID)
+			return (&_features[x]);
+	if (add == false)
+		return (NULL);
+
+	BNO085Feature *feature = NULL;
+	if (_featureCount < BNO085_MAX_FEATURES)
+		feature = &_features[_featureCount++];
+	else
+	{
+		for (uint8_t x = 0; x < _featureCount && feature == NULL; x++)
+			if (_features[x].interval == 0)
+				feature = &_features[x];
+		if (feature == NULL)
+			return (NULL); //Full of sensors that are on
+	}
+	memset(feature, 0, sizeof(BNO085Feature));
+	feature->reportID = reportID;
+	return (feature);
+}
+
+//Only send reportID when its value has changed by sensitivity since it was last sent, rather than every interval
+//Absolute sensitivity is in the report's own units and Q point, so 26 is 0.1m/s^2 for the Q8 accelerometer.
+//Relative sensitivity is a fraction of the last value, see the SH-2 reference manual. Call before enabling the report.
+bool BNO085::setChangeSensitivity(uint8_t reportID, uint16_t sensitivity, bool relative)
+{
+	ReportMode *mode = findReportMode(reportID, true);
+	if (mode == NULL)
+		return (false);
+	mode->flags &= ~(FEATURE_CHANGE_ENABLED | FEATURE_CHANGE_RELATIVE);
+	if (sensitivity > 0)
+		mode->flags |= FEATURE_CHANGE_ENABLED | (relative ? FEATURE_CHANGE_RELATIVE : 0);
+	mode->sensitivity = sensitivity;
+	return (true);
+}
+
+//Send reportID on the wake channel, so it wakes a sleeping host. Call before enabling the report.
+bool BNO085::setWakeUp(uint8_t reportID, bool enable)
+{
+	ReportMode *mode = findReportMode(reportID, true);
+	if (mode == NULL)
+		return (false);
+	if (enable)
+		mode->flags |= FEATURE_WAKE_UP;
+	else
+		mode->flags &= ~FEATURE_WAKE_UP;
+	return (true);
+}
+
+//Keep reportID's sensor running while the hub sleeps. Call before enabling the report.
+bool BNO085::setAlwaysOn(uint8_t reportID, bool enable)
+{
+	ReportMode *mode = findReportMode(reportID, true);
+	if (mode == NULL)
+		return (false);
+	if (enable)
+		mode->flags |= FEATURE_ALWAYS_ON;
+	else
+		mode->flags &= ~FEATURE_ALWAYS_ON;
+	return (true);
+}
+
+uint8_t BNO085::getFeatureFlags(uint8_t reportID)
+{
+	ReportMode *mode = findReportMode(reportID, false);
+	return ((mode != NULL) ? mode->flags : 0);
+}
+
+uint32_t BNO085::getReportsReceived(uint8_t reportID)
+{
+	ReportMode *mode = findReportMode(reportID, false);
+	return ((mode != NULL) ? mode->received : 0);
+}
+
+//How many report intervals passed with no report because of the change sensitivity
+//A quiet spell is counted when the report after it arrives. The one still going is added up to now.
+uint32_t BNO085::getSuppressedReports(uint8_t reportID)
+{
+	ReportMode *mode = findReportMode(reportID, false);
+	if (mode == NULL)
+		return (0);
+	return (mode->suppressed + quietIntervals(*mode, micros()));
+}
+
+//Start the counts again from now. The quiet spell still going is split: the part before now is dropped.
+void BNO085::clearReportCounts()
+{
+	uint32_t now = micros();
+	for (uint8_t x = 0; x < _reportModeCount; x++)
+	{
+		ReportMode &mode = _reportModes[x];
+		mode.lastMicros += quietIntervals(mode, now) * mode.interval; //Keep the hub's phase
+		mode.received = 0;
+		mode.suppressed = 0;
+	}
+}
+
+//Whole report intervals since the last report of a quiet spell that has not ended yet
+//A report sampled but not read by now is counted as held back, so this can be one high.
+uint32_t BNO085::quietIntervals(const ReportMode &mode, uint32_t now)
+{
+	if ((mode.flags & FEATURE_CHANGE_ENABLED) == 0 || mode.timed == false || mode.interval == 0)
+		return (0);
+	return ((now - mode.lastMicros) / mode.interval);
+}
+
+//Find the flags kept for reportID, adding an entry with none set if add is true and there is room
+BNO085::ReportMode *BNO085::findReportMode(uint8_t reportID, bool add)
+{
+	for (uint8_t x = 0; x < _reportModeCount; x++)
+		if (_reportModes[x].reportID == reportID)
+			return (&_reportModes[x]);
+	if (add == false || _reportModeCount >= BNO085_MAX_REPORT_MODES)
+		return (NULL);
+
+	ReportMode *mode = &_reportModes[_reportModeCount++];
+	memset(mode, 0, sizeof(ReportMode));
+	mode->reportID = reportID;
+	return (mode);
+}
+
+//Count a report that has flags set. With a change sensitivity, each whole interval since the last one
+//was a report the hub held back.
+void BNO085::countReport(uint8_t reportID)
+{
+	ReportMode *mode = findReportMode(reportID, false);
+	if (mode == NULL)
+		return;
+
+	uint32_t now = (uint32_t)_reportMicros;
+	if ((mode->flags & FEATURE_CHANGE_ENABLED) && mode->timed == true && mode->interval > 0)
+	{
+		uint32_t intervals = (now - mode->lastMicros + mode->interval / 2) / mode->interval;
+		if (intervals > 1)
+			mode->suppressed += intervals - 1;
+	}
+	mode->lastMicros = now;
+	mode->timed = true;
+	mode->received++;
 }
 
 //Tell the sensor to do a command
@@ -1360,6 +3400,7 @@ void BNO085::persistTare()
 	sendCommand(COMMAND_TARE);
 }
 
+#ifndef BNO085_NO_I2C
 //Wait a certain time for incoming I2C bytes before giving up
 //Returns false if failed
 bool BNO085::waitForI2C()
@@ -1375,7 +3416,9 @@ bool BNO085::waitForI2C()
 		_debugPort->println(F("I2C timeout"));
 	return (false);
 }
+#endif
 
+#ifndef BNO085_NO_SPI
 //Blocking wait for BNO085 to assert (pull low) the INT pin
 //indicating it's ready for comm. Can take more than 104ms
 //after a hardware reset
@@ -1395,209 +3438,685 @@ bool BNO085::waitForSPI()
 	return (false);
 }
 
+//Exchange a buffer of bytes with the BNO085 over SPI. The buffer is overwritten with the incoming bytes.
+//Uses the core's buffer transfer (or the user's DMA hook) so there is no per-byte call overhead.
+//Define BNO085_SPI_BYTE_TRANSFER for cores that do not have transfer(buf, count).
+void BNO085::spiTransfer(uint8_t *buffer, uint16_t length)
+{
+	if (length == 0)
+		return;
+
+	if (_spiTransferHook != NULL)
+	{
+		_spiTransferHook(buffer, length);
+		return;
+	}
+
+#if defined(BNO085_SPI_BYTE_TRANSFER)
+	for (uint16_t x = 0; x < length; x++)
+		buffer[x] = _spiPort->transfer(buffer[x]);
+#else
+	_spiPort->transfer(buffer, length);
+#endif
+}
+
+//Use a custom function for SPI buffer transfers, for example one that uses DMA
+//The function is called with CS already low and the transaction begun. It must send the buffer and
+//replace its contents with the received bytes before returning. Pass NULL to go back to the SPI library.
+void BNO085::setSPITransferHook(BNO085_SPITransferHook transferHook)
+{
+	_spiTransferHook = transferHook;
+}
+#endif
+
 //Check to see if there is any new data available
 //Read the contents of the incoming packet into the shtpData array
 bool BNO085::receivePacket(void)
 {
-	if (_i2cPort == NULL) //Do SPI
+	if (_replayPort != NULL)
+		return (receiveReplayPacket());
+
+#if defined(BNO085_NO_I2C)
+	return (receiveSPIPacket());
+#elif defined(BNO085_NO_SPI)
+	return (receiveI2CPacket());
+#else
+	if (usingSPI())
+		return (receiveSPIPacket());
+	return (receiveI2CPacket());
+#endif
+}
+
+#ifndef BNO085_NO_SPI
+//Read a packet over SPI
+bool BNO085::receiveSPIPacket(void)
+{
+	if (digitalRead(_int) == HIGH)
+		return (false); //Data is not available
+
+	//Old way: if (waitForSPI() == false) return (false); //Something went wrong
+
+	//Get first four bytes to find out how much data we need to read
+
+	_spiPort->beginTransaction(SPISettings(_spiPortSpeed, MSBFIRST, SPI_MODE3));
+	digitalWrite(_cs, LOW);
+
+	//Get the first four bytes, aka the packet header
+	uint8_t header[4] = {0, 0, 0, 0}; //We have nothing to send
+	spiTransfer(header, 4);
+	uint8_t packetLSB = header[0];
+	uint8_t packetMSB = header[1];
+	uint8_t channelNumber = localChannel(header[2]); //From here on channels are CHANNEL_x
+	uint8_t sequenceNumber = header[3];
+
+	//Store the header info
+	shtpHeader[0] = packetLSB;
+	shtpHeader[1] = packetMSB;
+	shtpHeader[2] = channelNumber;
+	shtpHeader[3] = sequenceNumber;
+
+	//Calculate the number of data bytes in this packet
+	uint16_t packetLength = (((uint16_t)packetMSB) << 8) | ((uint16_t)packetLSB);
+	if ((packetLength & ~(1 << 15)) < 4)
 	{
-		if (digitalRead(_int) == HIGH)
-			return (false); //Data is not available
+		//Packet is empty
+		digitalWrite(_cs, HIGH); //Release BNO085
+		_spiPort->endTransaction();
+		printHeader();
+		return (false); //All done
+	}
+	checkSequence(channelNumber, sequenceNumber);
+
+	//The MSbit indicates if this packet is a continuation of the last
+	//Work out where it goes and how much of it to read
+	markFragmentTime();
+	uint16_t dataLength = beginFragment(channelNumber, packetLength);
+	captureHeader(BNO085_CAPTURE_RECEIVED, shtpHeader, dataLength, dataLength);
+
+	//Read incoming data straight into the shtpData array
+	//BNO085 can respond with upto 270 bytes, only the first MAX_PACKET_SIZE are kept
+	uint16_t dataSpot = 0;
+	if (_rxTransferDiscard == false && _rxTransferOffset < MAX_PACKET_SIZE)
+	{
+		dataSpot = dataLength;
+		if (dataSpot > MAX_PACKET_SIZE - _rxTransferOffset)
+			dataSpot = MAX_PACKET_SIZE - _rxTransferOffset;
+		memset(&shtpData[_rxTransferOffset], 0xFF, dataSpot);
+		spiTransfer(&shtpData[_rxTransferOffset], dataSpot);
+		captureBytes(&shtpData[_rxTransferOffset], dataSpot);
+
+		for (uint16_t x = 0; x < dataSpot; x++)
+			parseByte(shtpData[_rxTransferOffset + x]);
+	}
 
-		//Old way: if (waitForSPI() == false) return (false); //Something went wrong
+	//Anything that did not fit is read in small chunks and only seen by the sensor report parser
+	while (dataSpot < dataLength)
+	{
+		uint8_t chunk[32];
+		uint16_t chunkLength = dataLength - dataSpot;
+		if (chunkLength > sizeof(chunk))
+			chunkLength = sizeof(chunk);
+		memset(chunk, 0xFF, chunkLength);
+		spiTransfer(chunk, chunkLength);
+
+		for (uint16_t x = 0; x < chunkLength; x++)
+			receiveByte(dataSpot++, chunk[x]);
+	}
+	endFragment(dataLength);
 
-		//Get first four bytes to find out how much data we need to read
+	digitalWrite(_cs, HIGH); //Release BNO085
 
-		_spiPort->beginTransaction(SPISettings(_spiPortSpeed, MSBFIRST, SPI_MODE3));
-		digitalWrite(_cs, LOW);
+	_spiPort->endTransaction();
+	printPacket();
 
-		//Get the first four bytes, aka the packet header
-		uint8_t packetLSB = _spiPort->transfer(0);
-		uint8_t packetMSB = _spiPort->transfer(0);
-		uint8_t channelNumber = _spiPort->transfer(0);
-		uint8_t sequenceNumber = _spiPort->transfer(0); //Not sure if we need to store this or not
+	return (true); //We're done!
+}
+#endif
 
-		//Store the header info
-		shtpHeader[0] = packetLSB;
-		shtpHeader[1] = packetMSB;
-		shtpHeader[2] = channelNumber;
-		shtpHeader[3] = sequenceNumber;
+#ifndef BNO085_NO_I2C
+//Read a packet over I2C, in as many reads as the Wire buffer needs
+bool BNO085::receiveI2CPacket(void)
+{
+	if (receiveI2CHeader(true) == false)
+		return (false); //Error or empty packet
 
-		//Calculate the number of data bytes in this packet
-		uint16_t dataLength = (((uint16_t)packetMSB) << 8) | ((uint16_t)packetLSB);
-		dataLength &= ~(1 << 15); //Clear the MSbit.
-		//This bit indicates if this package is a continuation of the last. Ignore it for now.
-		//TODO catch this as an error and exit
-		if (dataLength == 0)
-		{
-			//Packet is empty
-			printHeader();
-			return (false); //All done
-		}
-		dataLength -= 4; //Remove the header bytes from the data count
+	//Read whatever did not fit
+	if (getData(_rxDataLength - _rxDataSpot, _rxDataSpot) == false)
+	{
+		abortTransfer(); //We don't know how much the BNO085 thinks we read
+		return (false);
+	}
+	endFragment(_rxDataLength);
 
-		//Read incoming data into the shtpData array
-		for (uint16_t dataSpot = 0; dataSpot < dataLength; dataSpot++)
-		{
-			uint8_t incoming = _spiPort->transfer(0xFF);
-			if (dataSpot < MAX_PACKET_SIZE)	//BNO085 can respond with upto 270 bytes, avoid overflow
-				shtpData[dataSpot] = incoming; //Store data into the shtpData array
-		}
+	return (true); //We're done!
+}
 
-		digitalWrite(_cs, HIGH); //Release BNO085
+//Read the packet header over I2C, plus any payload that fits in the same read
+//On success the stream parser is started and _rxDataLength/_rxDataSpot say how much payload is left
+//Returns false if the sensor did not respond or the packet is empty
+//If wait is false we don't poll for the response. Wire reads complete inside requestFrom on most platforms.
+bool BNO085::receiveI2CHeader(bool wait)
+{
+	//Ask for four bytes to find out how much data we need to read
+	//If single reads are enabled, ask for the header and as much payload as we expect in one go
+	uint16_t firstReadLength = 4;
+	if (_i2cSingleReadLength > 4)
+		firstReadLength = _i2cSingleReadLength;
+	if (_maxReadLength > 0 && firstReadLength > _maxReadLength + 4)
+		firstReadLength = _maxReadLength + 4; //Bytes we read and throw away would be lost
+	firstReadLength = readLimit(firstReadLength - 4) + 4;
+
+	_i2cPort->requestFrom((uint8_t)_deviceAddress, (size_t)firstReadLength);
+	if (wait == true && waitForI2C() == false)
+		return (false); //Error
+	if (_i2cPort->available() < 4)
+		return (false); //Sensor did not respond
+	_i2cBytesRead += firstReadLength;
+	_i2cHeaderBytesRead += 4;
+
+	//Get the first four bytes, aka the packet header
+	uint8_t packetLSB = _i2cPort->read();
+	uint8_t packetMSB = _i2cPort->read();
+	uint8_t channelNumber = localChannel(_i2cPort->read()); //From here on channels are CHANNEL_x
+	uint8_t sequenceNumber = _i2cPort->read();
+
+	//Store the header info.
+	shtpHeader[0] = packetLSB;
+	shtpHeader[1] = packetMSB;
+	shtpHeader[2] = channelNumber;
+	shtpHeader[3] = sequenceNumber;
 
-		_spiPort->endTransaction();
-		printPacket();
+	//Calculate the number of data bytes in this packet
+	uint16_t packetLength = (((uint16_t)packetMSB) << 8) | ((uint16_t)packetLSB);
+
+	// if (_printDebug == true)
+	// {
+	// 	_debugPort->print(F("receivePacket (I2C): packetLength is: "));
+	// 	_debugPort->println(packetLength);
+	// }
+
+	if ((packetLength & ~(1 << 15)) < 4)
+	{
+		//Packet is empty
+		while (_i2cPort->available())
+			_i2cPort->read(); //Throw away the rest of a single read
+		return (false); //All done
+	}
+	checkSequence(channelNumber, sequenceNumber);
+
+	//The MSbit indicates if this packet is a continuation of the last
+	//Work out where it goes and how much of it to read
+	markFragmentTime();
+	uint16_t dataLength = beginFragment(channelNumber, packetLength);
+
+	//Use any payload that came in with the header
+	uint16_t dataSpot = 0;
+	if (_capturePort != NULL)
+	{
+		uint16_t firstLength = dataLength;
+		if (firstLength > firstReadLength - 4)
+			firstLength = firstReadLength - 4;
+		captureHeader(BNO085_CAPTURE_RECEIVED, shtpHeader, dataLength, firstLength);
+	}
+	while (dataSpot < dataLength && dataSpot < (firstReadLength - 4))
+	{
+		uint8_t incoming = _i2cPort->read();
+		receiveByte(dataSpot++, incoming); //Store data into the shtpData array and parse any sensor reports
 	}
-	else //Do I2C
+	_rxDataLength = dataLength;
+	_rxDataSpot = dataSpot;
+	while (_i2cPort->available())
+		_i2cPort->read(); //The packet was shorter than the single read. Throw away the padding.
+
+	return (true);
+}
+
+//Sends multiple requests to sensor until all data bytes are received from sensor
+//The shtpData buffer has max capacity of MAX_PACKET_SIZE. Any bytes over this amount are only seen by the sensor report parser.
+//The Wire buffer limits each read. Every read starts with the 4 byte header again, so the max data we can
+//read per interation is the I2C buffer length less 4 bytes (28 bytes on the default 32 byte buffer)
+//dataSpot is where in the packet payload to start, for when some of it has already been read
+bool BNO085::getData(uint16_t bytesRemaining, uint16_t dataSpot)
+{
+	//Setup a series of chunked reads
+	while (bytesRemaining > 0)
 	{
-		_i2cPort->requestFrom((uint8_t)_deviceAddress, (size_t)4); //Ask for four bytes to find out how much data we need to read
-		if (waitForI2C() == false)
+		uint16_t numberOfBytesRead = getDataChunk(bytesRemaining, dataSpot, true);
+		if (numberOfBytesRead == 0)
 			return (false); //Error
 
-		//Get the first four bytes, aka the packet header
-		uint8_t packetLSB = _i2cPort->read();
-		uint8_t packetMSB = _i2cPort->read();
-		uint8_t channelNumber = _i2cPort->read();
-		uint8_t sequenceNumber = _i2cPort->read(); //Not sure if we need to store this or not
-
-		//Store the header info.
-		shtpHeader[0] = packetLSB;
-		shtpHeader[1] = packetMSB;
-		shtpHeader[2] = channelNumber;
-		shtpHeader[3] = sequenceNumber;
-
-		//Calculate the number of data bytes in this packet
-		uint16_t dataLength = (((uint16_t)packetMSB) << 8) | ((uint16_t)packetLSB);
-		dataLength &= ~(1 << 15); //Clear the MSbit.
-		//This bit indicates if this package is a continuation of the last. Ignore it for now.
-		//TODO catch this as an error and exit
-
-		// if (_printDebug == true)
-		// {
-		// 	_debugPort->print(F("receivePacket (I2C): dataLength is: "));
-		// 	_debugPort->println(dataLength);
-		// }
-
-		if (dataLength == 0)
+		dataSpot += numberOfBytesRead;
+		bytesRemaining -= numberOfBytesRead;
+	}
+	return (true); //Done!
+}
+
+//Send a single request for the next chunk of payload bytes
+//Returns the number of payload bytes read, 0 if the sensor did not respond
+uint16_t BNO085::getDataChunk(uint16_t bytesRemaining, uint16_t dataSpot, bool wait)
+{
+	uint16_t numberOfBytesToRead = bytesRemaining;
+	if (numberOfBytesToRead > (_i2cBufferLength - 4))
+		numberOfBytesToRead = (_i2cBufferLength - 4);
+	numberOfBytesToRead = readLimit(numberOfBytesToRead);
+
+	_i2cPort->requestFrom((uint8_t)_deviceAddress, (size_t)(numberOfBytesToRead + 4));
+	if (wait == true && waitForI2C() == false)
+		return (0); //Error
+	if (_i2cPort->available() < numberOfBytesToRead + 4)
+		return (0); //Sensor did not respond
+	_i2cBytesRead += numberOfBytesToRead + 4;
+	_i2cHeaderBytesRead += 4;
+
+	//The first four bytes are header bytes and are throw away
+	//Every read gets its own header, so keep track of the sequence number
+	uint8_t header[4];
+	for (uint8_t x = 0; x < 4; x++)
+		header[x] = _i2cPort->read();
+	header[2] = localChannel(header[2]);
+	checkSequence(header[2], header[3]);
+	captureHeader(BNO085_CAPTURE_CHUNK, header, numberOfBytesToRead, numberOfBytesToRead);
+
+	for (uint16_t x = 0; x < numberOfBytesToRead; x++)
+	{
+		uint8_t incoming = _i2cPort->read();
+		receiveByte(dataSpot++, incoming); //Store data into the shtpData array and parse any sensor reports
+	}
+
+	return (numberOfBytesToRead);
+}
+
+#endif
+
+//Given the data packet, send the header then the data
+//Returns false if sensor does not ACK
+//TODO - Arduino has a max 32 byte send. Break sending into multi packets if needed.
+bool BNO085::sendPacket(uint8_t channelNumber, uint8_t dataLength)
+{
+	if (_advertisement.maxTransferWrite > 0 && dataLength + 4 > _advertisement.maxTransferWrite)
+		return (false); //More than the hub takes in one go
+	if (_capturePort != NULL)
+	{
+		uint8_t header[4];
+		header[0] = (dataLength + 4) & 0xFF;
+		header[1] = (dataLength + 4) >> 8;
+		header[2] = channelNumber;
+		header[3] = sequenceNumber[channelNumber];
+		captureHeader(BNO085_CAPTURE_SENT, header, dataLength, dataLength);
+		captureBytes(shtpData, dataLength);
+	}
+
+	if (_replayPort != NULL)
+	{
+		sequenceNumber[channelNumber]++; //There is no BNO085 to send it to
+		return (true);
+	}
+
+#if defined(BNO085_NO_I2C)
+	return (sendSPIPacket(channelNumber, dataLength));
+#elif defined(BNO085_NO_SPI)
+	return (sendI2CPacket(channelNumber, dataLength));
+#else
+	if (usingSPI())
+		return (sendSPIPacket(channelNumber, dataLength));
+	return (sendI2CPacket(channelNumber, dataLength));
+#endif
+}
+
+#ifndef BNO085_NO_SPI
+//Send a packet over SPI
+bool BNO085::sendSPIPacket(uint8_t channelNumber, uint8_t dataLength)
+{
+	uint8_t packetLength = dataLength + 4; //Add four bytes for the header
+
+	//Wait for BNO085 to indicate it is available for communication
+	if (waitForSPI() == false)
+		return (false); //Something went wrong
+
+	//BNO085 has max CLK of 3MHz, MSB first,
+	//The BNO085 uses CPOL = 1 and CPHA = 1. This is mode3
+	_spiPort->beginTransaction(SPISettings(_spiPortSpeed, MSBFIRST, SPI_MODE3));
+	digitalWrite(_cs, LOW);
+
+	//Send the 4 byte packet header
+	uint8_t header[4];
+	header[0] = packetLength & 0xFF;			 //Packet length LSB
+	header[1] = packetLength >> 8;				 //Packet length MSB
+	header[2] = _channelNumbers[channelNumber];	 //Channel number, as the hub advertised it
+	header[3] = sequenceNumber[channelNumber]++; //Send the sequence number, increments with each packet sent, different counter for each channel
+	spiTransfer(header, 4);
+
+	//SPI is full duplex. If the hub had a packet waiting, it clocks it out while we write and counts
+	//whatever we clocked as read. Take it the way receiveSPIPacket() would rather than lose it.
+	uint16_t cargoRead = 0;
+	uint16_t receivedLength = (((uint16_t)header[1]) << 8) | ((uint16_t)header[0]);
+	bool received = ((receivedLength & ~(1 << 15)) >= 4);
+	if (received == true)
+	{
+		shtpHeader[0] = header[0];
+		shtpHeader[1] = header[1];
+		shtpHeader[2] = localChannel(header[2]); //From here on channels are CHANNEL_x
+		shtpHeader[3] = header[3];
+		checkSequence(shtpHeader[2], shtpHeader[3]);
+		markFragmentTime();
+		beginFragment(shtpHeader[2], receivedLength);
+
+		//We only get as much of it as we write, and never more than the hub sends in one transfer
+		cargoRead = _rxFragmentLength;
+		if (cargoRead > dataLength)
+			cargoRead = dataLength;
+		if (_advertisement.maxTransferRead > 4 && cargoRead > _advertisement.maxTransferRead - 4)
+			cargoRead = _advertisement.maxTransferRead - 4;
+		captureHeader(BNO085_CAPTURE_RECEIVED, shtpHeader, cargoRead, cargoRead);
+	}
+
+	//Send the user's data packet a piece at a time, so what comes back does not land on bytes still to be sent.
+	//A continuation is stored after the earlier pieces of its transfer, so past the first piece it still could.
+	//Throw that transfer away instead.
+	uint8_t chunk[32];
+	if (received == true && _rxTransferDiscard == false && _rxTransferOffset > 0 && dataLength > sizeof(chunk))
+		discardTransfer();
+	uint16_t dataSpot = 0;
+	while (dataSpot < dataLength)
+	{
+		uint16_t chunkLength = dataLength - dataSpot;
+		if (chunkLength > sizeof(chunk))
+			chunkLength = sizeof(chunk);
+		memcpy(chunk, &shtpData[dataSpot], chunkLength);
+		spiTransfer(chunk, chunkLength);
+
+		for (uint16_t x = 0; x < chunkLength && dataSpot + x < cargoRead; x++)
+			receiveByte(dataSpot + x, chunk[x]);
+		dataSpot += chunkLength;
+	}
+
+	digitalWrite(_cs, HIGH);
+	_spiPort->endTransaction();
+
+	if (received == true)
+	{
+		endFragment(cargoRead);
+		printPacket();
+		dispatchPacket(); //Command responses update their state as usual. Sensor reports were parsed as they came in.
+	}
+
+	return (true);
+}
+#endif
+
+#ifndef BNO085_NO_I2C
+//Send a packet over I2C
+bool BNO085::sendI2CPacket(uint8_t channelNumber, uint8_t dataLength)
+{
+	uint8_t packetLength = dataLength + 4; //Add four bytes for the header
+
+	//if(packetLength > I2C_BUFFER_LENGTH) return(false); //You are trying to send too much. Break into smaller packets.
+
+	_i2cPort->beginTransmission(_deviceAddress);
+
+	//Send the 4 byte packet header
+	_i2cPort->write(packetLength & 0xFF);			  //Packet length LSB
+	_i2cPort->write(packetLength >> 8);				  //Packet length MSB
+	_i2cPort->write(_channelNumbers[channelNumber]);  //Channel number, as the hub advertised it
+	_i2cPort->write(sequenceNumber[channelNumber]++); //Send the sequence number, increments with each packet sent, different counter for each channel
+
+	//Send the user's data packet
+	for (uint8_t i = 0; i < dataLength; i++)
+	{
+		_i2cPort->write(shtpData[i]);
+	}
+
+	uint8_t i2cResult = _i2cPort->endTransmission();
+
+	if (i2cResult != 0)
+	{
+		if (_printDebug == true)
 		{
-			//Packet is empty
-			return (false); //All done
+			_debugPort->print(F("sendPacket(I2C): endTransmission returned: "));
+			_debugPort->println(i2cResult);
 		}
-		dataLength -= 4; //Remove the header bytes from the data count
+		return (false);
+	}
+
+	return (true);
+}
+#endif
+
+//Record every packet sent to and received from the BNO085 to capturePort, in the binary format
+//described in the header (see BNO085_CAPTURE_VERSION). Each record is stamped with micros().
+//Much lighter than printPacket(): nothing is formatted and long packets are recorded in full.
+//Feed the capture back in with beginReplay(). Don't send debug output to the same port.
+void BNO085::enableCapture(Print &capturePort)
+{
+	captureFinish();
+	_capturePort = &capturePort;
+
+	uint8_t start[5] = {'S', 'H', 'T', 'P', BNO085_CAPTURE_VERSION};
+	_capturePort->write(start, 5);
+}
+
+void BNO085::disableCapture()
+{
+	captureFinish();
+	_capturePort = NULL;
+}
+
+//Start a capture record. payloadLength bytes must follow through captureBytes().
+//readLength is how many payload bytes will be read for the whole packet, over all its I2C reads.
+void BNO085::captureHeader(uint8_t recordType, const uint8_t *header, uint16_t readLength, uint16_t payloadLength)
+{
+	if (_capturePort == NULL)
+		return;
+	captureFinish(); //The last packet was cut short
+
+	uint32_t now = micros();
+	if (recordType == BNO085_CAPTURE_RECEIVED)
+		now = _rxFragmentMicros; //What the reports will be timed from, so a replay times them the same
+	uint8_t record[BNO085_CAPTURE_RECORD_SIZE];
+	record[0] = recordType;
+	record[1] = now & 0xFF;
+	record[2] = (now >> 8) & 0xFF;
+	record[3] = (now >> 16) & 0xFF;
+	record[4] = now >> 24;
+	memcpy(&record[5], header, 4);
+	record[9] = readLength & 0xFF;
+	record[10] = readLength >> 8;
+	record[11] = payloadLength & 0xFF;
+	record[12] = payloadLength >> 8;
+	_capturePort->write(record, BNO085_CAPTURE_RECORD_SIZE);
+	_captureRemaining = payloadLength;
+}
+
+//Add payload bytes to the record being written
+void BNO085::captureBytes(const uint8_t *data, uint16_t length)
+{
+	if (length > _captureRemaining)
+		length = _captureRemaining;
+	if (length == 0)
+		return;
+	_capturePort->write(data, length);
+	_captureRemaining -= length;
+}
 
-		getData(dataLength);
+//A read that fails part way leaves a record short. Fill it with 0xFF so the capture can still be read.
+void BNO085::captureFinish()
+{
+	while (_captureRemaining > 0)
+	{
+		_capturePort->write(0xFF);
+		_captureRemaining--;
 	}
+}
 
-	return (true); //We're done!
+//Take packets from a capture made with enableCapture() instead of the bus
+//Received packets go through the same reassembly, sequence checks and parsing as live ones, read
+//in the same size pieces as when they were captured. Packets the library sends are thrown away.
+//With realTime the packets come out as far apart as they were captured. Otherwise they come as fast as
+//getReadings() or poll() are called. Call beginReplay() instead of begin() or beginSPI().
+void BNO085::beginReplay(Stream &replayPort, bool realTime)
+{
+	if (_replayPort == NULL)
+		_replayInt = _int;
+	_replayPort = &replayPort;
+	_replayRealTime = realTime;
+	_replayStarted = false;
+	_replayPending = false;
+	_replaySkip = 0;
+	_replayDataLength = 0;
+	_replayDataSpot = 0;
+
+	_int = 255; //There is no INT pin to check
+	_rxState = SHTP_RX_IDLE;
+	_rxTransferRemaining = 0;
+	_rxSequenceValid = 0;
 }
 
-//Sends multiple requests to sensor until all data bytes are received from sensor
-//The shtpData buffer has max capacity of MAX_PACKET_SIZE. Any bytes over this amount will be lost.
-//Arduino I2C read limit is 32 bytes. Header is 4 bytes, so max data we can read per interation is 28 bytes
-bool BNO085::getData(uint16_t bytesRemaining)
+//Go back to the bus. Only useful if begin() or beginSPI() was called before beginReplay().
+void BNO085::endReplay()
 {
-	uint16_t dataSpot = 0; //Start at the beginning of shtpData array
+	if (_replayPort == NULL)
+		return;
+	_replayPort = NULL;
+	_int = _replayInt;
+	_rxState = SHTP_RX_IDLE;
+	abortTransfer();
+}
 
-	//Setup a series of chunked 32 byte reads
-	while (bytesRemaining > 0)
+//Returns true when there is nothing left to read from the capture
+bool BNO085::replayFinished()
+{
+	if (_replayPort == NULL)
+		return (true);
+	return (_replayPending == false && _replaySkip == 0 && _replayPort->available() == 0);
+}
+
+//Read the next record from the capture up to the start of its payload
+//Returns false if there is not a whole record header available yet
+bool BNO085::readReplayRecord(void)
+{
+	while (_replaySkip > 0) //The rest of a packet we sent
 	{
-		uint16_t numberOfBytesToRead = bytesRemaining;
-		if (numberOfBytesToRead > (I2C_BUFFER_LENGTH - 4))
-			numberOfBytesToRead = (I2C_BUFFER_LENGTH - 4);
+		if (_replayPort->available() == 0)
+			return (false);
+		_replayPort->read();
+		_replaySkip--;
+	}
 
-		_i2cPort->requestFrom((uint8_t)_deviceAddress, (size_t)(numberOfBytesToRead + 4));
-		if (waitForI2C() == false)
-			return (0); //Error
+	if (_replayPort->peek() == 'S') //The start of a capture
+	{
+		if (_replayPort->available() < 5)
+			return (false);
+		uint8_t start[5];
+		for (uint8_t x = 0; x < 5; x++)
+			start[x] = _replayPort->read();
+		if (start[4] != BNO085_CAPTURE_VERSION && _printDebug == true)
+		{
+			_debugPort->print(F("readReplayRecord: Unknown capture version: "));
+			_debugPort->println(start[4]);
+		}
+		return (true);
+	}
 
-		//The first four bytes are header bytes and are throw away
-		_i2cPort->read();
-		_i2cPort->read();
-		_i2cPort->read();
-		_i2cPort->read();
+	if (_replayPort->available() < BNO085_CAPTURE_RECORD_SIZE)
+		return (false);
+	for (uint8_t x = 0; x < BNO085_CAPTURE_RECORD_SIZE; x++)
+		_replayRecord[x] = _replayPort->read();
 
-		for (uint8_t x = 0; x < numberOfBytesToRead; x++)
+	uint16_t payloadLength = (uint16_t)_replayRecord[12] << 8 | _replayRecord[11];
+	if (_replayRecord[0] == BNO085_CAPTURE_RECEIVED || _replayRecord[0] == BNO085_CAPTURE_CHUNK)
+		_replayPending = true;
+	else
+	{
+		if (_replayRecord[0] != BNO085_CAPTURE_SENT && _printDebug == true)
 		{
-			uint8_t incoming = _i2cPort->read();
-			if (dataSpot < MAX_PACKET_SIZE)
-			{
-				shtpData[dataSpot++] = incoming; //Store data into the shtpData array
-			}
-			else
-			{
-				//Do nothing with the data
-			}
+			_debugPort->print(F("readReplayRecord: Unknown record type: 0x"));
+			_debugPort->println(_replayRecord[0], HEX);
 		}
-
-		bytesRemaining -= numberOfBytesToRead;
+		_replaySkip = payloadLength;
 	}
-	return (true); //Done!
+	return (true);
 }
 
-//Given the data packet, send the header then the data
-//Returns false if sensor does not ACK
-//TODO - Arduino has a max 32 byte send. Break sending into multi packets if needed.
-bool BNO085::sendPacket(uint8_t channelNumber, uint8_t dataLength)
+//Replay the next received packet from the capture
+//Returns false until every read of the packet has been replayed
+bool BNO085::receiveReplayPacket(void)
 {
-	uint8_t packetLength = dataLength + 4; //Add four bytes for the header
-
-	if (_i2cPort == NULL) //Do SPI
+	while (true)
 	{
-		//Wait for BNO085 to indicate it is available for communication
-		if (waitForSPI() == false)
-			return (false); //Something went wrong
-
-		//BNO085 has max CLK of 3MHz, MSB first,
-		//The BNO085 uses CPOL = 1 and CPHA = 1. This is mode3
-		_spiPort->beginTransaction(SPISettings(_spiPortSpeed, MSBFIRST, SPI_MODE3));
-		digitalWrite(_cs, LOW);
-
-		//Send the 4 byte packet header
-		_spiPort->transfer(packetLength & 0xFF);			 //Packet length LSB
-		_spiPort->transfer(packetLength >> 8);				 //Packet length MSB
-		_spiPort->transfer(channelNumber);					 //Channel number
-		_spiPort->transfer(sequenceNumber[channelNumber]++); //Send the sequence number, increments with each packet sent, different counter for each channel
-
-		//Send the user's data packet
-		for (uint8_t i = 0; i < dataLength; i++)
+		while (_replayPending == false)
 		{
-			_spiPort->transfer(shtpData[i]);
+			if (readReplayRecord() == false)
+				return (false); //Nothing more to read yet
 		}
 
-		digitalWrite(_cs, HIGH);
-		_spiPort->endTransaction();
-	}
-	else //Do I2C
-	{
-		//if(packetLength > I2C_BUFFER_LENGTH) return(false); //You are trying to send too much. Break into smaller packets.
-
-		_i2cPort->beginTransmission(_deviceAddress);
-
-		//Send the 4 byte packet header
-		_i2cPort->write(packetLength & 0xFF);			  //Packet length LSB
-		_i2cPort->write(packetLength >> 8);				  //Packet length MSB
-		_i2cPort->write(channelNumber);					  //Channel number
-		_i2cPort->write(sequenceNumber[channelNumber]++); //Send the sequence number, increments with each packet sent, different counter for each channel
-
-		//Send the user's data packet
-		for (uint8_t i = 0; i < dataLength; i++)
+		unsigned long capturedMicros = (uint32_t)_replayRecord[4] << 24 | (uint32_t)_replayRecord[3] << 16 | (uint32_t)_replayRecord[2] << 8 | _replayRecord[1];
+		if (_replayRealTime == true)
 		{
-			_i2cPort->write(shtpData[i]);
+			if (_replayStarted == false)
+			{
+				_replayOffset = micros() - capturedMicros;
+				_replayStarted = true;
+			}
+			if ((long)(micros() - _replayOffset - capturedMicros) < 0)
+				return (false); //Not due yet
 		}
 
-		uint8_t i2cResult = _i2cPort->endTransmission();
+		uint16_t payloadLength = (uint16_t)_replayRecord[12] << 8 | _replayRecord[11];
+		if (_replayPort->available() < payloadLength)
+			return (false); //Wait for the rest of the record
+		_replayPending = false;
 
-		if (i2cResult != 0)
+		uint8_t *header = &_replayRecord[5];
+		if (_replayRecord[0] == BNO085_CAPTURE_CHUNK)
 		{
-			if (_printDebug == true)
+			if (_replayDataSpot >= _replayDataLength)
 			{
-				_debugPort->print(F("sendPacket(I2C): endTransmission returned: "));
-				_debugPort->println(i2cResult);
+				_replaySkip = payloadLength; //The packet it belongs to was cut short
+				continue;
 			}
-			return (false);
+			checkSequence(header[2], header[3]);
+		}
+		else
+		{
+			if (_replayDataSpot < _replayDataLength)
+				abortTransfer(); //The rest of the last packet was never read
+
+			memcpy(shtpHeader, header, 4);
+			uint16_t packetLength = (uint16_t)shtpHeader[1] << 8 | shtpHeader[0];
+			uint16_t cargoLength = packetLength & ~(1 << 15);
+			if (cargoLength < 4)
+			{
+				_replaySkip = payloadLength; //Empty packets are not captured, but don't trip over one
+				_replayDataLength = 0;
+				_replayDataSpot = 0;
+				continue;
+			}
+			cargoLength -= 4;
+			checkSequence(shtpHeader[2], shtpHeader[3]);
+
+			//Read as much as was read when it was captured, whatever setMaxReadLength() says now
+			_rxFragmentMicros = capturedMicros; //Time the reports as they were when captured
+			beginFragment(shtpHeader[2], packetLength);
+			_replayDataLength = (uint16_t)_replayRecord[10] << 8 | _replayRecord[9];
+			if (_replayDataLength > cargoLength)
+				_replayDataLength = cargoLength;
+			_replayDataSpot = 0;
+		}
+
+		for (uint16_t x = 0; x < payloadLength; x++)
+		{
+			uint8_t incoming = _replayPort->read();
+			if (_replayDataSpot < _replayDataLength)
+				receiveByte(_replayDataSpot++, incoming); //Store data into the shtpData array and parse any sensor reports
 		}
+
+		if (_replayDataSpot >= _replayDataLength)
+			break; //Every read of the packet is in
 	}
 
+	endFragment(_replayDataLength);
+	printPacket();
+
 	return (true);
 }
 
@@ -1677,3 +4196,629 @@ void BNO085::printHeader(void)
 		_debugPort->println();
 	}
 }
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Fixed point math
+
+//atan(2^-n) for each CORDIC step, in 1/16 of a binary angle (2^20 is one turn)
+static const uint32_t cordicAngles[18] PROGMEM = {131072, 77376, 40884, 20753, 10417, 5213, 2607, 1304, 652, 326, 163, 81, 41, 20, 10, 5, 3, 1};
+#define BNO085_CORDIC_90 (1L << 18)
+
+//Round a Q28 product back to Q14 and keep it in range
+static int16_t roundToQ14(int32_t value)
+{
+	value = (value + (1L << 13)) >> 14;
+	if (value > 32767)
+		return (32767);
+	if (value < -32768)
+		return (-32768);
+	return ((int16_t)value);
+}
+
+BNO085Quat BNO085Fixed::multiply(const BNO085Quat &a, const BNO085Quat &b)
+{
+	BNO085Quat result;
+	result.real = roundToQ14((int32_t)a.real * b.real - (int32_t)a.i * b.i - (int32_t)a.j * b.j - (int32_t)a.k * b.k);
+	result.i = roundToQ14((int32_t)a.real * b.i + (int32_t)a.i * b.real + (int32_t)a.j * b.k - (int32_t)a.k * b.j);
+	result.j = roundToQ14((int32_t)a.real * b.j - (int32_t)a.i * b.k + (int32_t)a.j * b.real + (int32_t)a.k * b.i);
+	result.k = roundToQ14((int32_t)a.real * b.k + (int32_t)a.i * b.j - (int32_t)a.j * b.i + (int32_t)a.k * b.real);
+	return (result);
+}
+
+BNO085Quat BNO085Fixed::conjugate(const BNO085Quat &q)
+{
+	BNO085Quat result;
+	result.i = -q.i;
+	result.j = -q.j;
+	result.k = -q.k;
+	result.real = q.real;
+	return (result);
+}
+
+BNO085Quat BNO085Fixed::normalize(const BNO085Quat &q)
+{
+	//Sum the squares in Q26 so four full scale values cannot overflow, then use Q28 if there is room
+	uint32_t sum = ((uint32_t)((int32_t)q.i * q.i) >> 2) + ((uint32_t)((int32_t)q.j * q.j) >> 2) +
+				   ((uint32_t)((int32_t)q.k * q.k) >> 2) + ((uint32_t)((int32_t)q.real * q.real) >> 2);
+	uint8_t shift = 13;
+	if (sum < (1UL << 30))
+	{
+		sum <<= 2;
+		shift = 14;
+	}
+	int32_t norm = sqrt(sum); //Q13 or Q14
+	if (norm == 0)
+		return (q);
+
+	BNO085Quat result;
+	result.i = ((int32_t)q.i << shift) / norm;
+	result.j = ((int32_t)q.j << shift) / norm;
+	result.k = ((int32_t)q.k << shift) / norm;
+	result.real = ((int32_t)q.real << shift) / norm;
+	return (result);
+}
+
+//v' = v + real * t + q x t, where t = 2 * (q x v)
+BNO085Vector BNO085Fixed::rotate(const BNO085Quat &q, const BNO085Vector &v)
+{
+	int32_t tx = ((int32_t)q.j * v.z - (int32_t)q.k * v.y + (1L << 12)) >> 13;
+	int32_t ty = ((int32_t)q.k * v.x - (int32_t)q.i * v.z + (1L << 12)) >> 13;
+	int32_t tz = ((int32_t)q.i * v.y - (int32_t)q.j * v.x + (1L << 12)) >> 13;
+
+	int32_t x = ((int32_t)v.x << 14) + q.real * tx + q.j * tz - q.k * ty;
+	int32_t y = ((int32_t)v.y << 14) + q.real * ty + q.k * tx - q.i * tz;
+	int32_t z = ((int32_t)v.z << 14) + q.real * tz + q.i * ty - q.j * tx;
+
+	BNO085Vector result;
+	result.x = roundToQ14(x);
+	result.y = roundToQ14(y);
+	result.z = roundToQ14(z);
+	return (result);
+}
+
+BNO085Quat BNO085Fixed::relative(const BNO085Quat &from, const BNO085Quat &to)
+{
+	return (multiply(conjugate(from), to));
+}
+
+//The same angles as getEuler(), from Q28 products
+//cos(pitch) comes from the roll terms rather than from sin(pitch), so pitch stays precise near +/-90 degrees
+void BNO085Fixed::euler(const BNO085Quat &q, int16_t &roll, int16_t &pitch, int16_t &yaw)
+{
+	int32_t w = q.real;
+	int32_t x = q.i;
+	int32_t y = q.j;
+	int32_t z = q.k;
+
+	int32_t sinRoll = 2 * (w * x + y * z); //Both times cos(pitch)
+	int32_t cosRoll = w * w - x * x - y * y + z * z;
+	roll = atan2(sinRoll, cosRoll);
+	yaw = atan2(2 * (w * z + x * y), w * w + x * x - y * y - z * z);
+
+	int32_t sinRollQ14 = (sinRoll + (1L << 13)) >> 14;
+	int32_t cosRollQ14 = (cosRoll + (1L << 13)) >> 14;
+	int32_t cosPitch = sqrt((uint32_t)(sinRollQ14 * sinRollQ14) + (uint32_t)(cosRollQ14 * cosRollQ14)); //Q14
+	pitch = atan2(2 * (w * y - z * x), cosPitch << 14);
+}
+
+int16_t BNO085Fixed::heading(const BNO085Quat &q)
+{
+	int32_t w = q.real;
+	int32_t x = q.i;
+	int32_t y = q.j;
+	int32_t z = q.k;
+	return (atan2(2 * (w * z + x * y), w * w + x * x - y * y - z * z));
+}
+
+int16_t BNO085Fixed::toCentidegrees(int16_t angle)
+{
+	return ((int16_t)(((int32_t)angle * 18000 + (1L << 14)) >> 15));
+}
+
+//CORDIC in vectoring mode: rotate (x, y) onto the x axis by steps of atan(2^-n), adding up the steps
+int16_t BNO085Fixed::atan2(int32_t y, int32_t x)
+{
+	if (x == 0 && y == 0)
+		return (0);
+
+	//Scale so the largest is between 2^27 and 2^28. Big enough to be precise and small enough that
+	//the CORDIC gain of 1.65 does not overflow.
+	while (x >= (1L << 28) || x <= -(1L << 28) || y >= (1L << 28) || y <= -(1L << 28))
+	{
+		x >>= 1;
+		y >>= 1;
+	}
+	while (x < (1L << 27) && x > -(1L << 27) && y < (1L << 27) && y > -(1L << 27))
+	{
+		x <<= 1;
+		y <<= 1;
+	}
+
+	//Turn into the right half plane first
+	int32_t angle = 0;
+	if (x < 0)
+	{
+		int32_t oldX = x;
+		if (y >= 0)
+		{
+			x = y;
+			y = -oldX;
+			angle = BNO085_CORDIC_90;
+		}
+		else
+		{
+			x = -y;
+			y = oldX;
+			angle = -BNO085_CORDIC_90;
+		}
+	}
+
+	for (uint8_t n = 0; n < 18; n++)
+	{
+		int32_t stepX = y >> n;
+		int32_t stepY = x >> n;
+		int32_t stepAngle = pgm_read_dword(&cordicAngles[n]);
+		if (y > 0)
+		{
+			x += stepX;
+			y -= stepY;
+			angle += stepAngle;
+		}
+		else
+		{
+			x -= stepX;
+			y += stepY;
+			angle -= stepAngle;
+		}
+	}
+
+	return ((int16_t)((angle + 8) >> 4));
+}
+
+uint16_t BNO085Fixed::sqrt(uint32_t value)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+	while (bit > value)
+		bit >>= 2;
+
+	while (bit != 0)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+		bit >>= 2;
+	}
+	return ((uint16_t)root);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//Multiple devices
+
+//Add a device that has been started with begin() or beginSPI()
+//Its samples are queued in queue until readSample() merges them. This replaces any sample queue it had.
+//If it has an INT pin it is read when INT is low. Call its markInterrupt() from an interrupt as well
+//to have the latency measured from the edge. Devices with no INT pin are read about every setPollInterval().
+uint8_t BNO085Manager::addDevice(BNO085 &device, BNO085Sample *queue, uint8_t queueSize)
+{
+	if (_deviceCount >= BNO085_MAX_DEVICES)
+		return (255);
+
+	device.enableSampleQueue(queue, queueSize);
+	Device &entry = _devices[_deviceCount];
+	entry.imu = &device;
+	entry.ready = false;
+	entry.started = false;
+	entry.readySince = 0;
+	entry.lastPoll = micros();
+	entry.pollWait = 0; //Look at it straight away
+	memset(&entry.stats, 0, sizeof(entry.stats));
+	return (_deviceCount++);
+}
+
+BNO085 *BNO085Manager::getDevice(uint8_t index)
+{
+	if (index >= _deviceCount)
+		return (NULL);
+	return (_devices[index].imu);
+}
+
+void BNO085Manager::setPollInterval(unsigned long pollMicros)
+{
+	_pollInterval = pollMicros;
+}
+
+//A sample is handed out once every device has a newer one queued, or once it is this old
+//Set it to more than the longest a packet can take to be read, including batching
+void BNO085Manager::setMergeDelay(unsigned long delayMicros)
+{
+	_mergeDelay = delayMicros;
+}
+
+//How long to leave a device with no INT pin before reading it again
+//Anywhere from half to one and a half poll intervals, so the reads don't lock on to the report
+//rate. Reports would otherwise always wait about as long, and BNO085Synchronizer needs some that don't.
+unsigned long BNO085Manager::nextPollWait()
+{
+	_pollSeed = _pollSeed * 1103515245 + 12345;
+	return (_pollInterval / 2 + (_pollSeed >> 8) % (_pollInterval + 1));
+}
+
+//Returns true if the device needs a transaction, and notes when it started to
+bool BNO085Manager::deviceReady(Device &device, unsigned long now)
+{
+	BNO085 *imu = device.imu;
+	if (device.ready)
+		return (true); //Part way through a packet, or still waiting to start one
+
+	if (imu->_rxState != SHTP_RX_IDLE)
+		device.readySince = now;
+	else if (imu->_int != 255)
+	{
+		if (imu->_intPending)
+			device.readySince = imu->_intMicros; //Measure from the edge
+		else if (digitalRead(imu->_int) == LOW)
+			device.readySince = now;
+		else
+			return (false);
+	}
+	else
+	{
+		if (now - device.lastPoll < device.pollWait)
+			return (false);
+		device.readySince = device.lastPoll + device.pollWait;
+	}
+
+	device.ready = true;
+	device.started = false;
+	return (true);
+}
+
+//Do one bus transaction for whichever device has been ready longest
+//Call this as often as you can. It never waits for a device.
+uint8_t BNO085Manager::update()
+{
+	unsigned long now = micros();
+	uint8_t chosen = 255;
+	unsigned long longestWait = 0;
+	for (uint8_t x = 0; x < _deviceCount; x++)
+	{
+		if (deviceReady(_devices[x], now) == false)
+			continue;
+		unsigned long waited = now - _devices[x].readySince;
+		if (chosen == 255 || waited > longestWait)
+		{
+			chosen = x;
+			longestWait = waited;
+		}
+	}
+	if (chosen == 255)
+		return (255);
+
+	Device &device = _devices[chosen];
+	BNO085 *imu = device.imu;
+	if (device.started == false)
+	{
+		device.started = true;
+		if (longestWait > device.stats.maxWaitMicros)
+			device.stats.maxWaitMicros = longestWait;
+	}
+
+	uint8_t state = imu->_rxState;
+	imu->poll();
+	device.stats.transactions++;
+
+	if (state == SHTP_RX_DISPATCH)
+	{
+		//A whole packet has been parsed
+		unsigned long latency = micros() - device.readySince;
+		device.stats.packets++;
+		device.stats.totalLatencyMicros += latency;
+		if (latency > device.stats.maxLatencyMicros)
+			device.stats.maxLatencyMicros = latency;
+	}
+	if (imu->_rxState == SHTP_RX_IDLE)
+	{
+		//Done with this packet, or there was nothing to read after all
+		device.ready = false;
+		device.lastPoll = now;
+		device.pollWait = nextPollWait();
+		if (state == SHTP_RX_DISPATCH && imu->_int == 255)
+			device.pollWait = 0; //No INT pin to say so, but there may be more waiting
+	}
+	return (chosen);
+}
+
+//Copy the oldest sample from any device into sample, and which device it came from into device
+//Devices are compared by timeMicros. A sample is only handed out once every device has one queued,
+//so nothing older can still turn up, or once it is older than setMergeDelay().
+bool BNO085Manager::readSample(BNO085Sample &sample, uint8_t &device)
+{
+	uint8_t oldest = 255;
+	uint32_t oldestTime = 0;
+	bool allQueued = true;
+	for (uint8_t x = 0; x < _deviceCount; x++)
+	{
+		BNO085Sample head;
+		if (_devices[x].imu->peekSample(head) == false)
+		{
+			allQueued = false;
+			continue;
+		}
+		//Compare the low 32 bits, so devices started either side of a micros() rollover still agree
+		uint32_t headTime = (uint32_t)head.timeMicros;
+		if (oldest == 255 || (int32_t)(headTime - oldestTime) < 0)
+		{
+			oldest = x;
+			oldestTime = headTime;
+		}
+	}
+	if (oldest == 255)
+		return (false);
+	if (allQueued == false && (int32_t)((uint32_t)micros() - oldestTime) < (int32_t)_mergeDelay)
+		return (false); //Another device may still have an older one on its way
+
+	_devices[oldest].imu->readSample(sample);
+	_devices[oldest].stats.samples++;
+	device = oldest;
+	return (true);
+}
+
+BNO085DeviceStats BNO085Manager::getStats(uint8_t device)
+{
+	BNO085DeviceStats stats = {};
+	if (device < _deviceCount)
+		stats = _devices[device].stats;
+	return (stats);
+}
+
+void BNO085Manager::clearStats()
+{
+	for (uint8_t x = 0; x < _deviceCount; x++)
+		memset(&_devices[x].stats, 0, sizeof(_devices[x].stats));
+}
+
+//Aligning devices
+
+//Align reportID, running every reportMicros on each device, across all devices of manager
+//Enable it on every device first. The gyro-integrated rotation vector can't be aligned as it has no
+//report count. This reads the devices' sample queues itself, so don't call the manager's readSample()
+//too. Samples of other reports are dropped, use a report callback for those.
+//With reportMicros 0 each device's hub is taken at the interval it confirmed, as it may have rounded the request.
+void BNO085Synchronizer::begin(BNO085Manager &manager, uint8_t reportID, unsigned long reportMicros)
+{
+	_manager = &manager;
+	_reportID = reportID;
+
+	for (uint8_t x = 0; x < manager.getDeviceCount(); x++)
+	{
+		uint32_t interval = reportMicros;
+		if (interval == 0)
+			interval = manager.getDevice(x)->getReportInterval(reportID);
+		_channels[x].reportMicros = (interval > 0) ? interval : 1;
+	}
+
+	_quaternion = false;
+	BNO085 *first = manager.getDevice(0);
+	BNO085ReportDescriptor descriptor;
+	if (first != NULL && first->getReportDescriptor(reportID, descriptor))
+		_quaternion = (descriptor.store == BNO085_STORE_QUAT);
+	reset();
+}
+
+//readAligned() gives a set every intervalMicros. Each device's report is interpolated between the
+//two either side of the set's time, or with interpolate false the nearer one is used as it is.
+void BNO085Synchronizer::setOutputInterval(unsigned long intervalMicros, bool interpolate)
+{
+	_outputInterval = (intervalMicros > 0) ? intervalMicros : 1;
+	_interpolate = interpolate;
+}
+
+//A set is handed out once every device has a report after its time, or once it is this old.
+//A device that had none is given reportID 0. Set it to more than the longest a packet can take to be read.
+void BNO085Synchronizer::setMaxDelay(unsigned long delayMicros)
+{
+	_maxDelay = delayMicros;
+}
+
+uint8_t BNO085Synchronizer::update()
+{
+	if (_manager == NULL)
+		return (255);
+	return (_manager->update());
+}
+
+//Forget the clock estimates and start the sets again, for example after a device resets
+void BNO085Synchronizer::reset()
+{
+	for (uint8_t x = 0; x < BNO085_MAX_DEVICES; x++)
+	{
+		Channel &channel = _channels[x];
+		channel.clock.reset();
+		channel.started = false;
+		channel.havePrevious = false;
+		channel.maxCorrection = 0;
+	}
+	_ticking = false;
+}
+
+//Look at the device's next report, and work out its hub time and aligned time without using it up
+//Other reports and repeats are dropped on the way. Returns false if there is none queued.
+bool BNO085Synchronizer::peekNext(uint8_t device, BNO085Sample &sample, uint64_t &hubMicros, uint32_t &time)
+{
+	BNO085 *imu = _manager->getDevice(device);
+	Channel &channel = _channels[device];
+	while (imu->peekSample(sample))
+	{
+		if (sample.reportID != _reportID)
+		{
+			imu->readSample(sample);
+			continue;
+		}
+		if (channel.started == false)
+		{
+			hubMicros = 0;
+			time = (uint32_t)sample.timeMicros;
+			return (true);
+		}
+
+		if (sample.sequence == channel.sequence)
+		{
+			imu->readSample(sample); //Sent twice
+			continue;
+		}
+
+		int32_t elapsed = (int32_t)((uint32_t)sample.timeMicros - channel.lastMicros);
+		uint32_t count = reportsSince(sample.sequence, channel.sequence, elapsed, channel.reportMicros);
+		hubMicros = channel.hubMicros + (uint64_t)count * channel.reportMicros;
+		time = (uint32_t)channel.clock.hubToHostMicros(hubMicros);
+		return (true);
+	}
+	return (false);
+}
+
+//Use up the device's next report, adding it to the clock estimate
+void BNO085Synchronizer::takeNext(uint8_t device)
+{
+	Channel &channel = _channels[device];
+	BNO085Sample sample;
+	uint64_t hubMicros;
+	uint32_t time;
+	if (peekNext(device, sample, hubMicros, time) == false)
+		return;
+	_manager->getDevice(device)->readSample(sample);
+
+	channel.clock.update(hubMicros, sample.timeMicros);
+	channel.hubMicros = hubMicros;
+	channel.lastMicros = (uint32_t)sample.timeMicros;
+	channel.sequence = sample.sequence;
+	channel.started = true;
+
+	time = (uint32_t)channel.clock.hubToHostMicros(hubMicros);
+	int32_t correction = (int32_t)(channel.lastMicros - time);
+	if (correction < 0)
+		correction = -correction;
+	if ((uint32_t)correction > channel.maxCorrection)
+		channel.maxCorrection = correction;
+
+	channel.previous = sample;
+	channel.previousTime = time;
+	channel.havePrevious = true;
+}
+
+//Copy the device's report for the next set into sample
+void BNO085Synchronizer::fillSample(uint8_t device, BNO085Sample &sample)
+{
+	Channel &channel = _channels[device];
+	BNO085Sample next;
+	uint64_t hubMicros;
+	uint32_t nextTime;
+	if (channel.havePrevious == false || peekNext(device, next, hubMicros, nextTime) == false)
+	{
+		memset(&sample, 0, sizeof(sample)); //Nothing from this device
+		sample.timeMicros = _tick;
+		return;
+	}
+
+	const BNO085Sample &previous = channel.previous;
+	int32_t span = (int32_t)(nextTime - channel.previousTime);
+	if (span <= 0)
+	{
+		//Two reports for the same moment, or out of order. There is nothing to go between.
+		sample = previous;
+		sample.timeMicros = _tick;
+		return;
+	}
+	float fraction = (float)(int32_t)((uint32_t)_tick - channel.previousTime) / (float)span;
+	sample = (fraction < 0.5) ? previous : next;
+	sample.timeMicros = _tick;
+	if (_interpolate == false)
+		return;
+
+	//q and -q are the same rotation. Go the short way round.
+	int32_t sign = 1;
+	if (_quaternion)
+	{
+		int32_t dot = 0;
+		for (uint8_t x = 0; x < 4; x++)
+			dot += (int32_t)previous.data[x] * next.data[x];
+		if (dot < 0)
+			sign = -1;
+	}
+	for (uint8_t x = 0; x < BNO085_SAMPLE_WORDS; x++)
+	{
+		int32_t from = previous.data[x];
+		int32_t to = next.data[x];
+		if (x < 4)
+			to *= sign;
+		sample.data[x] = (int16_t)(from + (int32_t)floorf(fraction * (float)(to - from) + 0.5));
+	}
+}
+
+//Fill samples, one per device, with each device's report for the same moment
+//Each has timeMicros set to that moment. Returns false until a set is ready.
+bool BNO085Synchronizer::readAligned(BNO085Sample *samples)
+{
+	if (_manager == NULL || _manager->getDeviceCount() == 0)
+		return (false);
+	uint8_t count = _manager->getDeviceCount();
+	BNO085Sample sample;
+	uint64_t hubMicros;
+	uint32_t time;
+
+	if (_ticking == false)
+	{
+		//Start after the latest first report, once every device has one
+		uint8_t latest = 255;
+		for (uint8_t x = 0; x < count; x++)
+		{
+			while (peekNext(x, sample, hubMicros, time))
+				takeNext(x);
+			if (_channels[x].havePrevious == false)
+				return (false);
+			if (latest == 255 || (int32_t)(_channels[x].previousTime - _channels[latest].previousTime) > 0)
+				latest = x;
+		}
+		uint32_t start = _channels[latest].previousTime;
+		start += _outputInterval - start % _outputInterval; //On a multiple of the interval
+		uint64_t firstMicros = _channels[0].previous.timeMicros;
+		_tick = firstMicros + (int32_t)(start - (uint32_t)firstMicros);
+		_ticking = true;
+	}
+
+	uint32_t tick = (uint32_t)_tick;
+	bool ready = true;
+	for (uint8_t x = 0; x < count; x++)
+	{
+		bool queued;
+		while ((queued = peekNext(x, sample, hubMicros, time)) && (int32_t)(time - tick) <= 0)
+			takeNext(x);
+		if (queued == false)
+			ready = false;
+	}
+	if (ready == false && (int32_t)((uint32_t)micros() - tick) < (int32_t)_maxDelay)
+		return (false); //A report for this moment may still be on its way
+
+	for (uint8_t x = 0; x < count; x++)
+		fillSample(x, samples[x]);
+	_tick += _outputInterval;
+	return (true);
+}
+
+float BNO085Synchronizer::getClockDrift(uint8_t device)
+{
+	if (device >= BNO085_MAX_DEVICES)
+		return (0);
+	return (_channels[device].clock.getDrift());
+}
+
+uint32_t BNO085Synchronizer::getMaxCorrection(uint8_t device)
+{
+	if (device >= BNO085_MAX_DEVICES)
+		return (0);
+	return (_channels[device].maxCorrection);
+}
@@ -25,8 +25,33 @@
 #pragma once
 
 #include <Arduino.h>
+
+//Both I2C and SPI are built in by default. If your board only ever uses one of them, add
+//-DBNO085_NO_SPI or -DBNO085_NO_I2C to your build flags to leave the other out. This saves the
+//flash for its code, the RAM for its state and the check of which one is in use on every packet.
+//It must be a build flag (not a #define in your sketch) so the library is compiled the same way.
+#if defined(BNO085_NO_I2C) && defined(BNO085_NO_SPI)
+#error "BNO085: BNO085_NO_I2C and BNO085_NO_SPI leave no way to talk to the sensor"
+#endif
+
+#ifndef BNO085_NO_I2C
 #include <Wire.h>
+#endif
+#ifndef BNO085_NO_SPI
 #include <SPI.h>
+#endif
+
+//The flags change the layout of the BNO085 class, so the sketch and the library must agree on them.
+//The library defines one of these and every BNO085 refers to the one its own flags pick. A sketch
+//built with other flags fails to link, naming the transports it expected, instead of misbehaving.
+#if defined(BNO085_NO_I2C)
+#define BNO085_TRANSPORTS BNO085_library_built_with_SPI_only
+#elif defined(BNO085_NO_SPI)
+#define BNO085_TRANSPORTS BNO085_library_built_with_I2C_only
+#else
+#define BNO085_TRANSPORTS BNO085_library_built_with_I2C_and_SPI
+#endif
+extern const uint8_t BNO085_TRANSPORTS;
 
 //The default I2C address for the BNO085 is 0x4A. 0x4B is also possible.
 #define BNO085_DEFAULT_ADDRESS 0x4A
@@ -40,7 +65,28 @@
 //I2C_BUFFER_LENGTH is defined in Wire.H
 #define I2C_BUFFER_LENGTH BUFFER_LENGTH
 
-#else
+#elif defined(ARDUINO_ARCH_ESP32)
+
+//I2C_BUFFER_LENGTH is defined in Wire.H (128 bytes)
+
+#elif defined(ARDUINO_ARCH_ESP8266) || (defined(TEENSYDUINO) && defined(BUFFER_LENGTH))
+
+//BUFFER_LENGTH is defined in Wire.H (128 bytes on ESP8266, 136 bytes on Teensy 4)
+#define I2C_BUFFER_LENGTH BUFFER_LENGTH
+
+#elif defined(ARDUINO_ARCH_RP2040) && defined(WIRE_BUFFER_SIZE)
+
+//WIRE_BUFFER_SIZE is defined in Wire.H (256 bytes on the Earle Philhower core)
+#define I2C_BUFFER_LENGTH WIRE_BUFFER_SIZE
+
+#elif defined(__SAMD21G18A__)
+
+//SAMD21 uses RingBuffer.h
+#define I2C_BUFFER_LENGTH SERIAL_BUFFER_SIZE
+
+#endif
+
+#ifndef I2C_BUFFER_LENGTH
 
 //The catch-all default is 32
 #define I2C_BUFFER_LENGTH 32
@@ -55,17 +101,44 @@ const byte CHANNEL_CONTROL = 2;
 const byte CHANNEL_REPORTS = 3;
 const byte CHANNEL_WAKE_REPORTS = 4;
 const byte CHANNEL_GYRO = 5;
+#define BNO085_CHANNEL_COUNT 6 //The channels above. The hub's advertisement says which number each really has on the bus.
+#define BNO085_NO_CHANNEL 255
+
+//SHTP advertisement, see 5.2 of the SHTP reference manual
+//The hub sends it on channel 0 after every reset: a 0 then tag, length, value records for each application
+#define SHTP_ADVERTISEMENT 0
+#define SHTP_TAG_GUID 1				 //Starts an application
+#define SHTP_TAG_MAX_CARGO_WRITE 2	 //Largest transfer the hub takes, header included
+#define SHTP_TAG_MAX_CARGO_READ 3	 //Largest transfer the hub sends, header included
+#define SHTP_TAG_MAX_TRANSFER_WRITE 4 //Largest single write, header included
+#define SHTP_TAG_MAX_TRANSFER_READ 5  //Largest single read, header included
+#define SHTP_TAG_NORMAL_CHANNEL 6
+#define SHTP_TAG_WAKE_CHANNEL 7
+#define SHTP_TAG_APP_NAME 8
+#define SHTP_TAG_CHANNEL_NAME 9		 //Names the channel before it
+
+//Longest read, header included, before the advertisement says how much the hub sends at once
+//The advertisement itself comes in continuations of this size
+#define SHTP_FIRST_TRANSFER_READ 32
+
+//How many advertised channels are kept, see getChannel()
+#define BNO085_MAX_CHANNELS 8
 
 //All the ways we can configure or talk to the BNO085, figure 34, page 36 reference manual
 //These are used for low level communication with the sensor, on channel 2
+#define SHTP_REPORT_FLUSH_COMPLETED 0xEF
+#define SHTP_REPORT_FORCE_SENSOR_FLUSH 0xF0
 #define SHTP_REPORT_COMMAND_RESPONSE 0xF1
 #define SHTP_REPORT_COMMAND_REQUEST 0xF2
 #define SHTP_REPORT_FRS_READ_RESPONSE 0xF3
 #define SHTP_REPORT_FRS_READ_REQUEST 0xF4
 #define SHTP_REPORT_PRODUCT_ID_RESPONSE 0xF8
 #define SHTP_REPORT_PRODUCT_ID_REQUEST 0xF9
+#define SHTP_REPORT_TIMESTAMP_REBASE 0xFA
 #define SHTP_REPORT_BASE_TIMESTAMP 0xFB
 #define SHTP_REPORT_SET_FEATURE_COMMAND 0xFD
+#define SHTP_REPORT_GET_FEATURE_REQUEST 0xFE
+#define SHTP_REPORT_GET_FEATURE_RESPONSE 0xFC
 
 //All the different sensors and features we can get reports from
 //These are used when enabling a given sensor
@@ -75,15 +148,20 @@ const byte CHANNEL_GYRO = 5;
 #define SENSOR_REPORTID_LINEAR_ACCELERATION 0x04
 #define SENSOR_REPORTID_ROTATION_VECTOR 0x05
 #define SENSOR_REPORTID_GRAVITY 0x06
+#define SENSOR_REPORTID_UNCALIBRATED_GYRO 0x07
 #define SENSOR_REPORTID_GAME_ROTATION_VECTOR 0x08
 #define SENSOR_REPORTID_GEOMAGNETIC_ROTATION_VECTOR 0x09
 #define SENSOR_REPORTID_GYRO_INTEGRATED_ROTATION_VECTOR 0x2A
+#define SENSOR_REPORTID_UNCALIBRATED_MAGNETIC_FIELD 0x0F
 #define SENSOR_REPORTID_TAP_DETECTOR 0x10
 #define SENSOR_REPORTID_STEP_COUNTER 0x11
+#define SENSOR_REPORTID_SIGNIFICANT_MOTION 0x12
 #define SENSOR_REPORTID_STABILITY_CLASSIFIER 0x13
 #define SENSOR_REPORTID_RAW_ACCELEROMETER 0x14
 #define SENSOR_REPORTID_RAW_GYROSCOPE 0x15
 #define SENSOR_REPORTID_RAW_MAGNETOMETER 0x16
+#define SENSOR_REPORTID_SHAKE_DETECTOR 0x19
+#define SENSOR_REPORTID_STABILITY_DETECTOR 0x1C
 #define SENSOR_REPORTID_PERSONAL_ACTIVITY_CLASSIFIER 0x1E
 #define SENSOR_REPORTID_AR_VR_STABILIZED_ROTATION_VECTOR 0x28
 #define SENSOR_REPORTID_AR_VR_STABILIZED_GAME_ROTATION_VECTOR 0x29
@@ -114,6 +192,27 @@ const byte CHANNEL_GYRO = 5;
 #define CALIBRATE_ACCEL_GYRO_MAG 4
 #define CALIBRATE_STOP 5
 
+//Bits returned by getShakeDetector()
+#define SHAKE_X 0x01
+#define SHAKE_Y 0x02
+#define SHAKE_Z 0x04
+
+//Bits returned by getStabilityDetector()
+#define STABILITY_ENTERED 0x01
+#define STABILITY_EXITED 0x02
+
+//Feature flags of a report, see setChangeSensitivity(), setWakeUp() and setAlwaysOn()
+#define FEATURE_CHANGE_RELATIVE 0x01 //The change sensitivity is relative, not absolute
+#define FEATURE_CHANGE_ENABLED 0x02	 //Only send a report when its value changed by the change sensitivity
+#define FEATURE_WAKE_UP 0x04		 //Send reports on the wake channel, waking the host
+#define FEATURE_ALWAYS_ON 0x08		 //Keep the sensor running while the hub is asleep
+
+//How many reports can have feature flags or a change sensitivity set at once
+#define BNO085_MAX_REPORT_MODES 4
+
+//How many sensors' configurations, as confirmed by the hub, are kept at once
+#define BNO085_MAX_FEATURES 8
+
 #define TARE_ALL 7
 #define TARE_Z 4
 #define TARE_ROTATION_VECTOR 0
@@ -124,53 +223,351 @@ const byte CHANNEL_GYRO = 5;
 #define TARE_ARVR_STABILIZED_GAME_ROTATION_VECTOR 5
 
 #define MAX_PACKET_SIZE 128 //Packets can be up to 32k but we don't have that much RAM.
+#define MAX_REPORT_SIZE 16 //Largest single sensor report we parse. Reports are parsed one at a time as they arrive.
 #define MAX_METADATA_SIZE 9 //This is in words. There can be many but we mostly only care about the first 9 (Qs, range, etc)
 
+//Steps of the advertisement parser, see advertisementByte()
+#define SHTP_ADV_OFF 0	  //Not in an advertisement
+#define SHTP_ADV_START 1  //Waiting for the first cargo byte
+#define SHTP_ADV_TAG 2
+#define SHTP_ADV_LENGTH 3
+#define SHTP_ADV_VALUE 4
+
+//Steps of the non-blocking receive, see poll()
+#define SHTP_RX_IDLE 0	   //Waiting for the BNO085 to have data
+#define SHTP_RX_HEADER 1   //Reading the packet header
+#define SHTP_RX_PAYLOAD 2  //Reading the packet payload, one I2C chunk at a time
+#define SHTP_RX_DISPATCH 3 //Packet is complete and ready to be handled
+
+//Binary capture of the SHTP stream, see enableCapture()
+//A capture starts with "SHTP" and BNO085_CAPTURE_VERSION, then has one record per packet or bus read:
+//record type (1 byte), micros() (4 bytes), SHTP header (4 bytes), packet read length (2 bytes),
+//payload length (2 bytes), payload. Multi-byte values are little endian. Header channels are CHANNEL_x,
+//not the hub's own numbers, so a replay doesn't depend on the layout it advertised.
+//The packet read length is how many payload bytes were read for the whole packet. Over I2C a packet
+//can take several reads, each with its own header: the first is a RECEIVED record, the rest CHUNK records.
+#define BNO085_CAPTURE_VERSION 1
+#define BNO085_CAPTURE_RECEIVED 'R' //The start of a packet read from the BNO085
+#define BNO085_CAPTURE_CHUNK 'C'	//A further I2C read of the same packet
+#define BNO085_CAPTURE_SENT 'T'		//A packet sent to the BNO085
+#define BNO085_CAPTURE_RECORD_SIZE 13 //Bytes before the payload
+
+//The hub clock estimate keeps the best reading from each window this long, in hub microseconds
+//See hubToHostMicros(). Longer windows filter out more read delay but follow drift changes slower.
+#define BNO085_CLOCK_WINDOW 1000000
+//The drift is a line fitted through the best readings of about this many of the latest windows
+#define BNO085_CLOCK_WINDOWS 32
+
+//Tracks a hub clock against micros(), from readings of both clocks taken at the same moment
+//BNO085 keeps one for the raw reports' timestamps, BNO085Synchronizer one per device
+class BNO085ClockEstimate
+{
+public:
+	void update(uint64_t hubMicros, uint64_t hostMicros); //hostMicros can be late, but never early
+	uint64_t hubToHostMicros(uint64_t hubMicros);		   //Returns hubMicros unchanged until the first update()
+	float getDrift() { return (_drift * 1000000.0f); }	   //How much faster micros() runs, in ppm
+	uint32_t getReadings() { return (_samples); }
+	void reset();
+
+private:
+	//host = hub + _offsetBase + _offset + drift since _lastHub
+	uint32_t _samples = 0;
+	uint64_t _lastHub = 0;	   //Hub time the offset was measured at
+	int64_t _offsetBase = 0;   //micros() less hub time at the first reading
+	float _offset = 0;		   //Microseconds, on top of _offsetBase
+	float _drift = 0;		   //micros() gained per hub microsecond
+	uint64_t _windowStart = 0; //Hub time the current window started
+	float _windowMin = 0;	   //Smallest offset in the window so far, as if at the window start
+	uint64_t _windowMinHub = 0;
+	//Least squares line through the best reading of each window, older windows weighted less
+	float _fitWeight = 0;	   //0 until the first window is over
+	float _fitHub = 0;		   //Mean hub time, relative to _lastHub
+	float _fitOffset = 0;	   //Mean offset
+	float _fitHubHub = 0;	   //Sums of squares about the means
+	float _fitHubOffset = 0;
+	float _spread = 0; //Usual distance of a window's best reading from the line
+};
+
+//A sensor's configuration as the hub reports it in a Get Feature Response
+//The hub rounds the requested intervals to the rates the sensor supports, so these can differ from what was asked for
+struct BNO085Feature
+{
+	uint8_t reportID;
+	uint8_t flags;			 //FEATURE_x bits
+	uint16_t sensitivity;	 //Change sensitivity
+	uint32_t interval;		 //Microseconds between reports, 0 when the sensor is off
+	uint32_t batchInterval;	 //Longest the hub holds a report in its FIFO, in microseconds
+	uint32_t specificConfig; //Sensor-specific config word
+};
+
+//A channel from the hub's advertisement
+struct BNO085Channel
+{
+	uint32_t guid;	//Application it belongs to: 0 SHTP, 1 executable, 2 sensor hub
+	uint8_t number; //Channel number on the bus
+	uint8_t role;	//The CHANNEL_x the library uses it as, BNO085_NO_CHANNEL if none
+	bool wake;		//Reports on it wake the host
+};
+
+//Limits from the hub's advertisement, header included. 0 if not advertised.
+struct BNO085Advertisement
+{
+	uint16_t maxCargoWrite;	   //Largest transfer the hub takes from the host
+	uint16_t maxCargoRead;	   //Largest transfer the hub sends
+	uint16_t maxTransferWrite; //Largest single write
+	uint16_t maxTransferRead;  //Largest single read. The hub pads longer ones.
+	uint8_t channelCount;	   //Channels kept, see getChannel()
+};
+
+//A decoded sensor report, as stored in the sample queue
+//data holds the raw 16-bit fields of the report in order (accel x/y/z, quat i/j/k/real/accuracy, etc)
+//Apply the report's Q point to convert them, see qToFloat()
+#define BNO085_SAMPLE_WORDS 7 //Gyro-integrated rotation vector is the largest with 7 fields
+struct BNO085Sample
+{
+	uint8_t reportID;
+	uint8_t status;	  //Accuracy bits
+	uint8_t sequence; //The hub counts each report ID's reports, rolling over at 256
+	uint32_t timeStamp;	  //Base timestamp of the packet, as sent by the hub
+	uint64_t timeMicros; //When the sample was taken, in micros() time. See getTimeStampMicros().
+	int16_t data[BNO085_SAMPLE_WORDS];
+};
+
+//Every sample of one report, oldest first, see enableHistory()
+//Declare a BNO085SampleHistory<size> rather than using this directly
+//Like the sample queue it is safe to read in loop() while an interrupt fills it. On 8-bit boards
+//the indexes are not read atomically, so keep the size under 256 if the BNO085 is read in an interrupt.
+class BNO085History
+{
+public:
+	BNO085History(BNO085Sample *samples, uint16_t size) : _samples(samples), _size(size) {}
+	bool push(const BNO085Sample &sample); //False if it was full and the sample was dropped
+	uint16_t drain(BNO085Sample *destination, uint16_t maxSamples); //Copy out and remove the oldest samples
+	uint16_t available();
+	uint16_t getSize() { return (_size - 1); } //One slot is kept empty to tell full from empty
+	uint32_t getOverflows() { return (_overflows); }
+	void clear();
+
+private:
+	friend class BNO085;
+	BNO085Sample *_samples;
+	uint16_t _size;
+	volatile uint16_t _head = 0; //Only written by the producer
+	volatile uint16_t _tail = 0; //Only written by the consumer
+	volatile uint32_t _overflows = 0;
+	uint8_t _reportID = 0;
+	BNO085History *_next = NULL; //Histories are kept in a list, there is usually only one or two
+};
+
+//A history with room for historySize samples
+template <uint16_t historySize>
+class BNO085SampleHistory : public BNO085History
+{
+public:
+	BNO085SampleHistory() : BNO085History(_storage, historySize + 1) {}
+
+private:
+	BNO085Sample _storage[historySize + 1];
+};
+
+//Called with every sample of one report ID, see setReportCallback()
+typedef void (*BNO085SampleCallback)(const BNO085Sample &sample);
+
+//What the library knows about a sensor report, see getReportDescriptor()
+//The descriptors are in a table indexed by report ID, so finding one is a single lookup
+#define BNO085_REPORT_ID_COUNT 0x30 //Sensor report IDs go up to 0x2F
+struct BNO085ReportDescriptor
+{
+	uint8_t length;	 //Bytes in the report, including ID, sequence, status and delay. 0 if unknown.
+	uint8_t qPoint;	 //Q point of the first qFields data fields. 0 if they are plain integers.
+	uint8_t qFields;
+	uint8_t qPoint2; //Q point of the fields after those, for example the rotation vector accuracy
+	uint8_t store;	 //Which getters the report updates, one of BNO085_STORE_x
+};
+
+//Where parseReport() stores each report for the getters
+#define BNO085_STORE_NONE 0
+#define BNO085_STORE_ACCEL 1
+#define BNO085_STORE_LINEAR_ACCEL 2
+#define BNO085_STORE_GYRO 3
+#define BNO085_STORE_MAG 4
+#define BNO085_STORE_QUAT 5
+#define BNO085_STORE_TAP 6
+#define BNO085_STORE_STEP 7
+#define BNO085_STORE_STABILITY 8
+#define BNO085_STORE_ACTIVITY 9
+#define BNO085_STORE_RAW_ACCEL 10
+#define BNO085_STORE_RAW_GYRO 11
+#define BNO085_STORE_RAW_MAG 12
+#define BNO085_STORE_GRAVITY 13
+#define BNO085_STORE_UNCALIBRATED_GYRO 14
+#define BNO085_STORE_UNCALIBRATED_MAG 15
+#define BNO085_STORE_SIGNIFICANT_MOTION 16
+#define BNO085_STORE_SHAKE 17
+#define BNO085_STORE_STABILITY_DETECTOR 18
+
+//Readings as they came from the BNO085, for integer math without an FPU. See BNO085Fixed.
+//Quaternions are Q14 like the rotation vector report: 16384 is 1.0.
+struct BNO085Quat
+{
+	int16_t i;
+	int16_t j;
+	int16_t k;
+	int16_t real;
+};
+
+//Vectors keep the Q point of their report: accel Q8 m/s^2, gyro Q9 rad/s, mag Q4 uT
+struct BNO085Vector
+{
+	int16_t x;
+	int16_t y;
+	int16_t z;
+};
+
+//Packet counts for one channel, see getReceiveStats()
+//The hub numbers the packets on each channel. A jump in the number means packets were lost.
+struct BNO085ReceiveStats
+{
+	uint32_t packets;	 //Packets received
+	uint32_t gaps;		 //Times one or more packets went missing
+	uint32_t lost;		 //Total packets that went missing
+	uint32_t duplicates; //Packets with the same number as the one before
+	uint32_t resets;	 //Times the numbering started again from 0 after the hub reset
+};
+
+//Optional replacement for SPIClass::transfer(buf, count), for example to use DMA
+//Must send length bytes from buffer and overwrite them with the bytes received
+typedef void (*BNO085_SPITransferHook)(uint8_t *buffer, uint16_t length);
+
 class BNO085
 {
 public:
-	bool begin(uint8_t deviceAddress = BNO085_DEFAULT_ADDRESS, TwoWire &wirePort = Wire, uint8_t intPin = 255); //By default use the default I2C addres, and use Wire port, and don't declare an INT pin
+	BNO085() { __asm__ __volatile__("" ::"r"(&BNO085_TRANSPORTS)); } //Only makes the reference, see BNO085_TRANSPORTS
+
+#ifndef BNO085_NO_I2C
+	bool begin(uint8_t deviceAddress = BNO085_DEFAULT_ADDRESS, TwoWire &wirePort = Wire, uint8_t intPin = 255, uint16_t i2cBufferLength = I2C_BUFFER_LENGTH); //By default use the default I2C addres, and use Wire port, and don't declare an INT pin
+#endif
+#ifndef BNO085_NO_SPI
 	bool beginSPI(uint8_t user_CSPin, uint8_t user_WAKPin, uint8_t user_INTPin, uint8_t user_RSTPin, uint32_t spiPortSpeed = 3000000, SPIClass &spiPort = SPI);
+#endif
 
 	void enableDebugging(Stream &debugPort = Serial); //Turn on debug printing. If user doesn't specify then Serial will be used.
 
+#ifndef BNO085_NO_I2C
+	void setI2CBufferLength(uint16_t i2cBufferLength);  //Size of the Wire receive buffer. Reads are chunked to fit.
+	void setI2CSingleReadLength(uint16_t readLength);	//Read the header and payload in one transaction when the packet fits. 0 to disable.
+	uint32_t getI2CBytesRead();							//Total bytes read over I2C
+	uint32_t getI2CHeaderBytesRead();					//Bytes read over I2C that were packet headers
+	void clearI2CByteCounts();
+#endif
+
 	void softReset();	  //Try to reset the IMU via software
 	uint8_t resetReason(); //Query the IMU for the reason it last reset
 	void modeOn();	  //Use the executable channel to turn the BNO on
 	void modeSleep();	  //Use the executable channel to put the BNO to sleep
 
 	float qToFloat(int16_t fixedPointValue, uint8_t qPoint); //Given a Q value, converts fixed point floating to regular floating point number
+	void qToFloat(const int16_t *fixedPointValues, float *values, uint8_t count, uint8_t qPoint); //Convert count values with the same Q point
+
+	//The same for a Q point known at compile time. The scale is a constant, so this is one multiply.
+	template <uint8_t qPoint>
+	static float qToFloat(int16_t fixedPointValue)
+	{
+		static_assert(qPoint < 32, "Q point out of range");
+		return (fixedPointValue * (1.0f / (float)(1UL << qPoint)));
+	}
 
+#ifndef BNO085_NO_I2C
 	bool waitForI2C(); //Delay based polling for I2C traffic
+	bool getData(uint16_t bytesRemaining, uint16_t dataSpot = 0); //Given a number of bytes, send the requests in I2C buffer length chunks
+#endif
+#ifndef BNO085_NO_SPI
 	bool waitForSPI(); //Delay based polling for INT pin to go low
+	void setSPITransferHook(BNO085_SPITransferHook transferHook); //Use a custom (e.g. DMA) function for SPI buffer transfers
+#endif
 	bool receivePacket(void);
-	bool getData(uint16_t bytesRemaining); //Given a number of bytes, send the requests in I2C_BUFFER_LENGTH chunks
 	bool sendPacket(uint8_t channelNumber, uint8_t dataLength);
 	void printPacket(void); //Prints the current shtp header and data packets
 	void printHeader(void); //Prints the current shtp header (only)
 
-	void enableRotationVector(long microsBetweenReports);
-	void enableGameRotationVector(long microsBetweenReports);
-	void enableARVRStabilizedRotationVector(long microsBetweenReports);
-	void enableARVRStabilizedGameRotationVector(long microsBetweenReports);
-	void enableAccelerometer(long microsBetweenReports);
-	void enableLinearAccelerometer(long microsBetweenReports);
-	void enableGyro(long microsBetweenReports);
-	void enableMagnetometer(long microsBetweenReports);
-	void enableTapDetector(long microsBetweenReports);
-	void enableStepCounter(long microsBetweenReports);
-	void enableStabilityClassifier(long microsBetweenReports);
-	void enableActivityClassifier(long microsBetweenReports, uint32_t activitiesToEnable, uint8_t (&activityConfidences)[9]);
-	void enableRawAccelerometer(long microsBetweenReports);
-	void enableRawGyro(long microsBetweenReports);
-	void enableRawMagnetometer(long microsBetweenReports);
-	void enableGyroIntegratedRotationVector(long microsBetweenReports);
+	//Each waits for the hub's Get Feature Response and returns false if none came. The command is sent either way,
+	//and a response read later by getReadings() or poll() still updates getReportRate().
+	bool enableRotationVector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableGameRotationVector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableARVRStabilizedRotationVector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableARVRStabilizedGameRotationVector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableAccelerometer(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableLinearAccelerometer(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableGyro(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableMagnetometer(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableTapDetector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableStepCounter(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableStabilityClassifier(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableActivityClassifier(long microsBetweenReports, uint32_t activitiesToEnable, uint8_t (&activityConfidences)[9], long microsBetweenBatches = 0);
+	bool enableRawAccelerometer(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableRawGyro(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableRawMagnetometer(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableGyroIntegratedRotationVector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableGeomagneticRotationVector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableGravity(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableUncalibratedGyro(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableUncalibratedMagnetometer(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableSignificantMotion(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableShakeDetector(long microsBetweenReports, long microsBetweenBatches = 0);
+	bool enableStabilityDetector(long microsBetweenReports, long microsBetweenBatches = 0);
 
 	bool dataAvailable(void);
 	uint16_t getReadings(void);
+	uint16_t poll(void);			 //Non-blocking getReadings(). Does at most one bus transaction per call.
+	uint8_t getReceiveState(void); //Current step of the non-blocking receive (SHTP_RX_IDLE, etc)
+
+	void markInterrupt(void);	 //Call from the INT pin interrupt handler. Only records the edge.
+	bool interruptPending(void); //True if an INT edge has been marked since the last packet was read
+	void enableSampleQueue(BNO085Sample *queue, uint8_t queueSize); //Queue every parsed report into this array
+	bool readSample(BNO085Sample &sample);							 //Pop the oldest queued sample. False if empty.
+	bool peekSample(BNO085Sample &sample);							 //The same without removing it
+	uint8_t samplesAvailable(void);
+	uint32_t getSampleQueueOverflows(void); //Samples dropped because the queue was full
+	void enableHistory(uint8_t reportID, BNO085History &history); //Keep every sample of reportID in history
+	void disableHistory(uint8_t reportID);
+	uint16_t drain(uint8_t reportID, BNO085Sample *destination, uint16_t maxSamples); //Copy out the oldest samples of reportID
+	uint16_t historyAvailable(uint8_t reportID);
+	uint32_t getHistoryOverflows(uint8_t reportID); //Samples dropped because the history was full
+	void setReportCallback(uint8_t reportID, BNO085SampleCallback callback); //Call this function with every sample of reportID. NULL to stop.
+	bool getReportDescriptor(uint8_t reportID, BNO085ReportDescriptor &descriptor); //Length, Q points, etc of a report. False if unknown.
+	float getSampleValue(const BNO085Sample &sample, uint8_t field);				 //A data field of a sample with its Q point applied
+	uint8_t getSampleValues(const BNO085Sample &sample, float (&values)[BNO085_SAMPLE_WORDS]); //All the fields of a sample at once
 	uint16_t parseInputReport(void);   //Parse sensor readings out of report
+	uint64_t getUpdatedReports();	  //Bitmask of the report IDs found by the last getReadings()
+	bool reportUpdated(uint8_t reportID); //True if this report ID was found by the last getReadings()
+	uint16_t drainBatch(uint8_t reportID); //Flush the hub's batch FIFO for a sensor and parse every report in it
+
+	void beginStream(uint8_t channelNumber); //Start parsing a new packet payload byte by byte
+	void streamByte(uint8_t incoming);	   //Parse the next payload byte. Reports are decoded as soon as they are complete.
+	void endStream();						   //Finish the packet. Counts any truncated report as skipped.
+	uint32_t getBytesSkipped();			   //Number of received bytes that could not be stored or parsed
+
+	void setMaxReadLength(uint16_t maxReadLength);		   //Read long packets in pieces of this size. 0 for whole packets.
+	void setMaxTransferLength(uint16_t maxTransferLength); //Longer transfers are thrown away instead of reassembled
+	uint32_t getTransfersReassembled();					   //Transfers that came in more than one packet
+	uint32_t getTransfersAbandoned();					   //Transfers that were cut short or thrown away
+
+	//From the advertisement the hub sends after a reset. Reads, writes and channel numbers follow it.
+	bool getAdvertisement(BNO085Advertisement &advertisement); //False if none has been seen
+	bool getChannel(uint8_t index, BNO085Channel &channel);	   //Advertised channels, in the order sent
+	uint8_t getChannelNumber(uint8_t channel);				   //Bus number of CHANNEL_x
+
+	BNO085ReceiveStats getReceiveStats(uint8_t channelNumber); //Sequence number checks for one channel
+	BNO085ReceiveStats getReceiveStats();					   //Sequence number checks for all channels
+	void clearReceiveStats();
 	uint16_t parseCommandReport(void); //Parse command responses out of report
 
+	void enableCapture(Print &capturePort); //Record every packet sent and received to capturePort in binary
+	void disableCapture();
+	void beginReplay(Stream &replayPort, bool realTime = false); //Read packets from a capture instead of the bus
+	void endReplay();
+	bool replayFinished(); //True once everything in the capture has been read
+
 	void getQuat(float &i, float &j, float &k, float &real, float &radAccuracy, uint8_t &accuracy);
 	float getQuatI();
 	float getQuatJ();
@@ -208,6 +605,30 @@ public:
 	float getMagZ();
 	uint8_t getMagAccuracy();
 
+	void getGravity(float &x, float &y, float &z, uint8_t &accuracy);
+	float getGravityX();
+	float getGravityY();
+	float getGravityZ();
+	uint8_t getGravityAccuracy();
+
+	void getUncalibratedGyro(float &x, float &y, float &z, float &biasX, float &biasY, float &biasZ, uint8_t &accuracy);
+	float getUncalibratedGyroX();
+	float getUncalibratedGyroY();
+	float getUncalibratedGyroZ();
+	float getUncalibratedGyroBiasX();
+	float getUncalibratedGyroBiasY();
+	float getUncalibratedGyroBiasZ();
+	uint8_t getUncalibratedGyroAccuracy();
+
+	void getUncalibratedMag(float &x, float &y, float &z, float &biasX, float &biasY, float &biasZ, uint8_t &accuracy);
+	float getUncalibratedMagX();
+	float getUncalibratedMagY();
+	float getUncalibratedMagZ();
+	float getUncalibratedMagBiasX();
+	float getUncalibratedMagBiasY();
+	float getUncalibratedMagBiasZ();
+	uint8_t getUncalibratedMagAccuracy();
+
 	void calibrateAccelerometer();
 	void calibrateGyro();
 	void calibrateMagnetometer();
@@ -222,7 +643,17 @@ public:
 	void tareZAxis(uint8_t basisVector);
 
 	uint8_t getTapDetector();
+	bool getSignificantMotion(); //True once after the hub reports significant motion
+	uint8_t getShakeDetector();	 //SHAKE_x bits of the axes that shook, then 0 until the next shake
+	uint8_t getStabilityDetector(); //STABILITY_ENTERED or STABILITY_EXITED, then 0 until the next change
 	uint32_t getTimeStamp();
+	uint64_t getTimeStampMicros(); //When the last report was sampled, in micros() time extended to 64 bits
+	//Only the raw accel/gyro/mag reports carry the hub's clock, so hubToHostMicros() needs one of them enabled.
+	//getClockDrift() works from any sensor sent every interval, once the hub has confirmed the interval.
+	uint64_t getHubMicros();	   //The hub's own clock from the last raw accel/gyro/mag report, extended to 64 bits
+	uint64_t hubToHostMicros(uint64_t hubMicros); //Convert a hub clock time to micros() time
+	float getClockDrift();						  //How much faster micros() runs than the hub clock, in ppm
+	void resetClockEstimate();
 	uint16_t getStepCount();
 	uint8_t getStabilityClassification();
 	uint8_t getActivityClassification();
@@ -242,9 +673,34 @@ public:
 	float getRoll();
 	float getPitch();
 	float getYaw();
+	void getEuler(float &roll, float &pitch, float &yaw, bool fast = false); //All three from one read of the quaternion
+
+	//The same readings without converting to float. See BNO085Fixed for math on them.
+	void getQuatFixed(BNO085Quat &quat);		   //Q14
+	void getAccelFixed(BNO085Vector &accel);	   //Q8 m/s^2
+	void getLinAccelFixed(BNO085Vector &linAccel); //Q8 m/s^2
+	void getGravityFixed(BNO085Vector &gravity);   //Q8 m/s^2
+	void getGyroFixed(BNO085Vector &gyro);		   //Q9 rad/s
+	void getMagFixed(BNO085Vector &mag);		   //Q4 uT
 
-	void setFeatureCommand(uint8_t reportID, long microsBetweenReports);
-	void setFeatureCommand(uint8_t reportID, long microsBetweenReports, uint32_t specificConfig);
+	//Waits for the hub to confirm the configuration it applied. False if it did not.
+	bool setFeatureCommand(uint8_t reportID, long microsBetweenReports);
+	bool setFeatureCommand(uint8_t reportID, long microsBetweenReports, uint32_t specificConfig, long microsBetweenBatches = 0);
+
+	//Configuration of a sensor as last confirmed by the hub
+	bool requestFeature(uint8_t reportID, BNO085Feature &feature); //Ask the hub, and wait for its answer
+	bool getFeature(uint8_t reportID, BNO085Feature &feature);	   //From the last answer. False if there has not been one.
+	uint32_t getReportInterval(uint8_t reportID);				   //Microseconds between reports the hub is using, 0 if off or unknown
+	float getReportRate(uint8_t reportID);						   //Reports per second the hub is sending, 0 if off or unknown
+
+	//Sent with the next enable of the report. False if BNO085_MAX_REPORT_MODES reports already have some.
+	bool setChangeSensitivity(uint8_t reportID, uint16_t sensitivity, bool relative = false); //0 to report every interval
+	bool setWakeUp(uint8_t reportID, bool enable);
+	bool setAlwaysOn(uint8_t reportID, bool enable);
+	uint8_t getFeatureFlags(uint8_t reportID); //FEATURE_x bits
+	uint32_t getReportsReceived(uint8_t reportID); //Counted for reports set by the calls above
+	uint32_t getSuppressedReports(uint8_t reportID); //Estimate of the intervals the hub sent nothing as nothing changed enough
+	void clearReportCounts();						 //Restarts both counts from now
 	void sendCommand(uint8_t command);
 	void sendCalibrateCommand(uint8_t thingToCalibrate);
 	void sendTareCommand(uint8_t axes, uint8_t basisVector);
@@ -268,19 +724,199 @@ public:
 	uint32_t metaData[MAX_METADATA_SIZE];			//There is more than 10 words in a metadata record but we'll stop at Q point 3
 
 private:
+	friend class BNO085Manager; //Schedules receives from the INT pin and receive state
+
 	//Variables
+#ifndef BNO085_NO_I2C
 	TwoWire *_i2cPort;		//The generic connection to user's chosen I2C hardware
 	uint8_t _deviceAddress; //Keeps track of I2C address. setI2CAddress changes this.
+	uint16_t _i2cBufferLength = I2C_BUFFER_LENGTH; //Max bytes we can read in one I2C transaction
+	uint16_t _i2cSingleReadLength = 0;			   //If non-zero, read the header and payload in one transaction of this size
+	uint32_t _i2cBytesRead = 0;
+	uint32_t _i2cHeaderBytesRead = 0;
+	bool receiveI2CPacket(void);
+	bool sendI2CPacket(uint8_t channelNumber, uint8_t dataLength);
+	bool receiveI2CHeader(bool wait);							  //Read the header and any payload that fits in the same read
+	uint16_t getDataChunk(uint16_t bytesRemaining, uint16_t dataSpot, bool wait); //Read one chunk of payload over I2C
+#endif
 
 	Stream *_debugPort;			 //The stream to send debug messages to if enabled. Usually Serial.
 	bool _printDebug = false; //Flag to print debugging variables
 
+#ifndef BNO085_NO_SPI
 	SPIClass *_spiPort;			 //The generic connection to user's chosen SPI hardware
 	unsigned long _spiPortSpeed; //Optional user defined port speed
 	uint8_t _cs;				 //Pins needed for SPI
 	uint8_t _wake;
-	uint8_t _int;
 	uint8_t _rst;
+	BNO085_SPITransferHook _spiTransferHook = NULL;
+	void spiTransfer(uint8_t *buffer, uint16_t length); //Exchange a buffer of bytes over SPI
+	bool receiveSPIPacket(void);
+	bool sendSPIPacket(uint8_t channelNumber, uint8_t dataLength);
+#endif
+	uint8_t _int;
+
+	//Which transport this object talks over. Known at compile time if only one is built in.
+#if defined(BNO085_NO_I2C)
+	bool usingSPI() { return (true); }
+#elif defined(BNO085_NO_SPI)
+	bool usingSPI() { return (false); }
+#else
+	bool usingSPI() { return (_i2cPort == NULL); }
+#endif
+
+	uint8_t parseReport(uint8_t *report, uint8_t reportLength); //Parse a single report from within a packet
+	bool receiveAnnouncedPacket(void);							  //Read the packet INT says is waiting
+	uint16_t dispatchPacket(void);								  //Handle a fully received packet
+
+	//Sample callbacks, indexed by report ID
+	void deliverSample(uint8_t reportID, uint8_t *report, uint8_t reportLength);
+	BNO085SampleCallback _reportCallbacks[BNO085_REPORT_ID_COUNT] = {};
+	BNO085History *findHistory(uint8_t reportID);
+	BNO085History *_histories = NULL;
+
+	//Feature flags and change sensitivity, for the few reports that have them
+	struct ReportMode
+	{
+		uint8_t reportID;
+		uint8_t flags;
+		uint16_t sensitivity;
+		uint32_t interval;	 //As last enabled, in microseconds
+		uint32_t lastMicros; //When the last report was sampled
+		bool timed;			 //lastMicros is from a report at the current interval
+		uint32_t received;
+		uint32_t suppressed;
+	};
+	ReportMode *findReportMode(uint8_t reportID, bool add);
+	void countReport(uint8_t reportID);
+	uint32_t quietIntervals(const ReportMode &mode, uint32_t now);
+	ReportMode _reportModes[BNO085_MAX_REPORT_MODES];
+	uint8_t _reportModeCount = 0;
+
+	//Sensor configurations from Get Feature Responses
+	bool waitForFeature(uint8_t reportID);
+	void storeFeature(const uint8_t *response);
+	BNO085Feature *findFeature(uint8_t reportID, bool add);
+	BNO085Feature _features[BNO085_MAX_FEATURES];
+	uint8_t _featureCount = 0;
+
+	//Interrupt mode and the lock free sample queue
+	void queueSample(const BNO085Sample &sample);
+	volatile bool _intPending = false;
+	volatile unsigned long _intMicros = 0; //micros() when the last INT edge was marked
+	bool _rxIntMarked = false;			   //The packet being read is the one markInterrupt() saw
+
+	//Report timestamps. The hub gives each report's age relative to when the packet was sent.
+	void markFragmentTime();
+	uint64_t extendMicros(uint32_t now);
+	uint32_t _rxFragmentMicros = 0; //micros() when the packet being read was sent
+	uint64_t _packetMicros = 0;		//The same, extended to 64 bits, for the transfer being parsed
+	uint64_t _baseMicros = 0;		//Base timestamp of the reports being parsed, in 64 bit micros() time
+	uint64_t _reportMicros = 0;		//When the last report was sampled
+	uint64_t _lastMicros = 0;		//Last micros() reading we extended, for rollover tracking
+	bool _lastMicrosValid = false;
+	uint64_t _hubMicros = 0; //Last hub clock reading, with rollovers
+	bool _hubMicrosValid = false;
+
+	BNO085ClockEstimate _clock; //Hub clock to micros(), from the raw reports
+	BNO085ClockEstimate _reportClock; //Hub clock rate, from the report count of one steady sensor
+	void updateReportClock(uint8_t reportID, uint8_t sequence);
+	uint8_t _clockReportID = 0; //The sensor it follows, 0 until one has a confirmed interval
+	uint8_t _clockSequence = 0;
+	uint32_t _clockInterval = 0;
+	uint32_t _clockLastMicros = 0; //Sample time of its last report, low 32 bits
+	uint64_t _clockHubMicros = 0;  //Its reports so far times the interval
+	BNO085Sample *_sampleQueue = NULL;
+	uint8_t _sampleQueueSize = 0;
+	volatile uint8_t _sampleHead = 0; //Only written by the producer
+	volatile uint8_t _sampleTail = 0; //Only written by the consumer
+	volatile uint32_t _sampleQueueOverflows = 0;
+
+	//Continuation packet reassembly
+	uint16_t beginFragment(uint8_t channelNumber, uint16_t packetLength);
+	uint16_t fragmentReadLength(uint16_t cargoLength);
+	void endFragment(uint16_t bytesRead);
+	void abortTransfer();
+	void discardTransfer();
+	uint8_t _rxTransferChannel = 0;
+	uint16_t _rxTransferOffset = 0;	   //Cargo bytes of the transfer received before this packet
+	uint16_t _rxTransferRemaining = 0; //Cargo bytes of the transfer still to come in continuation packets
+	uint16_t _rxFragmentLength = 0;	   //Cargo bytes left in the transfer at the start of this packet
+	bool _rxTransferContinued = false;
+	bool _rxTransferDiscard = false;
+	uint16_t _maxReadLength = 0;
+	uint16_t _maxTransferLength = 0x7FFF;
+	uint32_t _transfersReassembled = 0;
+	uint32_t _transfersAbandoned = 0;
+
+	//Advertisement and channel map
+	void advertisementByte(uint8_t incoming);
+	void advertisementRecord();
+	uint8_t localChannel(uint8_t number); //CHANNEL_x of a bus channel number, BNO085_NO_CHANNEL if unknown
+	uint16_t readLimit(uint16_t length);   //Cargo bytes one read can take
+	BNO085Advertisement _advertisement = {0, 0, 0, 0, 0};
+	bool _advertised = false;
+	BNO085Channel _channels[BNO085_MAX_CHANNELS];
+	uint8_t _channelNumbers[BNO085_CHANNEL_COUNT] = {0, 1, 2, 3, 4, 5}; //Bus number of each CHANNEL_x
+	uint8_t _advState = SHTP_ADV_OFF;
+	uint8_t _advTag = 0;
+	uint8_t _advLength = 0;
+	uint8_t _advIndex = 0;
+	uint8_t _advValue[12];					 //Long enough for the channel names we look for
+	uint8_t _advApplication = 255;			 //Which known application the records are for
+	uint32_t _advGuid = 0;
+	bool _advChannelNamed = true;			 //The last channel has had its name
+
+	//Receive sequence tracking
+	void checkSequence(uint8_t channelNumber, uint8_t sequenceNumber);
+	uint8_t _rxSequence[6];			//Sequence number we expect next on each channel
+	uint8_t _rxSequenceValid = 0;	//Bit set once we have seen a packet on that channel
+	uint8_t _rxResetSeen = 0;		//Bit set when the hub has reset since the last packet on that channel
+	uint8_t _rxRestartGap = 0;		//Channel 0 started again from 0 and it is not yet known why
+	void countGap(uint8_t channelNumber, uint8_t gap);
+	void endRestart(bool advertisement);
+	BNO085ReceiveStats _rxStats[6] = {};
+
+	//Binary capture and replay
+	void captureHeader(uint8_t recordType, const uint8_t *header, uint16_t readLength, uint16_t payloadLength);
+	void captureBytes(const uint8_t *data, uint16_t length);
+	void captureFinish(); //Pad out a record whose payload was cut short
+	bool receiveReplayPacket(void);
+	bool readReplayRecord(void);
+	Print *_capturePort = NULL;
+	uint16_t _captureRemaining = 0; //Payload bytes still owed to the record being written
+	Stream *_replayPort = NULL;
+	bool _replayRealTime = false;
+	bool _replayStarted = false;
+	bool _replayPending = false; //_replayRecord holds a received packet or chunk whose payload is still to be read
+	uint16_t _replayDataLength = 0; //Payload bytes read for the packet being replayed
+	uint16_t _replayDataSpot = 0;	//Payload bytes replayed so far
+	uint16_t _replaySkip = 0;	 //Payload bytes of a sent packet still to be skipped
+	uint8_t _replayRecord[BNO085_CAPTURE_RECORD_SIZE];
+	uint8_t _replayInt = 255;		 //The INT pin to go back to in endReplay()
+	unsigned long _replayOffset = 0; //micros() when the first packet was replayed, less its capture time
+
+	//Non-blocking receive state
+	uint8_t _rxState = SHTP_RX_IDLE;
+	bool readsWholePackets() { return (_replayPort != NULL || usingSPI()); } //False if poll() reads I2C chunk by chunk
+	uint16_t _rxDataLength = 0; //Payload bytes in the packet being received
+	uint16_t _rxDataSpot = 0;	//Payload bytes received so far
+	uint8_t parseGyroIntegratedReport(uint8_t *report);		  //Parse a report from the gyro channel
+	void receiveByte(uint16_t dataSpot, uint8_t incoming);		  //Store and parse a payload byte as it comes off the bus
+	void parseByte(uint8_t incoming);							  //Parse a payload byte that is already stored
+	uint8_t getReportLength(uint8_t reportID);					  //Length in bytes of a given report ID
+	uint64_t _reportsUpdated = 0;								  //Bit n is set when report ID n is parsed
+	uint16_t _packetReportCount = 0;								  //Number of sensor reports found in the last packet parsed
+	uint8_t _packetFirstReportID = 0;							  //ID of the first sensor report found in the last packet parsed
+
+	//Byte-by-byte sensor report parser state
+	uint8_t _streamReport[MAX_REPORT_SIZE]; //The report currently being collected
+	uint8_t _streamIndex = 0;				 //Number of bytes collected so far
+	uint8_t _streamLength = 0;				 //Length of the report being collected
+	uint8_t _streamChannel = 0;
+	bool _streamActive = false;
+	bool _streamSkipping = false; //Set when an unknown report is found. The rest of the packet is skipped.
+	uint32_t _bytesSkipped = 0;
 
 	//These are the raw sensor values (without Q applied) pulled from the user requested Input Report
 	uint16_t rawAccelX, rawAccelY, rawAccelZ, accelAccuracy;
@@ -289,12 +925,18 @@ private:
 	uint16_t rawMagX, rawMagY, rawMagZ, magAccuracy;
 	uint16_t rawQuatI, rawQuatJ, rawQuatK, rawQuatReal, rawQuatRadianAccuracy, quatAccuracy;
 	uint16_t rawFastGyroX, rawFastGyroY, rawFastGyroZ;
+	uint16_t rawGravityX, rawGravityY, rawGravityZ, gravityAccuracy;
+	uint16_t rawUncalibGyroX, rawUncalibGyroY, rawUncalibGyroZ, rawBiasGyroX, rawBiasGyroY, rawBiasGyroZ, uncalibGyroAccuracy;
+	uint16_t rawUncalibMagX, rawUncalibMagY, rawUncalibMagZ, rawBiasMagX, rawBiasMagY, rawBiasMagZ, uncalibMagAccuracy;
 	uint8_t tapDetector;
+	bool significantMotion = false;
+	uint8_t shakeDetector = 0;
+	uint8_t stabilityDetector = 0;
 	uint16_t stepCount;
 	uint32_t timeStamp;
 	uint8_t stabilityClassifier;
 	uint8_t activityClassifier;
-	uint8_t *_activityConfidences;						  //Array that store the confidences of the 9 possible activities
+	uint8_t *_activityConfidences = NULL;					  //Array that store the confidences of the 9 possible activities
 	uint8_t calibrationStatus;							  //Byte R0 of ME Calibration Response
 	uint16_t memsRawAccelX, memsRawAccelY, memsRawAccelZ; //Raw readings from MEMS sensor
 	uint16_t memsRawGyroX, memsRawGyroY, memsRawGyroZ;	//Raw readings from MEMS sensor
@@ -306,7 +948,130 @@ private:
 	int16_t rotationVectorAccuracy_Q1 = 12; //Heading accuracy estimate in radians. The Q point is 12.
 	int16_t accelerometer_Q1 = 8;
 	int16_t linear_accelerometer_Q1 = 8;
+	int16_t gravity_Q1 = 8;
 	int16_t gyro_Q1 = 9;
 	int16_t magnetometer_Q1 = 4;
 	int16_t angular_velocity_Q1 = 10;
 };
+
+//Integer only quaternion and vector math on Q14 quaternions, for parts without an FPU
+//Quaternions should be close to unit length, as they are from the BNO085. Products are rounded to Q14.
+//Angles are binary: 65536 is one turn, so BNO085_ANGLE_90 is 90 degrees and an int16_t wraps at +/-180.
+#define BNO085_ANGLE_90 16384
+class BNO085Fixed
+{
+public:
+	static BNO085Quat multiply(const BNO085Quat &a, const BNO085Quat &b); //Rotate by b, then by a
+	static BNO085Quat conjugate(const BNO085Quat &q);					   //The opposite rotation
+	static BNO085Quat normalize(const BNO085Quat &q);					   //Scale back to unit length, after many multiplies
+	static BNO085Vector rotate(const BNO085Quat &q, const BNO085Vector &v); //Rotate a vector. It keeps its Q point.
+	static BNO085Quat relative(const BNO085Quat &from, const BNO085Quat &to); //The rotation r where to = from * r
+
+	static void euler(const BNO085Quat &q, int16_t &roll, int16_t &pitch, int16_t &yaw); //Binary angles, same axes as getEuler()
+	static int16_t heading(const BNO085Quat &q);										   //Yaw only
+	static int16_t toCentidegrees(int16_t angle);										   //Binary angle to 1/100 degree
+
+	static int16_t atan2(int32_t y, int32_t x); //CORDIC, to within 1 count of a binary angle
+	static uint16_t sqrt(uint32_t value);		//Rounded down
+};
+
+//Fairness and latency counts for one device of a BNO085Manager
+struct BNO085DeviceStats
+{
+	uint32_t transactions;		 //Steps of the receive done for the device, see poll()
+	uint32_t packets;			 //Packets read
+	uint32_t samples;			 //Samples handed out by readSample()
+	uint32_t maxWaitMicros;		 //Longest the device had data before it got its first transaction
+	uint32_t maxLatencyMicros;	 //Longest from the device having data to its packet being parsed
+	uint64_t totalLatencyMicros; //Divide by packets for the mean
+};
+
+//Services several BNO085s, on any mix of I2C and SPI ports, from one loop
+//Each update() does one bus transaction for the device that has been waiting longest, so a quiet
+//or slow device never holds up the others. Samples from all of them come out of readSample()
+//in timeMicros order.
+#define BNO085_MAX_DEVICES 8
+class BNO085Manager
+{
+public:
+	uint8_t addDevice(BNO085 &device, BNO085Sample *queue, uint8_t queueSize); //Call after begin(). Returns its index, 255 if full.
+	uint8_t getDeviceCount() { return (_deviceCount); }
+	BNO085 *getDevice(uint8_t index);
+
+	void setPollInterval(unsigned long pollMicros); //How often to look at devices that have no INT pin, on average
+	void setMergeDelay(unsigned long delayMicros); //How long a sample can wait for an older one from another device
+
+	uint8_t update(); //One bus transaction. Returns the index of the device it was for, 255 if none needed one.
+	bool readSample(BNO085Sample &sample, uint8_t &device); //The oldest sample from any device. False if none is ready.
+
+	BNO085DeviceStats getStats(uint8_t device);
+	void clearStats();
+
+private:
+	struct Device
+	{
+		BNO085 *imu;
+		bool ready;				  //Has data, or is part way through a packet
+		bool started;			  //Had a transaction since it became ready
+		unsigned long readySince; //When it became ready, micros()
+		unsigned long lastPoll;	  //When a device with no INT pin was last read
+		unsigned long pollWait;	  //How long after that to read it again
+		BNO085DeviceStats stats;
+	};
+	bool deviceReady(Device &device, unsigned long now);
+	unsigned long nextPollWait();
+	Device _devices[BNO085_MAX_DEVICES];
+	uint8_t _deviceCount = 0;
+	unsigned long _pollInterval = 10000;
+	uint32_t _pollSeed = 1;
+	unsigned long _mergeDelay = 20000;
+};
+
+//Lines up one report from every device of a BNO085Manager on a common clock
+//Each report's sample time is the INT edge (or the read, with no INT pin) less the packet's base
+//timestamp plus the report's delay, so it is late by however long the edge or read was. The hub
+//paces the sensor with its own clock and counts its reports, so report n was taken n confirmed
+//report intervals into its run on the hub's clock. Tracking that against the sample times, keeping
+//the least delayed ones as BNO085ClockEstimate does, gives each device's offset and drift.
+//readAligned() then hands out one sample per device for the same moment, every output interval.
+class BNO085Synchronizer
+{
+public:
+	void begin(BNO085Manager &manager, uint8_t reportID, unsigned long reportMicros = 0); //After the devices are added and enabled
+	void setOutputInterval(unsigned long intervalMicros, bool interpolate = true);	//How often readAligned() has a set
+	void setMaxDelay(unsigned long delayMicros); //How long to wait for a device that has stopped
+
+	uint8_t update(); //Call instead of the manager's update()
+	bool readAligned(BNO085Sample *samples); //One sample per device, all for timeMicros. False if none is ready yet.
+
+	float getClockDrift(uint8_t device);		//How much faster micros() runs than the device's clock, in ppm
+	uint32_t getMaxCorrection(uint8_t device); //Most a sample time has been moved, in microseconds
+	void reset();
+
+private:
+	struct Channel
+	{
+		BNO085ClockEstimate clock; //The hub time of each report against its sample time
+		uint32_t reportMicros;	   //Report interval on the hub's clock
+		uint64_t hubMicros;		   //Hub time of the last report: reports so far times the report interval
+		uint32_t lastMicros;	   //Sample time of the last report, low 32 bits
+		uint8_t sequence;		   //Of the last report
+		bool started;
+		bool havePrevious;
+		BNO085Sample previous; //The last report at or before the next output time
+		uint32_t previousTime; //Its aligned time
+		uint32_t maxCorrection;
+	};
+	bool peekNext(uint8_t device, BNO085Sample &sample, uint64_t &hubMicros, uint32_t &time);
+	void takeNext(uint8_t device);
+	void fillSample(uint8_t device, BNO085Sample &sample);
+	BNO085Manager *_manager = NULL;
+	Channel _channels[BNO085_MAX_DEVICES];
+	uint8_t _reportID = 0;
+	bool _quaternion = false; //Interpolate the report as a rotation
+	unsigned long _outputInterval = 10000;
+	bool _interpolate = true;
+	unsigned long _maxDelay = 50000;
+	bool _ticking = false;
+	uint64_t _tick = 0; //Time of the next set, in micros() of the manager's first device
+};